@@ -0,0 +1,188 @@
+#include "Calibration.h"
+#include "Clock.h"
+#include "LatencyHistogram.h"
+#include <chrono>
+#include <cmath>
+
+namespace {
+
+// Send probes one at a time to the engine's only target and summarize the
+// round trips of those answered in time
+void MeasureOverhead(ProbeEngine& engine, int target, int probes, OverheadEstimate& estimate,
+    uint64_t (&sources)[TIMESTAMP_SOURCE_COUNT]) {
+    const int64_t timeoutNs = static_cast<int64_t>(CALIBRATION_TIMEOUT_MS) * 1000000;
+    LatencyHistogram histogram;
+    int64_t minNs = INT64_MAX;
+    int64_t maxNs = 0;
+    double mean = 0.0;
+    double m2 = 0.0;
+    uint64_t answered = 0;
+    int misses = 0;
+
+    for (uint32_t sequence = 1; sequence <= static_cast<uint32_t>(probes) && misses < CALIBRATION_MAX_MISSES; sequence++) {
+        misses++;
+        int64_t sendTime = 0;
+        if (!engine.Send(target, sequence, sendTime)) continue;
+
+        // Skip anything left over from an earlier probe
+        ProbeReply reply;
+        int64_t deadline = sendTime + timeoutNs;
+        for (;;) {
+            int64_t remainingNs = deadline - MonotonicNowNs();
+            if (!engine.Receive(reply, remainingNs > 0 ? remainingNs : 0)) break;
+            if (reply.sequence != sequence || reply.status != ProbeStatus::Ok) continue;
+
+            int64_t rttNs = reply.receiveTimeNs - sendTime;
+            histogram.Add(rttNs);
+            if (rttNs < minNs) minNs = rttNs;
+            if (rttNs > maxNs) maxNs = rttNs;
+            answered++;
+            double delta = rttNs / 1e6 - mean;
+            mean += delta / answered;
+            m2 += delta * (rttNs / 1e6 - mean);
+            sources[static_cast<int>(reply.timestampSource)]++;
+            misses = 0;
+            break;
+        }
+    }
+
+    estimate = OverheadEstimate();
+    estimate.probes = answered;
+    if (answered == 0) return;
+    estimate.fixedMs = NsToMs(minNs);
+    estimate.p50Ms = NsToMs(histogram.Percentile(0.5));
+    estimate.p99Ms = NsToMs(histogram.Percentile(0.99));
+    estimate.maxMs = NsToMs(maxNs);
+    estimate.jitterMs = std::sqrt(m2 / answered);
+}
+
+} // namespace
+
+bool Calibrate(ProbeBackend backend, const ProbeOptions& options, int probes, CalibrationResult& result,
+    std::string& error) {
+    ProbeOptions calibration = options;
+    calibration.timeoutMs = CALIBRATION_TIMEOUT_MS;
+    calibration.maxInFlight = 1;
+    NetAddress loopback;
+    ParseNetAddress(CALIBRATION_HOST, loopback);
+    result = CalibrationResult();
+
+    std::unique_ptr<ProbeEngine> engine = CreateProbeEngine(backend);
+    int target = 0;
+    if (!engine) {
+        error = "Backend not available on this platform";
+        return false;
+    }
+    if (!engine->Open(calibration) || !engine->AddTarget(loopback, target)) {
+        error = engine->LastError();
+        engine->Close();
+        return false;
+    }
+    uint64_t sources[TIMESTAMP_SOURCE_COUNT] = {};
+    MeasureOverhead(*engine, target, probes, result.loopback, sources);
+    result.backend = engine->Name();
+    engine->Close();
+    if (result.loopback.probes == 0) {
+        error = std::string("No replies from ") + CALIBRATION_HOST;
+        return false;
+    }
+    result.source = sources[static_cast<int>(TimestampSource::Kernel)] * 2 > result.loopback.probes
+        ? TimestampSource::Kernel : TimestampSource::Application;
+
+    // The simulated responder answers at once, which leaves the cost of the
+    // clock, the engine interface and the receive loop. A simulated backend
+    // has just measured exactly that.
+    if (backend == ProbeBackend::Simulated) {
+        result.simulatedBackend = true;
+        result.finishedNs = MonotonicNowNs();
+        return true;
+    }
+    std::unique_ptr<ProbeEngine> simulated = CreateSimulatedEngine(SimulatedResponderConfig());
+    uint64_t simulatedSources[TIMESTAMP_SOURCE_COUNT] = {};
+    if (simulated->Open(calibration) && simulated->AddTarget(loopback, target)) {
+        MeasureOverhead(*simulated, target, probes, result.simulated, simulatedSources);
+    }
+    simulated->Close();
+
+    result.finishedNs = MonotonicNowNs();
+    return true;
+}
+
+WindowSummary SubtractOverhead(const WindowSummary& stats, const OverheadEstimate& overhead) {
+    WindowSummary out = stats;
+    double fixedMs = overhead.fixedMs;
+    double* latencies[] = { &out.currentMs, &out.averageMs, &out.minMs, &out.maxMs,
+        &out.p50Ms, &out.p90Ms, &out.p99Ms, &out.p999Ms };
+    for (double* value : latencies) {
+        *value = *value > fixedMs ? *value - fixedMs : 0.0;
+    }
+
+    // Independent noise adds in variance
+    double variance = stats.jitterMs * stats.jitterMs - overhead.jitterMs * overhead.jitterMs;
+    out.jitterMs = variance > 0.0 ? std::sqrt(variance) : 0.0;
+    return out;
+}
+
+Calibrator::~Calibrator() {
+    Stop();
+}
+
+bool Calibrator::Start(ProbeBackend backend, const ProbeOptions& options, double periodSeconds) {
+    Stop();
+    CalibrationResult result;
+    std::string error;
+    bool ok = Calibrate(backend, options, CALIBRATION_PROBES, result, error);
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stopping = false;
+        m_LastError = error;
+        if (ok) {
+            m_Result = result;
+            m_HasResult = true;
+        }
+    }
+    if (ok && periodSeconds > 0) {
+        m_Thread = std::thread(&Calibrator::Run, this, backend, options, periodSeconds);
+    }
+    return ok;
+}
+
+void Calibrator::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stopping = true;
+    }
+    m_Wake.notify_all();
+    if (m_Thread.joinable()) m_Thread.join();
+}
+
+bool Calibrator::Latest(CalibrationResult& out) const {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (!m_HasResult) return false;
+    out = m_Result;
+    return true;
+}
+
+std::string Calibrator::LastError() const {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_LastError;
+}
+
+// Calibrate again every period; a failed re-run keeps the previous result
+void Calibrator::Run(ProbeBackend backend, ProbeOptions options, double periodSeconds) {
+    auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(periodSeconds));
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    while (!m_Wake.wait_for(lock, period, [this]() { return m_Stopping; })) {
+        lock.unlock();
+        CalibrationResult result;
+        std::string error;
+        bool ok = Calibrate(backend, options, CALIBRATION_PROBES, result, error);
+        lock.lock();
+        m_LastError = error;
+        if (ok) {
+            m_Result = result;
+            m_HasResult = true;
+        }
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "ProbeEngine.h"
+#include "WindowStats.h"
+#include <cstdint>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Probes per calibration run, for each of loopback and the simulated responder
+const int CALIBRATION_PROBES = 200;
+
+// Loopback answers in microseconds; a probe this slow is left out
+const int CALIBRATION_TIMEOUT_MS = 100;
+
+// Unanswered probes in a row after which a run gives up
+const int CALIBRATION_MAX_MISSES = 5;
+
+// Target of the loopback run
+const char* const CALIBRATION_HOST = "127.0.0.1";
+
+// How often the GUI calibrates again while it probes
+const double GUI_CALIBRATION_PERIOD_SECONDS = 600.0;
+
+// Round trips measured where the network adds nothing, so all of it is the
+// measurement's own cost
+struct OverheadEstimate {
+    uint64_t probes = 0;   // Answered calibration probes
+    double fixedMs = 0.0;  // Least any probe took: paid by every measurement
+    double p50Ms = 0.0;
+    double p99Ms = 0.0;
+    double maxMs = 0.0;
+    double jitterMs = 0.0; // Standard deviation: the variable part
+};
+
+// One calibration of a backend
+struct CalibrationResult {
+    std::string backend;  // Engine name, e.g. "socket"
+    TimestampSource source = TimestampSource::Application; // How the loopback replies were timed (most of them)
+    bool simulatedBackend = false; // The backend is the simulated responder: nothing went to loopback
+    OverheadEstimate loopback;  // The backend against the local network stack (or the simulator itself)
+    OverheadEstimate simulated; // Simulated responder with no delay: clock, engine and loop only; not
+                                // measured separately when the backend is the simulator
+    int64_t finishedNs = 0;     // MonotonicNowNs() when it finished
+};
+
+// Probe loopback with the backend and then the simulated responder, one
+// probe at a time, and summarize both. The simulated backend is only
+// measured once. Returns false if the backend could not probe loopback.
+bool Calibrate(ProbeBackend backend, const ProbeOptions& options, int probes, CalibrationResult& result,
+    std::string& error);
+
+// Window figures with the fixed overhead taken off the latencies (never
+// below zero) and the overhead's own variance taken out of the jitter
+WindowSummary SubtractOverhead(const WindowSummary& stats, const OverheadEstimate& overhead);
+
+// Calibrates when a run starts and then again every period on its own
+// thread, publishing the latest result for the UI and reports. Re-runs are
+// short (a few hundred loopback probes) but share the machine with the
+// sampler, so they are spaced minutes apart.
+class Calibrator {
+public:
+    ~Calibrator();
+
+    // Calibrate now, on the calling thread, and then every periodSeconds
+    // (0 = never again) until Stop. Returns false if the first run failed;
+    // the reason is available from LastError().
+    bool Start(ProbeBackend backend, const ProbeOptions& options, double periodSeconds);
+
+    void Stop();
+
+    // Latest result. Returns false before the first successful run.
+    bool Latest(CalibrationResult& out) const;
+
+    std::string LastError() const;
+
+private:
+    void Run(ProbeBackend backend, ProbeOptions options, double periodSeconds);
+
+    mutable std::mutex m_Mutex;
+    std::condition_variable m_Wake;
+    std::thread m_Thread;
+    bool m_Stopping = false;
+    bool m_HasResult = false;
+    CalibrationResult m_Result;
+    std::string m_LastError;
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+// Monotonic timestamp in nanoseconds, used for every send/receive time
+inline int64_t MonotonicNowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Convert a nanosecond duration to milliseconds for display
+inline double NsToMs(int64_t ns) {
+    return ns / 1000000.0;
+}
+
+// Where a reply's receive timestamp came from
+enum class TimestampSource : uint8_t {
+    Application, // MonotonicNowNs() once the engine handed the reply over
+    Kernel       // Software stamp the kernel took when the packet arrived
+};
+
+const int TIMESTAMP_SOURCE_COUNT = 2;
+
+// Short name for reports and exports
+inline const char* TimestampSourceName(TimestampSource source) {
+    return source == TimestampSource::Kernel ? "kernel" : "app";
+}
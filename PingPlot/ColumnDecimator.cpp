@@ -0,0 +1,155 @@
+#include "ColumnDecimator.h"
+#include <cmath>
+
+void ColumnDecimator::Configure(int columns, int64_t columnNs) {
+    size_t size = 1;
+    while (size < static_cast<size_t>(columns) + 2) size <<= 1;
+    m_Columns.assign(size, ColumnEnvelope());
+    m_Mask = size - 1;
+    m_ColumnNs = columnNs > 0 ? columnNs : 1;
+    Reset();
+}
+
+void ColumnDecimator::Reset() {
+    for (ColumnEnvelope& envelope : m_Columns) {
+        envelope.column = -1;
+    }
+    m_NewestSendNs = -1;
+    m_DirtyColumn = INT64_MIN;
+    m_Synced = false;
+    m_Pending.clear();
+}
+
+void ColumnDecimator::Update(const SampleStore& store) {
+    if (m_Columns.empty()) return;
+    if (!m_Synced) {
+        m_Cursor = store.VisibleBegin();
+        m_Synced = true;
+    }
+
+    // Probes that were outstanding last time: fold the ones that finished
+    size_t kept = 0;
+    for (uint64_t index : m_Pending) {
+        int64_t sendTimeNs, rttNs;
+        SampleStatus status;
+        if (!store.Read(index, sendTimeNs, rttNs, status)) continue; // Overwritten
+        if (status == SampleStatus::Pending) {
+            m_Pending[kept++] = index;
+        } else {
+            Fold(sendTimeNs, rttNs, status);
+        }
+    }
+    m_Pending.resize(kept);
+
+    // New records
+    store.ReadFrom(m_Cursor, m_Scratch, COLUMN_SEND_TIME | COLUMN_RTT | COLUMN_STATUS);
+    for (size_t i = 0; i < m_Scratch.Size(); i++) {
+        int64_t sendTimeNs = m_Scratch.sendTimeNs[i];
+        if (sendTimeNs > m_NewestSendNs) m_NewestSendNs = sendTimeNs;
+        if (m_Scratch.status[i] == SampleStatus::Pending) {
+            m_Pending.push_back(m_Scratch.firstIndex + i);
+        } else {
+            Fold(sendTimeNs, m_Scratch.rttNs[i], m_Scratch.status[i]);
+        }
+    }
+}
+
+void ColumnDecimator::Add(int64_t sendTimeNs, int64_t rttNs, SampleStatus status) {
+    if (m_Columns.empty()) return;
+    if (sendTimeNs > m_NewestSendNs) m_NewestSendNs = sendTimeNs;
+    Fold(sendTimeNs, rttNs, status);
+}
+
+void ColumnDecimator::Fold(int64_t sendTimeNs, int64_t rttNs, SampleStatus status) {
+    if (status == SampleStatus::Pending || status == SampleStatus::Duplicate) return;
+
+    int64_t column = sendTimeNs / m_ColumnNs;
+    ColumnEnvelope& envelope = m_Columns[static_cast<size_t>(column) & m_Mask];
+    if (envelope.column > column) return; // Slot already reused by a newer column
+    if (envelope.column < column) {
+        envelope = ColumnEnvelope();
+        envelope.column = column;
+    }
+    if (column < m_DirtyColumn) m_DirtyColumn = column;
+
+    if (status != SampleStatus::Ok) {
+        envelope.lost++;
+        return;
+    }
+
+    if (envelope.answered == 0) {
+        envelope.firstSendNs = envelope.lastSendNs = sendTimeNs;
+        envelope.firstRttNs = envelope.lastRttNs = rttNs;
+        envelope.minRttNs = envelope.maxRttNs = rttNs;
+    } else {
+        // Replies can finish out of send order, so compare send times
+        if (sendTimeNs < envelope.firstSendNs) {
+            envelope.firstSendNs = sendTimeNs;
+            envelope.firstRttNs = rttNs;
+        }
+        if (sendTimeNs >= envelope.lastSendNs) {
+            envelope.lastSendNs = sendTimeNs;
+            envelope.lastRttNs = rttNs;
+        }
+        if (rttNs < envelope.minRttNs) envelope.minRttNs = rttNs;
+        if (rttNs > envelope.maxRttNs) envelope.maxRttNs = rttNs;
+    }
+    envelope.answered++;
+}
+
+const ColumnEnvelope* ColumnDecimator::Column(int64_t column) const {
+    if (m_Columns.empty() || column < 0) return nullptr;
+    const ColumnEnvelope& envelope = m_Columns[static_cast<size_t>(column) & m_Mask];
+    return envelope.column == column ? &envelope : nullptr;
+}
+
+int64_t ColumnDecimator::TakeDirtyColumn() {
+    int64_t dirty = m_DirtyColumn;
+    m_DirtyColumn = INT64_MAX;
+    return dirty;
+}
+
+void SelectLttb(const std::vector<const ColumnEnvelope*>& columns, std::vector<int64_t>& selected) {
+    int count = static_cast<int>(columns.size());
+    selected.assign(count, -1);
+
+    bool havePrevious = false;
+    double ax = 0.0, ay = 0.0;
+    int next = 0; // Next populated column after i; only ever moves forward
+    for (int i = 0; i < count; i++) {
+        const ColumnEnvelope* envelope = columns[i];
+        if (!envelope || envelope->answered == 0) continue;
+
+        if (next <= i) next = i + 1;
+        while (next < count && (!columns[next] || columns[next]->answered == 0)) next++;
+
+        int64_t candidates[4] = { envelope->firstRttNs, envelope->minRttNs, envelope->maxRttNs, envelope->lastRttNs };
+        int64_t choice;
+        if (!havePrevious) {
+            choice = envelope->firstRttNs; // Keep the first point, as LTTB does
+        } else if (next >= count) {
+            choice = envelope->lastRttNs;  // And the last one
+        } else {
+            // Third vertex: the average of the next populated column
+            const ColumnEnvelope* following = columns[next];
+            double cx = next;
+            double cy = (following->firstRttNs + following->minRttNs + following->maxRttNs + following->lastRttNs) / 4.0;
+
+            // Keep the candidate that spans the largest triangle
+            double bestArea = -1.0;
+            choice = candidates[0];
+            for (int64_t candidate : candidates) {
+                double area = std::fabs((ax - cx) * (candidate - ay) - (ax - i) * (cy - ay));
+                if (area > bestArea) {
+                    bestArea = area;
+                    choice = candidate;
+                }
+            }
+        }
+
+        selected[i] = choice;
+        ax = i;
+        ay = static_cast<double>(choice);
+        havePrevious = true;
+    }
+}
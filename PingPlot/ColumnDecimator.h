@@ -0,0 +1,77 @@
+#pragma once
+
+#include "SampleStore.h"
+#include <cstdint>
+#include <vector>
+
+// What one pixel column of the graph has to show: the first and last answered
+// ping (by send time) to join the neighbouring columns, the min and max so a
+// single spike survives, and how many probes were lost
+struct ColumnEnvelope {
+    int64_t column = -1;   // Column number the slot currently holds
+    int64_t firstSendNs = 0;
+    int64_t lastSendNs = 0;
+    int64_t firstRttNs = 0;
+    int64_t lastRttNs = 0;
+    int64_t minRttNs = 0;
+    int64_t maxRttNs = 0;
+    uint32_t answered = 0;
+    uint32_t lost = 0;
+};
+
+// Reduces the sample history to one envelope per pixel column. Columns are
+// fixed slices of send time (column = sendTimeNs / columnNs), so the
+// envelopes stay valid as the graph scrolls and only new or newly completed
+// records are folded in: each Update costs O(new samples) and drawing costs
+// O(width) however many samples the window holds. Records that were still
+// pending when read are remembered by index and folded once they finish.
+// Used from the drawing thread only.
+class ColumnDecimator {
+public:
+    // Start over with columns of columnNs, keeping at least `columns` of
+    // them. The next Update reads the store's visible window again.
+    void Configure(int columns, int64_t columnNs);
+
+    // Drop everything, e.g. after the store was cleared
+    void Reset();
+
+    // Fold in everything the store gained or completed since the last call
+    void Update(const SampleStore& store);
+
+    // Fold in one finished probe from another source (e.g. a replayed file)
+    void Add(int64_t sendTimeNs, int64_t rttNs, SampleStatus status);
+
+    bool HasData() const { return m_NewestSendNs >= 0; }
+
+    int64_t ColumnNs() const { return m_ColumnNs; }
+
+    // Column of the newest record seen
+    int64_t NewestColumn() const { return m_NewestSendNs / m_ColumnNs; }
+
+    // Envelope of a column, or nullptr if nothing finished in it
+    const ColumnEnvelope* Column(int64_t column) const;
+
+    // Oldest column changed since the last call: INT64_MIN after Configure
+    // or Reset (everything), INT64_MAX if nothing changed
+    int64_t TakeDirtyColumn();
+
+private:
+    // Add one finished record to its column
+    void Fold(int64_t sendTimeNs, int64_t rttNs, SampleStatus status);
+
+    std::vector<ColumnEnvelope> m_Columns; // Ring indexed by column number
+    size_t m_Mask = 0;
+    int64_t m_ColumnNs = 1;
+    int64_t m_NewestSendNs = -1;
+    int64_t m_DirtyColumn = INT64_MIN;
+    uint64_t m_Cursor = 0;                 // Next store index to read
+    bool m_Synced = false;                 // m_Cursor is positioned in the store
+    std::vector<uint64_t> m_Pending;       // Indices read while still pending
+    SampleColumns m_Scratch;
+};
+
+// Largest-Triangle-Three-Buckets over a row of envelopes (nullptr = empty
+// column): picks one of the first/min/max/last points of each column so the
+// line keeps its shape. selected[i] is the chosen RTT, or -1 for a column
+// without answered probes.
+void SelectLttb(const std::vector<const ColumnEnvelope*>& columns, std::vector<int64_t>& selected);
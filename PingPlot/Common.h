@@ -16,29 +16,28 @@
 #include <mutex>
 #include <atomic>
 #include <chrono>
+#include "Calibration.h"
+#include "ColumnDecimator.h"
+#include "Sampler.h"
+#include "SessionFile.h"
+#include "TieredHistory.h"
 
 // Libraries
 #pragma comment(lib, "gdiplus.lib")
 #pragma comment(lib, "iphlpapi.lib")
 #pragma comment(lib, "ws2_32.lib")
+#pragma comment(lib, "comdlg32.lib")
 
 // Constants
 const int WINDOW_WIDTH = 1600;
 const int WINDOW_HEIGHT = 900;
-const int GRAPH_PADDING = 60;
-const int INITIAL_MAX_DATAPOINTS = 500; // Initial value, will be adjusted dynamically
-const float HISTORY_SECONDS = 15.0; // How long to keep data in seconds
-const int PING_INTERVAL_MS = 0; // additional delay between pings.
-const int DEFAULT_PING_TIMEOUT_MS = 1000;
-const int UI_UPDATE_INTERVAL_MS = 33; // ~30 FPS for UI updates
+const int DEFAULT_MAX_FPS = 60;       // Frame cap when the display's refresh rate is unknown
+const int MAX_UI_FPS = 500;
+const UINT WM_APP_DATA_UPDATED = WM_APP + 1; // Posted by the probe thread when new data waits to be drawn
 const COLORREF BACKGROUND_COLOR = RGB(240, 240, 240);
-const COLORREF GRAPH_GRID_COLOR = RGB(200, 200, 200);
-const COLORREF GRAPH_LINE_COLOR = RGB(0, 100, 200);
 
 // Dark mode colors
 const COLORREF DARK_BACKGROUND_COLOR = RGB(30, 30, 30);
-const COLORREF DARK_GRAPH_GRID_COLOR = RGB(70, 70, 70);
-const COLORREF DARK_GRAPH_LINE_COLOR = RGB(0, 150, 255);
 const COLORREF DARK_TEXT_COLOR = RGB(220, 220, 220);
 const COLORREF LIGHT_TEXT_COLOR = RGB(0, 0, 0);
 
@@ -49,8 +48,12 @@ const COLORREF DARK_BUTTON_BG = RGB(60, 60, 60);
 
 // Global variables
 extern std::wstring g_HostToPing;
-extern std::deque<double> g_PingTimes;
-extern std::mutex g_PingDataMutex;
+extern SampleStore g_SampleStore;               // Ping history shared with the probe thread
+extern SamplerShared g_SamplerShared;           // Counters published by the probe thread
+extern ColumnDecimator g_GraphDecimator;        // Per-pixel envelopes of g_SampleStore
+extern TieredHistory g_TieredHistory;           // Rollups for histories longer than the raw ring
+extern Resolver g_Resolver;                     // Cached host lookups, kept across runs
+extern SamplerCommandQueue g_SamplerCommands;   // Setting changes for the running probe thread
 extern std::atomic<bool> g_Running;
 extern HWND g_hWnd;
 extern HWND g_hEditHost;
@@ -58,15 +61,11 @@ extern HWND g_hBtnStart;
 extern HWND g_hBtnStop;
 extern HWND g_hEditFrequency;
 extern HWND g_hBtnApplyFrequency;
-extern int g_PingInterval;
+extern int64_t g_PingIntervalUs;
 extern double g_MaxPingTime;
-extern std::atomic<bool> g_DataUpdated;
-extern UINT_PTR g_UITimer;
-extern std::atomic<unsigned long long> g_TotalPings;
-extern std::atomic<double> g_PingsPerSecond;
-extern std::chrono::steady_clock::time_point g_LastPPSUpdateTime;
-extern unsigned long long g_LastPPSCount;
-extern std::atomic<int> g_DynamicDataPoints; // New variable for dynamic data points
+extern HANDLE g_FrameTimer;                   // Waitable timer for a frame held back by the frame cap
+extern int g_MaxFps;                          // Most graph redraws per second while data arrives
+extern HWND g_hEditMaxFps;                    // Handle to frame cap edit control
 extern std::thread g_PingThreadHandle;        // Handle to the ping thread
 extern std::atomic<bool> g_ThreadRunning;     // Flag to track if thread is running
 extern float g_HistorySeconds;                // User configurable history length
@@ -74,6 +73,22 @@ extern HWND g_hEditHistory;                   // Handle to history length edit c
 extern HWND g_hBtnApplyHistory;               // Handle to apply history button
 extern bool g_DarkMode;                       // Dark mode toggle
 extern HWND g_hBtnDarkMode;                   // Dark mode toggle button
+extern int g_MaxInFlight;                     // Probes outstanding at once (1 = send after reply)
+extern HWND g_hEditInFlight;                  // Handle to in-flight window edit control
+extern bool g_UseLttb;                        // Draw one LTTB point per column instead of min/max envelopes
+extern HWND g_hBtnGraphMode;                  // Envelope/LTTB toggle button
+extern bool g_Recording;                      // Write each run to a session file
+extern HWND g_hBtnRecord;                     // Recording toggle button
+extern SessionWriter g_SessionWriter;         // Session file of the current run
+extern SessionReader g_ReplaySession;         // Session file shown instead of live data
+extern HWND g_hBtnReplay;                     // Open/close replay button
+extern bool g_LowJitter;                      // Probe in low-jitter mode (pinned, busy-polling thread)
+extern HWND g_hBtnLowJitter;                  // Low-jitter toggle button
+extern Calibrator g_Calibrator;               // Measures the tool's own overhead while probing
+extern bool g_SubtractOverhead;               // Show stats with the measured overhead taken off
+extern HWND g_hBtnOverhead;                   // Raw/overhead-corrected stats toggle button
+extern bool g_AdaptiveRate;                   // Let the rate controller pick the rate and depth
+extern HWND g_hBtnAdaptive;                   // Adaptive rate toggle button
 
 // Control IDs
 enum ControlIDs {
@@ -84,5 +99,13 @@ enum ControlIDs {
     ID_BTN_APPLY = 105,
     ID_EDIT_HISTORY = 106,
     ID_BTN_APPLY_HISTORY = 107,
-    ID_BTN_DARK_MODE = 108
+    ID_BTN_DARK_MODE = 108,
+    ID_EDIT_IN_FLIGHT = 109,
+    ID_BTN_GRAPH_MODE = 110,
+    ID_BTN_RECORD = 111,
+    ID_BTN_REPLAY = 112,
+    ID_BTN_LOW_JITTER = 113,
+    ID_BTN_OVERHEAD = 114,
+    ID_BTN_ADAPTIVE = 115,
+    ID_EDIT_MAX_FPS = 116
 };
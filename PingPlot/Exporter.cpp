@@ -0,0 +1,390 @@
+#include "Exporter.h"
+#include <chrono>
+#include <cinttypes>
+#include <cstring>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+namespace {
+
+const char* StatusName(uint8_t status) {
+    switch (static_cast<SampleStatus>(status)) {
+        case SampleStatus::Pending: return "pending";
+        case SampleStatus::Ok: return "ok";
+        case SampleStatus::Timeout: return "timeout";
+        case SampleStatus::Unreachable: return "unreachable";
+        case SampleStatus::Duplicate: return "duplicate";
+        case SampleStatus::Late: return "late";
+    }
+    return "unknown";
+}
+
+const char* SourceName(uint8_t source) {
+    return TimestampSourceName(static_cast<TimestampSource>(source));
+}
+
+// fopen without the MSVC deprecation error
+FILE* CreateOutputFile(const std::string& path) {
+#ifdef _WIN32
+    FILE* file = nullptr;
+    return fopen_s(&file, path.c_str(), "wb") == 0 ? file : nullptr;
+#else
+    return fopen(path.c_str(), "wb");
+#endif
+}
+
+// Common part of the sinks: a FILE* with a large buffer, closed unless it
+// is stdout. Rows are formatted into m_Text and written with one fwrite per
+// batch.
+class FileSink : public ExportSink {
+public:
+    FileSink(FILE* file, bool owned) : m_File(file), m_Owned(owned) {
+        setvbuf(m_File, nullptr, _IOFBF, 1 << 16);
+    }
+
+    ~FileSink() override {
+        if (m_Owned) {
+            fclose(m_File);
+        } else {
+            fflush(m_File);
+        }
+    }
+
+    bool Flush() override {
+        return fflush(m_File) == 0;
+    }
+
+protected:
+    bool Put(const void* data, size_t size) {
+        return fwrite(data, 1, size, m_File) == size;
+    }
+
+    bool PutText() {
+        bool ok = Put(m_Text.data(), m_Text.size());
+        m_Text.clear();
+        return ok;
+    }
+
+    FILE* m_File;
+    bool m_Owned;
+    std::string m_Text;
+};
+
+class CsvSink : public FileSink {
+public:
+    using FileSink::FileSink;
+
+    bool WriteHeader() {
+        m_Text = "send_time_ns,rtt_ns,sequence,status,samples,lost,timestamp,intended_send_ns,corrected_rtt_ns\n";
+        return PutText();
+    }
+
+    bool Write(const ExportRecord* records, size_t count) override {
+        char line[192];
+        for (size_t i = 0; i < count; i++) {
+            const ExportRecord& record = records[i];
+            int length = snprintf(line, sizeof(line), "%" PRId64 ",%" PRId64 ",%u,%s,%u,%u,%s,%" PRId64 ",%" PRId64 "\n",
+                record.sendTimeNs, record.rttNs, record.sequence, StatusName(record.status),
+                record.samples, record.lost, SourceName(record.timestampSource), record.intendedSendNs,
+                record.correctedNs);
+            m_Text.append(line, static_cast<size_t>(length));
+        }
+        return PutText();
+    }
+};
+
+class JsonLinesSink : public FileSink {
+public:
+    using FileSink::FileSink;
+
+    bool Write(const ExportRecord* records, size_t count) override {
+        char line[256];
+        for (size_t i = 0; i < count; i++) {
+            const ExportRecord& record = records[i];
+            int length = snprintf(line, sizeof(line),
+                "{\"send_time_ns\":%" PRId64 ",\"rtt_ns\":%" PRId64 ",\"sequence\":%u,\"status\":\"%s\","
+                "\"samples\":%u,\"lost\":%u,\"timestamp\":\"%s\",\"intended_send_ns\":%" PRId64 ","
+                "\"corrected_rtt_ns\":%" PRId64 "}\n",
+                record.sendTimeNs, record.rttNs, record.sequence, StatusName(record.status),
+                record.samples, record.lost, SourceName(record.timestampSource), record.intendedSendNs,
+                record.correctedNs);
+            m_Text.append(line, static_cast<size_t>(length));
+        }
+        return PutText();
+    }
+};
+
+class BinarySink : public FileSink {
+public:
+    using FileSink::FileSink;
+
+    bool WriteHeader() {
+        uint32_t fields[2] = { EXPORT_BINARY_VERSION, static_cast<uint32_t>(sizeof(ExportRecord)) };
+        return Put(EXPORT_BINARY_MAGIC, sizeof(EXPORT_BINARY_MAGIC)) && Put(fields, sizeof(fields));
+    }
+
+    bool Write(const ExportRecord* records, size_t count) override {
+        return Put(records, count * sizeof(ExportRecord));
+    }
+};
+
+} // namespace
+
+bool ParseExportFormat(const char* name, ExportFormat& format) {
+    if (strcmp(name, "csv") == 0) {
+        format = ExportFormat::Csv;
+    } else if (strcmp(name, "jsonl") == 0) {
+        format = ExportFormat::JsonLines;
+    } else if (strcmp(name, "binary") == 0) {
+        format = ExportFormat::Binary;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool ParseExportPolicy(const char* name, ExportPolicy& policy) {
+    if (strcmp(name, "drop") == 0) {
+        policy = ExportPolicy::Drop;
+    } else if (strcmp(name, "coalesce") == 0) {
+        policy = ExportPolicy::Coalesce;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+std::unique_ptr<ExportSink> CreateExportSink(ExportFormat format, const std::string& path, std::string& error) {
+    bool toStdout = (path == "-");
+    FILE* file = toStdout ? stdout : CreateOutputFile(path);
+    if (!file) {
+        error = "Cannot create " + path;
+        return nullptr;
+    }
+#ifdef _WIN32
+    if (toStdout && format == ExportFormat::Binary) _setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+    bool ok = true;
+    std::unique_ptr<ExportSink> sink;
+    switch (format) {
+        case ExportFormat::Csv: {
+            CsvSink* csv = new CsvSink(file, !toStdout);
+            sink.reset(csv);
+            ok = csv->WriteHeader();
+            break;
+        }
+        case ExportFormat::JsonLines:
+            sink.reset(new JsonLinesSink(file, !toStdout));
+            break;
+        case ExportFormat::Binary: {
+            BinarySink* binary = new BinarySink(file, !toStdout);
+            sink.reset(binary);
+            ok = binary->WriteHeader();
+            break;
+        }
+    }
+    if (!ok) {
+        error = "Cannot write " + path;
+        return nullptr;
+    }
+    return sink;
+}
+
+Exporter::Exporter(std::unique_ptr<ExportSink> sink, ExportPolicy policy)
+    : m_Sink(std::move(sink)), m_Policy(policy) {}
+
+Exporter::~Exporter() {
+    Stop();
+}
+
+void Exporter::Start(const SampleStore& store) {
+    Stop();
+
+    // Only probes from now on
+    m_Store = &store;
+    m_Cursor = store.Head();
+    m_Batch.clear();
+    m_Batch.reserve(EXPORT_BATCH_RECORDS);
+    m_Overflow.clear();
+    m_Queue.clear();
+    m_CollectorDone = false;
+    m_Exported = 0;
+    m_Coalesced = 0;
+    m_Dropped = 0;
+    m_Skipped = 0;
+    m_Running = true;
+    m_Collector = std::thread(&Exporter::RunCollector, this);
+    m_Writer = std::thread(&Exporter::RunWriter, this);
+}
+
+void Exporter::Stop() {
+    if (!m_Collector.joinable()) return;
+    m_Running = false;
+    m_Collector.join();
+    m_Writer.join();
+}
+
+void Exporter::RunCollector() {
+    while (m_Running) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(EXPORT_POLL_INTERVAL_MS));
+        Collect(false);
+        Offer(false);
+    }
+
+    // Whatever is left, including probes that never finished
+    Collect(true);
+    Offer(true);
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_CollectorDone = true;
+    }
+    m_Ready.notify_one();
+}
+
+void Exporter::Collect(bool final) {
+    m_Skipped += m_Store->ReadFrom(m_Cursor, m_Scratch, COLUMN_ALL);
+
+    // Stop at the first outstanding probe; it and everything after it are
+    // read again next time
+    size_t count = m_Scratch.Size();
+    size_t done = count;
+    if (!final) {
+        for (size_t i = 0; i < count; i++) {
+            if (m_Scratch.status[i] == SampleStatus::Pending) {
+                done = i;
+                break;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < done; i++) {
+        SampleStatus status = m_Scratch.status[i];
+        ExportRecord record;
+        memset(&record, 0, sizeof(record));
+        record.sendTimeNs = m_Scratch.sendTimeNs[i];
+        record.rttNs = m_Scratch.rttNs[i];
+        record.intendedSendNs = m_Scratch.intendedSendNs[i];
+        record.correctedNs = record.sendTimeNs + record.rttNs - record.intendedSendNs;
+        record.sequence = m_Scratch.sequence[i];
+        record.samples = 1;
+        record.lost = (status == SampleStatus::Timeout || status == SampleStatus::Unreachable) ? 1 : 0;
+        record.status = static_cast<uint8_t>(status);
+        record.timestampSource = static_cast<uint8_t>(m_Scratch.timestampSource[i]);
+        m_Batch.push_back(record);
+        if (m_Batch.size() == EXPORT_BATCH_RECORDS) Offer(final);
+    }
+    m_Cursor = m_Scratch.firstIndex + done;
+}
+
+void Exporter::Offer(bool final) {
+    auto hasRoom = [this]() { return m_Queue.size() < EXPORT_QUEUE_BATCHES; };
+    auto hand = [this](Batch& batch) {
+        m_Queue.push_back(std::move(batch));
+        batch.clear();
+        if (!m_Free.empty()) {
+            batch = std::move(m_Free.back());
+            m_Free.pop_back();
+        }
+        m_Ready.notify_one();
+    };
+
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+
+        // Coalesced rows are older than the batch, so they go first
+        if (!m_Overflow.empty()) {
+            if (final) m_Room.wait(lock, hasRoom);
+            if (hasRoom()) hand(m_Overflow);
+        }
+        if (m_Batch.empty()) return;
+        if (final) m_Room.wait(lock, hasRoom);
+        if (m_Overflow.empty() && hasRoom()) {
+            hand(m_Batch);
+            return;
+        }
+    }
+
+    // The writer is a full queue behind
+    if (m_Policy == ExportPolicy::Coalesce) {
+        Coalesce(m_Batch);
+    } else {
+        for (const ExportRecord& record : m_Batch) {
+            m_Dropped += record.samples;
+        }
+    }
+    m_Batch.clear();
+}
+
+void Exporter::Coalesce(const Batch& batch) {
+    for (const ExportRecord& record : batch) {
+        if (!m_Overflow.empty()) {
+            ExportRecord& row = m_Overflow.back();
+            if (row.sendTimeNs / EXPORT_COALESCE_NS == record.sendTimeNs / EXPORT_COALESCE_NS) {
+                row.samples += record.samples;
+                row.lost += record.lost;
+                if (static_cast<SampleStatus>(record.status) == SampleStatus::Ok) {
+                    bool firstAnswer = static_cast<SampleStatus>(row.status) != SampleStatus::Ok;
+                    if (firstAnswer || record.rttNs > row.rttNs) {
+                        row.rttNs = record.rttNs;
+                        row.timestampSource = record.timestampSource;
+                    }
+                    if (firstAnswer || record.correctedNs > row.correctedNs) row.correctedNs = record.correctedNs;
+                    row.status = record.status;
+                }
+                continue;
+            }
+        }
+
+        // A row per slice keeps this small; if even that backs up, drop
+        if (m_Overflow.size() == EXPORT_BATCH_RECORDS) {
+            m_Dropped += record.samples;
+            continue;
+        }
+        m_Overflow.push_back(record);
+    }
+}
+
+void Exporter::RunWriter() {
+    for (;;) {
+        Batch batch;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_Ready.wait(lock, [this]() { return !m_Queue.empty() || m_CollectorDone; });
+            if (m_Queue.empty()) break;
+            batch = std::move(m_Queue.front());
+            m_Queue.pop_front();
+        }
+        m_Room.notify_one();
+
+        uint64_t single = 0;
+        uint64_t coalesced = 0;
+        for (const ExportRecord& record : batch) {
+            if (record.samples == 1) {
+                single++;
+            } else {
+                coalesced += record.samples;
+            }
+        }
+        if (m_Sink->Write(batch.data(), batch.size())) {
+            m_Exported += single;
+            m_Coalesced += coalesced;
+        } else {
+            m_Dropped += single + coalesced;
+        }
+
+        // Flush whenever the writer catches up, so followers of the file
+        // see rows within a poll interval
+        bool idle;
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            idle = m_Queue.empty();
+            batch.clear();
+            m_Free.push_back(std::move(batch));
+        }
+        if (idle) m_Sink->Flush();
+    }
+    m_Sink->Flush();
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "SampleStore.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+const size_t EXPORT_BATCH_RECORDS = 4096;        // Records per batch handed to the writer
+const size_t EXPORT_QUEUE_BATCHES = 16;          // Batches the writer may fall behind by
+const int EXPORT_POLL_INTERVAL_MS = 20;          // How often the exporter looks at the store
+const int64_t EXPORT_COALESCE_NS = 100000000LL;  // Send-time slice folded into one coalesced row
+
+// One exported row: a single probe, or several folded together when the
+// sink fell behind under ExportPolicy::Coalesce
+struct ExportRecord {
+    int64_t sendTimeNs;      // Send time of the (first) probe
+    int64_t rttNs;           // RTT; for a coalesced row the largest answered one
+    int64_t intendedSendNs;  // When the schedule wanted the (first) probe sent
+    int64_t correctedNs;     // Latency from the intended send time; coalesced like rttNs
+    uint32_t sequence;       // Sequence of the (first) probe
+    uint32_t samples;        // Probes this row stands for
+    uint32_t lost;           // How many of them were lost
+    uint8_t status;          // SampleStatus; Ok if any of them was answered
+    uint8_t timestampSource; // TimestampSource behind rttNs
+    uint8_t reserved[2];
+};
+
+static_assert(sizeof(ExportRecord) == 48, "ExportRecord layout changed");
+
+// Row layout of an export
+enum class ExportFormat {
+    Csv,       // Header line, then one comma-separated line per row
+    JsonLines, // One JSON object per line
+    Binary     // EXPORT_BINARY_MAGIC, version, record size, then raw ExportRecords
+};
+
+const char EXPORT_BINARY_MAGIC[8] = { 'P', 'P', 'E', 'X', 'P', 'R', 'T', '1' };
+const uint32_t EXPORT_BINARY_VERSION = 2;
+
+// What to do with a batch when the writer is EXPORT_QUEUE_BATCHES behind
+enum class ExportPolicy {
+    Drop,     // Discard it and count its probes as dropped
+    Coalesce  // Fold it into one row per EXPORT_COALESCE_NS, sent once there is room
+};
+
+// Parse "csv", "jsonl" or "binary"
+bool ParseExportFormat(const char* name, ExportFormat& format);
+
+// Parse "drop" or "coalesce"
+bool ParseExportPolicy(const char* name, ExportPolicy& policy);
+
+// Where formatted rows go. Called from the exporter's writer thread only.
+class ExportSink {
+public:
+    virtual ~ExportSink() = default;
+
+    // Format and write count rows; false on an I/O error
+    virtual bool Write(const ExportRecord* records, size_t count) = 0;
+
+    // Push buffered output to the destination
+    virtual bool Flush() = 0;
+};
+
+// Sink writing format to path, or to stdout when path is "-". Returns
+// nullptr and sets error if the file cannot be created.
+std::unique_ptr<ExportSink> CreateExportSink(ExportFormat format, const std::string& path, std::string& error);
+
+// Streams every finished probe of a SampleStore to a sink. A collector
+// thread follows the store like any other reader (so the probe thread never
+// waits on it) and cuts the records into batches; a writer thread formats
+// and writes them. Between the two sits a queue of at most
+// EXPORT_QUEUE_BATCHES batches: when the sink cannot keep up, whole batches
+// are dropped or coalesced by the policy instead of stalling the collector
+// until the store overwrites what it has not read.
+class Exporter {
+public:
+    Exporter(std::unique_ptr<ExportSink> sink, ExportPolicy policy);
+    ~Exporter();
+
+    // Start following store from its current head
+    void Start(const SampleStore& store);
+
+    // Export everything finished so far, flush and stop both threads
+    void Stop();
+
+    uint64_t Exported() const { return m_Exported.load(); }   // Probes written, one row each
+    uint64_t Coalesced() const { return m_Coalesced.load(); } // Probes written inside coalesced rows
+    uint64_t Dropped() const { return m_Dropped.load(); }     // Probes discarded by the policy or a failed write
+    uint64_t Skipped() const { return m_Skipped.load(); }     // Probes the store overwrote before they were read
+
+private:
+    typedef std::vector<ExportRecord> Batch;
+
+    void RunCollector();
+    void RunWriter();
+
+    // Copy finished records from the store into m_Batch, offering full batches
+    void Collect(bool final);
+
+    // Hand m_Batch to the writer, or apply the policy if it is too far behind.
+    // final waits for room instead.
+    void Offer(bool final);
+
+    // Fold rows into m_Overflow, one row per EXPORT_COALESCE_NS slice
+    void Coalesce(const Batch& batch);
+
+    std::unique_ptr<ExportSink> m_Sink;
+    ExportPolicy m_Policy;
+    const SampleStore* m_Store = nullptr;
+    std::thread m_Collector;
+    std::thread m_Writer;
+    std::atomic<bool> m_Running{false};
+
+    // Collector thread only
+    uint64_t m_Cursor = 0;
+    SampleColumns m_Scratch;
+    Batch m_Batch;
+    Batch m_Overflow;      // Coalesced rows waiting for room in the queue
+
+    // Shared with the writer under m_Mutex
+    std::mutex m_Mutex;
+    std::condition_variable m_Ready;  // Queue gained a batch or the collector finished
+    std::condition_variable m_Room;   // Queue lost a batch
+    std::deque<Batch> m_Queue;
+    std::vector<Batch> m_Free;        // Spent batches, reused to avoid allocating
+    bool m_CollectorDone = false;
+
+    std::atomic<uint64_t> m_Exported{0};
+    std::atomic<uint64_t> m_Coalesced{0};
+    std::atomic<uint64_t> m_Dropped{0};
+    std::atomic<uint64_t> m_Skipped{0};
+};
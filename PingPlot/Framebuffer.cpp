@@ -0,0 +1,312 @@
+#include "Framebuffer.h"
+#include "SessionFile.h" // Crc32
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+// Glyphs for ' ' to '~', one byte per column, bit 0 at the top
+const uint8_t FONT_GLYPHS[95][FONT_WIDTH] = {
+    { 0x00, 0x00, 0x00, 0x00, 0x00 }, // ' '
+    { 0x00, 0x00, 0x5F, 0x00, 0x00 }, // '!'
+    { 0x00, 0x07, 0x00, 0x07, 0x00 }, // '"'
+    { 0x14, 0x7F, 0x14, 0x7F, 0x14 }, // '#'
+    { 0x24, 0x2A, 0x7F, 0x2A, 0x12 }, // '$'
+    { 0x23, 0x13, 0x08, 0x64, 0x62 }, // '%'
+    { 0x36, 0x49, 0x55, 0x22, 0x50 }, // '&'
+    { 0x00, 0x05, 0x03, 0x00, 0x00 }, // '''
+    { 0x00, 0x1C, 0x22, 0x41, 0x00 }, // '('
+    { 0x00, 0x41, 0x22, 0x1C, 0x00 }, // ')'
+    { 0x14, 0x08, 0x3E, 0x08, 0x14 }, // '*'
+    { 0x08, 0x08, 0x3E, 0x08, 0x08 }, // '+'
+    { 0x00, 0x50, 0x30, 0x00, 0x00 }, // ','
+    { 0x08, 0x08, 0x08, 0x08, 0x08 }, // '-'
+    { 0x00, 0x60, 0x60, 0x00, 0x00 }, // '.'
+    { 0x20, 0x10, 0x08, 0x04, 0x02 }, // '/'
+    { 0x3E, 0x51, 0x49, 0x45, 0x3E }, // '0'
+    { 0x00, 0x42, 0x7F, 0x40, 0x00 }, // '1'
+    { 0x42, 0x61, 0x51, 0x49, 0x46 }, // '2'
+    { 0x21, 0x41, 0x45, 0x4B, 0x31 }, // '3'
+    { 0x18, 0x14, 0x12, 0x7F, 0x10 }, // '4'
+    { 0x27, 0x45, 0x45, 0x45, 0x39 }, // '5'
+    { 0x3C, 0x4A, 0x49, 0x49, 0x30 }, // '6'
+    { 0x01, 0x71, 0x09, 0x05, 0x03 }, // '7'
+    { 0x36, 0x49, 0x49, 0x49, 0x36 }, // '8'
+    { 0x06, 0x49, 0x49, 0x29, 0x1E }, // '9'
+    { 0x00, 0x36, 0x36, 0x00, 0x00 }, // ':'
+    { 0x00, 0x56, 0x36, 0x00, 0x00 }, // ';'
+    { 0x08, 0x14, 0x22, 0x41, 0x00 }, // '<'
+    { 0x14, 0x14, 0x14, 0x14, 0x14 }, // '='
+    { 0x00, 0x41, 0x22, 0x14, 0x08 }, // '>'
+    { 0x02, 0x01, 0x51, 0x09, 0x06 }, // '?'
+    { 0x32, 0x49, 0x79, 0x41, 0x3E }, // '@'
+    { 0x7E, 0x11, 0x11, 0x11, 0x7E }, // 'A'
+    { 0x7F, 0x49, 0x49, 0x49, 0x36 }, // 'B'
+    { 0x3E, 0x41, 0x41, 0x41, 0x22 }, // 'C'
+    { 0x7F, 0x41, 0x41, 0x22, 0x1C }, // 'D'
+    { 0x7F, 0x49, 0x49, 0x49, 0x41 }, // 'E'
+    { 0x7F, 0x09, 0x09, 0x09, 0x01 }, // 'F'
+    { 0x3E, 0x41, 0x49, 0x49, 0x7A }, // 'G'
+    { 0x7F, 0x08, 0x08, 0x08, 0x7F }, // 'H'
+    { 0x00, 0x41, 0x7F, 0x41, 0x00 }, // 'I'
+    { 0x20, 0x40, 0x41, 0x3F, 0x01 }, // 'J'
+    { 0x7F, 0x08, 0x14, 0x22, 0x41 }, // 'K'
+    { 0x7F, 0x40, 0x40, 0x40, 0x40 }, // 'L'
+    { 0x7F, 0x02, 0x0C, 0x02, 0x7F }, // 'M'
+    { 0x7F, 0x04, 0x08, 0x10, 0x7F }, // 'N'
+    { 0x3E, 0x41, 0x41, 0x41, 0x3E }, // 'O'
+    { 0x7F, 0x09, 0x09, 0x09, 0x06 }, // 'P'
+    { 0x3E, 0x41, 0x51, 0x21, 0x5E }, // 'Q'
+    { 0x7F, 0x09, 0x19, 0x29, 0x46 }, // 'R'
+    { 0x46, 0x49, 0x49, 0x49, 0x31 }, // 'S'
+    { 0x01, 0x01, 0x7F, 0x01, 0x01 }, // 'T'
+    { 0x3F, 0x40, 0x40, 0x40, 0x3F }, // 'U'
+    { 0x1F, 0x20, 0x40, 0x20, 0x1F }, // 'V'
+    { 0x3F, 0x40, 0x38, 0x40, 0x3F }, // 'W'
+    { 0x63, 0x14, 0x08, 0x14, 0x63 }, // 'X'
+    { 0x07, 0x08, 0x70, 0x08, 0x07 }, // 'Y'
+    { 0x61, 0x51, 0x49, 0x45, 0x43 }, // 'Z'
+    { 0x00, 0x7F, 0x41, 0x41, 0x00 }, // '['
+    { 0x02, 0x04, 0x08, 0x10, 0x20 }, // '\'
+    { 0x00, 0x41, 0x41, 0x7F, 0x00 }, // ']'
+    { 0x04, 0x02, 0x01, 0x02, 0x04 }, // '^'
+    { 0x40, 0x40, 0x40, 0x40, 0x40 }, // '_'
+    { 0x00, 0x01, 0x02, 0x04, 0x00 }, // '`'
+    { 0x20, 0x54, 0x54, 0x54, 0x78 }, // 'a'
+    { 0x7F, 0x48, 0x44, 0x44, 0x38 }, // 'b'
+    { 0x38, 0x44, 0x44, 0x44, 0x20 }, // 'c'
+    { 0x38, 0x44, 0x44, 0x48, 0x7F }, // 'd'
+    { 0x38, 0x54, 0x54, 0x54, 0x18 }, // 'e'
+    { 0x08, 0x7E, 0x09, 0x01, 0x02 }, // 'f'
+    { 0x0C, 0x52, 0x52, 0x52, 0x3E }, // 'g'
+    { 0x7F, 0x08, 0x04, 0x04, 0x78 }, // 'h'
+    { 0x00, 0x44, 0x7D, 0x40, 0x00 }, // 'i'
+    { 0x20, 0x40, 0x44, 0x3D, 0x00 }, // 'j'
+    { 0x7F, 0x10, 0x28, 0x44, 0x00 }, // 'k'
+    { 0x00, 0x41, 0x7F, 0x40, 0x00 }, // 'l'
+    { 0x7C, 0x04, 0x18, 0x04, 0x78 }, // 'm'
+    { 0x7C, 0x08, 0x04, 0x04, 0x78 }, // 'n'
+    { 0x38, 0x44, 0x44, 0x44, 0x38 }, // 'o'
+    { 0x7C, 0x14, 0x14, 0x14, 0x08 }, // 'p'
+    { 0x08, 0x14, 0x14, 0x18, 0x7C }, // 'q'
+    { 0x7C, 0x08, 0x04, 0x04, 0x08 }, // 'r'
+    { 0x48, 0x54, 0x54, 0x54, 0x20 }, // 's'
+    { 0x04, 0x3F, 0x44, 0x40, 0x20 }, // 't'
+    { 0x3C, 0x40, 0x40, 0x20, 0x7C }, // 'u'
+    { 0x1C, 0x20, 0x40, 0x20, 0x1C }, // 'v'
+    { 0x3C, 0x40, 0x30, 0x40, 0x3C }, // 'w'
+    { 0x44, 0x28, 0x10, 0x28, 0x44 }, // 'x'
+    { 0x0C, 0x50, 0x50, 0x50, 0x3C }, // 'y'
+    { 0x44, 0x64, 0x54, 0x4C, 0x44 }, // 'z'
+    { 0x00, 0x08, 0x36, 0x41, 0x00 }, // '{'
+    { 0x00, 0x00, 0x7F, 0x00, 0x00 }, // '|'
+    { 0x00, 0x41, 0x36, 0x08, 0x00 }, // '}'
+    { 0x08, 0x04, 0x08, 0x10, 0x08 }, // '~'
+};
+
+// fopen without the MSVC deprecation error
+FILE* CreateImageFile(const std::string& path) {
+#ifdef _WIN32
+    FILE* file = nullptr;
+    return fopen_s(&file, path.c_str(), "wb") == 0 ? file : nullptr;
+#else
+    return fopen(path.c_str(), "wb");
+#endif
+}
+
+void PutBigEndian(std::vector<uint8_t>& out, uint32_t value) {
+    out.push_back(static_cast<uint8_t>(value >> 24));
+    out.push_back(static_cast<uint8_t>(value >> 16));
+    out.push_back(static_cast<uint8_t>(value >> 8));
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+// Append a PNG chunk: length, type, data, CRC of type and data
+void PutChunk(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& data) {
+    PutBigEndian(out, static_cast<uint32_t>(data.size()));
+    size_t typeAt = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    PutBigEndian(out, Crc32(0, &out[typeAt], 4 + data.size()));
+}
+
+} // namespace
+
+void Framebuffer::Resize(int width, int height) {
+    m_Width = width > 0 ? width : 0;
+    m_Height = height > 0 ? height : 0;
+    m_Pixels.resize(static_cast<size_t>(m_Width) * m_Height);
+    ResetClip();
+}
+
+void Framebuffer::SetClip(int x0, int y0, int x1, int y1) {
+    m_ClipX0 = std::max(x0, 0);
+    m_ClipY0 = std::max(y0, 0);
+    m_ClipX1 = std::min(x1, m_Width);
+    m_ClipY1 = std::min(y1, m_Height);
+}
+
+void Framebuffer::ResetClip() {
+    SetClip(0, 0, m_Width, m_Height);
+}
+
+void Framebuffer::Fill(Pixel color) {
+    std::fill(m_Pixels.begin(), m_Pixels.end(), color);
+}
+
+void Framebuffer::FillRect(int x0, int y0, int x1, int y1, Pixel color) {
+    x0 = std::max(x0, m_ClipX0);
+    y0 = std::max(y0, m_ClipY0);
+    x1 = std::min(x1, m_ClipX1);
+    y1 = std::min(y1, m_ClipY1);
+    for (int y = y0; y < y1; y++) {
+        std::fill(Row(y) + x0, Row(y) + std::max(x0, x1), color);
+    }
+}
+
+void Framebuffer::Rectangle(int x0, int y0, int x1, int y1, Pixel color) {
+    FillRect(x0, y0, x1, y0 + 1, color);
+    FillRect(x0, y1 - 1, x1, y1, color);
+    FillRect(x0, y0, x0 + 1, y1, color);
+    FillRect(x1 - 1, y0, x1, y1, color);
+}
+
+void Framebuffer::VLine(int x, int y0, int y1, Pixel color) {
+    if (y0 > y1) std::swap(y0, y1);
+    FillRect(x, y0, x + 1, y1 + 1, color);
+}
+
+void Framebuffer::Line(int x0, int y0, int x1, int y1, Pixel color, int thickness) {
+    int dx = std::abs(x1 - x0);
+    int dy = -std::abs(y1 - y0);
+    int stepX = x0 < x1 ? 1 : -1;
+    int stepY = y0 < y1 ? 1 : -1;
+    int error = dx + dy;
+    for (;;) {
+        for (int t = 0; t < thickness; t++) {
+            Plot(x0, y0 + t, color);
+        }
+        if (x0 == x1 && y0 == y1) break;
+        int doubled = 2 * error;
+        if (doubled >= dy) {
+            error += dy;
+            x0 += stepX;
+        }
+        if (doubled <= dx) {
+            error += dx;
+            y0 += stepY;
+        }
+    }
+}
+
+void Framebuffer::DrawText(int x, int y, const char* text, Pixel color, int scale) {
+    for (; *text; text++, x += FONT_ADVANCE * scale) {
+        unsigned char c = static_cast<unsigned char>(*text);
+        if (c < ' ' || c > '~') c = '?';
+        const uint8_t* glyph = FONT_GLYPHS[c - ' '];
+        for (int column = 0; column < FONT_WIDTH; column++) {
+            for (int row = 0; row < FONT_HEIGHT; row++) {
+                if (glyph[column] & (1 << row)) {
+                    FillRect(x + column * scale, y + row * scale,
+                        x + (column + 1) * scale, y + (row + 1) * scale, color);
+                }
+            }
+        }
+    }
+}
+
+int Framebuffer::TextWidth(const char* text, int scale) {
+    size_t length = strlen(text);
+    return length ? static_cast<int>(length * FONT_ADVANCE - 1) * scale : 0;
+}
+
+void Framebuffer::ScrollLeft(int x0, int y0, int x1, int y1, int dx) {
+    x0 = std::max(x0, 0);
+    y0 = std::max(y0, 0);
+    x1 = std::min(x1, m_Width);
+    y1 = std::min(y1, m_Height);
+    if (dx <= 0 || dx >= x1 - x0) return;
+    for (int y = y0; y < y1; y++) {
+        Pixel* row = Row(y);
+        memmove(row + x0, row + x0 + dx, static_cast<size_t>(x1 - x0 - dx) * sizeof(Pixel));
+    }
+}
+
+bool Framebuffer::WritePpm(const std::string& path) const {
+    FILE* file = CreateImageFile(path);
+    if (!file) return false;
+    fprintf(file, "P6\n%d %d\n255\n", m_Width, m_Height);
+    std::vector<uint8_t> row(static_cast<size_t>(m_Width) * 3);
+    bool ok = true;
+    for (int y = 0; y < m_Height && ok; y++) {
+        const Pixel* pixels = Row(y);
+        for (int x = 0; x < m_Width; x++) {
+            row[x * 3] = static_cast<uint8_t>(pixels[x] >> 16);
+            row[x * 3 + 1] = static_cast<uint8_t>(pixels[x] >> 8);
+            row[x * 3 + 2] = static_cast<uint8_t>(pixels[x]);
+        }
+        ok = fwrite(row.data(), 1, row.size(), file) == row.size();
+    }
+    return fclose(file) == 0 && ok;
+}
+
+bool Framebuffer::WritePng(const std::string& path) const {
+    // Filter byte 0 plus RGB per row
+    std::vector<uint8_t> raw;
+    raw.reserve(static_cast<size_t>(m_Width * 3 + 1) * m_Height);
+    for (int y = 0; y < m_Height; y++) {
+        raw.push_back(0);
+        const Pixel* pixels = Row(y);
+        for (int x = 0; x < m_Width; x++) {
+            raw.push_back(static_cast<uint8_t>(pixels[x] >> 16));
+            raw.push_back(static_cast<uint8_t>(pixels[x] >> 8));
+            raw.push_back(static_cast<uint8_t>(pixels[x]));
+        }
+    }
+
+    // zlib stream of stored deflate blocks; snapshots favour speed and
+    // exactness over size
+    std::vector<uint8_t> zlib = { 0x78, 0x01 };
+    const size_t STORED_BLOCK_MAX = 65535;
+    size_t offset = 0;
+    do {
+        size_t length = std::min(raw.size() - offset, STORED_BLOCK_MAX);
+        bool last = (offset + length == raw.size());
+        zlib.push_back(last ? 1 : 0);
+        zlib.push_back(static_cast<uint8_t>(length));
+        zlib.push_back(static_cast<uint8_t>(length >> 8));
+        zlib.push_back(static_cast<uint8_t>(~length));
+        zlib.push_back(static_cast<uint8_t>(~length >> 8));
+        zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + length);
+        offset += length;
+    } while (offset < raw.size());
+    uint32_t a = 1;
+    uint32_t b = 0;
+    for (uint8_t value : raw) {
+        a = (a + value) % 65521;
+        b = (b + a) % 65521;
+    }
+    PutBigEndian(zlib, (b << 16) | a);
+
+    std::vector<uint8_t> header;
+    PutBigEndian(header, static_cast<uint32_t>(m_Width));
+    PutBigEndian(header, static_cast<uint32_t>(m_Height));
+    header.push_back(8); // Bits per channel
+    header.push_back(2); // RGB
+    header.push_back(0); // Deflate
+    header.push_back(0); // Adaptive filtering
+    header.push_back(0); // No interlace
+
+    static const uint8_t PNG_SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    std::vector<uint8_t> file(PNG_SIGNATURE, PNG_SIGNATURE + 8);
+    PutChunk(file, "IHDR", header);
+    PutChunk(file, "IDAT", zlib);
+    PutChunk(file, "IEND", std::vector<uint8_t>());
+
+    FILE* out = CreateImageFile(path);
+    if (!out) return false;
+    bool ok = fwrite(file.data(), 1, file.size(), out) == file.size();
+    return fclose(out) == 0 && ok;
+}
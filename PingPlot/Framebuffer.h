@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 0x00RRGGBB. Rows are stored top-down, which is the memory layout of a
+// 32-bit top-down DIB, so Windows can blit a Framebuffer as it is.
+typedef uint32_t Pixel;
+
+inline Pixel MakePixel(uint8_t r, uint8_t g, uint8_t b) {
+    return (static_cast<Pixel>(r) << 16) | (static_cast<Pixel>(g) << 8) | b;
+}
+
+// Built-in 5x7 font, one pixel of spacing between characters
+const int FONT_WIDTH = 5;
+const int FONT_HEIGHT = 7;
+const int FONT_ADVANCE = FONT_WIDTH + 1;
+
+// A persistent in-memory RGB image with the few primitives the graph needs.
+// Every drawing call is clipped to the image and to the clip rectangle.
+class Framebuffer {
+public:
+    // Reallocate to width x height (contents are undefined afterwards)
+    void Resize(int width, int height);
+
+    int Width() const { return m_Width; }
+    int Height() const { return m_Height; }
+    const Pixel* Data() const { return m_Pixels.data(); }
+    Pixel* Row(int y) { return &m_Pixels[static_cast<size_t>(y) * m_Width]; }
+    const Pixel* Row(int y) const { return &m_Pixels[static_cast<size_t>(y) * m_Width]; }
+
+    // Limit drawing to [x0, x1) x [y0, y1); ResetClip allows the whole image
+    void SetClip(int x0, int y0, int x1, int y1);
+    void ResetClip();
+
+    void Fill(Pixel color);
+
+    // Fill [x0, x1) x [y0, y1)
+    void FillRect(int x0, int y0, int x1, int y1, Pixel color);
+
+    // Outline of [x0, x1) x [y0, y1)
+    void Rectangle(int x0, int y0, int x1, int y1, Pixel color);
+
+    void Plot(int x, int y, Pixel color) {
+        if (x >= m_ClipX0 && x < m_ClipX1 && y >= m_ClipY0 && y < m_ClipY1) {
+            m_Pixels[static_cast<size_t>(y) * m_Width + x] = color;
+        }
+    }
+
+    // Vertical run [y0, y1] (either order) at x
+    void VLine(int x, int y0, int y1, Pixel color);
+
+    // Bresenham line including both ends, `thickness` pixels tall
+    void Line(int x0, int y0, int x1, int y1, Pixel color, int thickness = 1);
+
+    // Text in the built-in font, each font pixel drawn as scale x scale.
+    // (x, y) is the top left corner; characters outside ' '..'~' draw as '?'.
+    void DrawText(int x, int y, const char* text, Pixel color, int scale = 1);
+    static int TextWidth(const char* text, int scale = 1);
+
+    // Move the pixels of [x0, x1) x [y0, y1) dx pixels to the left. The
+    // rightmost dx columns of the rectangle keep their old contents.
+    void ScrollLeft(int x0, int y0, int x1, int y1, int dx);
+
+    // Binary PPM (P6) and PNG (uncompressed deflate) snapshots
+    bool WritePpm(const std::string& path) const;
+    bool WritePng(const std::string& path) const;
+
+private:
+    int m_Width = 0;
+    int m_Height = 0;
+    std::vector<Pixel> m_Pixels;
+    int m_ClipX0 = 0;
+    int m_ClipY0 = 0;
+    int m_ClipX1 = 0;
+    int m_ClipY1 = 0;
+};
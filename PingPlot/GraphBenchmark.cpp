@@ -0,0 +1,504 @@
+// Frame-time benchmark for the graph pipeline. Feeds a synthetic sample
+// stream into a SampleStore and WindowStats the way the sampler does, and
+// runs the per-frame work of DrawGraph headless at 30 frames per second of
+// virtual time. Every point count (samples in the history window) is swept
+// over every width and strategy; for each stage it reports p50/p99 frame
+// time, heap allocations per frame and an estimate of the bytes the stage
+// reads and writes. Output is a table, or CSV / JSON Lines to diff builds.
+
+#include "Clock.h"
+#include "ColumnDecimator.h"
+#include "GraphRenderer.h"
+#include "Sampler.h"
+#include "WindowStats.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+// Count every heap allocation the pipeline makes
+static std::atomic<uint64_t> g_Allocations{0};
+
+void* operator new(size_t size) {
+    g_Allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* memory = malloc(size ? size : 1)) return memory;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+    free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    free(memory);
+}
+
+namespace {
+
+const int64_t FRAME_NS = 1000000000LL / 30;  // Virtual time between frames
+const int WARMUP_FRAMES = 10;
+const int DEFAULT_FRAMES = 120;
+
+// Bytes per record the graph reads from the store (send time, RTT, status)
+const size_t RECORD_BYTES = sizeof(int64_t) * 2 + sizeof(SampleStatus);
+
+// Bytes WindowStats touches per added sample: its ring entry and a
+// histogram bucket (the monotonic queues are amortized into this)
+const size_t STATS_BYTES_PER_SAMPLE = 32;
+
+enum Stage {
+    STAGE_SNAPSHOT, // Copy the new records out of the store
+    STAGE_STATS,    // Window statistics for the new records, published and read back
+    STAGE_SCALE,    // Y scale hysteresis
+    STAGE_DECIMATE, // Fold into column envelopes, gather the visible columns, LTTB
+    STAGE_RASTER,   // GraphRenderer::Render
+    STAGE_TOTAL,
+    STAGE_COUNT
+};
+
+const char* const STAGE_NAMES[STAGE_COUNT] = { "snapshot", "stats", "scale", "decimate", "raster", "total" };
+
+enum class Strategy {
+    Envelope, // Envelopes with incremental rasterization (the default)
+    Lttb,     // LTTB over the envelopes; redrawn in full
+    Full      // Envelopes, but every frame redrawn in full
+};
+
+const char* StrategyName(Strategy strategy) {
+    switch (strategy) {
+        case Strategy::Envelope: return "envelope";
+        case Strategy::Lttb: return "lttb";
+        case Strategy::Full: return "full";
+    }
+    return "?";
+}
+
+bool ParseStrategy(const std::string& name, Strategy& strategy) {
+    if (name == "envelope") {
+        strategy = Strategy::Envelope;
+    } else if (name == "lttb") {
+        strategy = Strategy::Lttb;
+    } else if (name == "full") {
+        strategy = Strategy::Full;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+enum class OutputFormat { Table, Csv, JsonLines };
+
+// Deterministic ping-like stream: a slowly wandering base RTT with jitter,
+// occasional spikes and a little loss, N samples per history window
+class SyntheticStream {
+public:
+    SyntheticStream(uint64_t points, int64_t historyNs)
+        : m_StepNs(std::max<int64_t>(1, historyNs / static_cast<int64_t>(points))), m_Random(12345) {}
+
+    int64_t NextSendNs() const { return m_SendNs; }
+
+    void Next(int64_t& sendTimeNs, int64_t& rttNs, SampleStatus& status) {
+        sendTimeNs = m_SendNs;
+        m_SendNs += m_StepNs;
+        m_Sequence++;
+
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        m_BaseMs += (unit(m_Random) - 0.5) * 0.2;
+        m_BaseMs = std::min(40.0, std::max(5.0, m_BaseMs));
+        double ms = m_BaseMs + unit(m_Random) * 2.0;
+        if (unit(m_Random) < 0.001) ms *= 10.0;
+        rttNs = static_cast<int64_t>(ms * 1e6);
+        status = unit(m_Random) < 0.005 ? SampleStatus::Timeout : SampleStatus::Ok;
+    }
+
+    uint32_t Sequence() const { return m_Sequence; }
+
+private:
+    int64_t m_StepNs;
+    int64_t m_SendNs = 1000000000LL;
+    uint32_t m_Sequence = 0;
+    double m_BaseMs = 20.0;
+    std::mt19937_64 m_Random;
+};
+
+// The producer side for one point count, shared by every width and strategy
+struct Series {
+    Series(uint64_t points, int64_t historyNs, size_t capacity)
+        : stream(points, historyNs), store(capacity), stats(capacity), historyNs(historyNs) {}
+
+    // Store the samples sent before untilNs; returns them in `added`
+    void Produce(int64_t untilNs) {
+        added.clear();
+        while (stream.NextSendNs() < untilNs) {
+            Sample sample;
+            stream.Next(sample.sendTimeNs, sample.rttNs, sample.status);
+            store.Push(sample.sendTimeNs, stream.Sequence(), sample.rttNs, sample.status, historyNs);
+            added.push_back(sample);
+        }
+    }
+
+    struct Sample {
+        int64_t sendTimeNs;
+        int64_t rttNs;
+        SampleStatus status;
+    };
+
+    SyntheticStream stream;
+    SampleStore store;
+    WindowStats stats;
+    PublishedStats published;
+    int64_t historyNs;
+    int64_t nowNs = 0;
+    std::vector<Sample> added;
+};
+
+struct StageResult {
+    double p50Us = 0.0;
+    double p99Us = 0.0;
+    double allocationsPerFrame = 0.0;
+    double bytesPerFrame = 0.0;
+};
+
+struct CaseResult {
+    uint64_t points;
+    int width;
+    int height;
+    Strategy strategy;
+    int frames;
+    StageResult cold;  // First frame after (re)configuring: whole window
+    StageResult stages[STAGE_COUNT];
+};
+
+// Per-frame measurements of one stage
+struct StageSamples {
+    std::vector<int64_t> ns;
+    uint64_t allocations = 0;
+    double bytes = 0.0;
+
+    StageResult Result(int frames) {
+        StageResult result;
+        std::sort(ns.begin(), ns.end());
+        if (!ns.empty()) {
+            result.p50Us = ns[(ns.size() - 1) / 2] / 1e3;
+            result.p99Us = ns[(ns.size() - 1) * 99 / 100] / 1e3;
+        }
+        result.allocationsPerFrame = static_cast<double>(allocations) / frames;
+        result.bytesPerFrame = bytes / frames;
+        return result;
+    }
+};
+
+// Times one stage and counts its allocations
+class StageTimer {
+public:
+    explicit StageTimer(StageSamples& samples)
+        : m_Samples(samples), m_Allocations(g_Allocations.load()), m_StartNs(MonotonicNowNs()) {}
+
+    ~StageTimer() {
+        int64_t elapsedNs = MonotonicNowNs() - m_StartNs;
+        m_Samples.allocations += g_Allocations.load() - m_Allocations;
+        m_Samples.ns.push_back(elapsedNs);
+    }
+
+private:
+    StageSamples& m_Samples;
+    uint64_t m_Allocations;
+    int64_t m_StartNs;
+};
+
+// State of the graph side, as DrawGraph keeps it
+struct GraphState {
+    GraphRenderer renderer;
+    ColumnDecimator decimator;
+    uint64_t cursor = 0;
+    SampleColumns scratch;
+    std::vector<const ColumnEnvelope*> columns;
+    std::vector<int64_t> lttbPoints;
+    double scaleMs = 100.0;
+    int64_t firstColumn = 0;
+};
+
+// One frame of DrawGraph. Decimation reads the store the way
+// ColumnDecimator::Update does, split so the copy is timed on its own.
+void RunFrame(Series& series, GraphState& graph, Strategy strategy, bool cold, StageSamples (&samples)[STAGE_COUNT]) {
+    int width = graph.renderer.PlotWidth();
+    int64_t totalStart = MonotonicNowNs();
+    uint64_t totalAllocations = g_Allocations.load();
+    size_t records;
+
+    {
+        StageTimer timer(samples[STAGE_SNAPSHOT]);
+        series.store.ReadFrom(graph.cursor, graph.scratch, COLUMN_SEND_TIME | COLUMN_RTT | COLUMN_STATUS);
+        records = graph.scratch.Size();
+    }
+    samples[STAGE_SNAPSHOT].bytes += 2.0 * records * RECORD_BYTES;
+
+    GraphFrame frame;
+    frame.historySeconds = series.historyNs / 1e9;
+    {
+        // Done by the sampler thread in the application
+        StageTimer timer(samples[STAGE_STATS]);
+        if (!cold) {
+            for (const Series::Sample& sample : series.added) {
+                series.stats.Add(sample.sendTimeNs, sample.rttNs, sample.status, series.historyNs);
+            }
+        }
+        WindowSummary summary;
+        series.stats.Summarize(summary);
+        series.published.Store(summary);
+        series.published.Load(frame.stats);
+    }
+    samples[STAGE_STATS].bytes += static_cast<double>(cold ? 0 : series.added.size()) * STATS_BYTES_PER_SAMPLE;
+
+    {
+        StageTimer timer(samples[STAGE_SCALE]);
+        graph.scaleMs = AdjustGraphScale(graph.scaleMs, frame.stats.maxMs);
+        frame.maxPingMs = graph.scaleMs;
+    }
+
+    int64_t previousFirstColumn = graph.firstColumn;
+    {
+        StageTimer timer(samples[STAGE_DECIMATE]);
+        for (size_t i = 0; i < records; i++) {
+            graph.decimator.Add(graph.scratch.sendTimeNs[i], graph.scratch.rttNs[i], graph.scratch.status[i]);
+        }
+        frame.hasData = graph.decimator.HasData();
+        frame.dirtyColumn = graph.decimator.TakeDirtyColumn();
+        if (strategy == Strategy::Full) frame.dirtyColumn = GRAPH_DIRTY_ALL;
+        if (frame.hasData) {
+            graph.firstColumn = graph.decimator.NewestColumn() - width + 1;
+            graph.columns.resize(width);
+            for (int i = 0; i < width; i++) {
+                graph.columns[i] = graph.decimator.Column(graph.firstColumn + i);
+            }
+            if (strategy == Strategy::Lttb) {
+                SelectLttb(graph.columns, graph.lttbPoints);
+                frame.lttbPoints = &graph.lttbPoints;
+            }
+            frame.columns = &graph.columns;
+            frame.firstColumn = graph.firstColumn;
+        }
+    }
+    samples[STAGE_DECIMATE].bytes += static_cast<double>(records) * sizeof(ColumnEnvelope) +
+        static_cast<double>(width) * (sizeof(ColumnEnvelope) + sizeof(void*)) +
+        (strategy == Strategy::Lttb ? static_cast<double>(width) * (sizeof(ColumnEnvelope) + sizeof(int64_t)) : 0.0);
+
+    {
+        StageTimer timer(samples[STAGE_RASTER]);
+        graph.renderer.Render(frame);
+    }
+    // Pixels redrawn, plus the scroll (read and write of the plot) and the
+    // stats strip
+    double plotBytes = static_cast<double>(width) * graph.renderer.PlotHeight() * sizeof(Pixel);
+    int redrawn = graph.renderer.LastRedrawnColumns();
+    samples[STAGE_RASTER].bytes += static_cast<double>(redrawn) * graph.renderer.PlotHeight() * sizeof(Pixel) +
+        (redrawn < width && graph.firstColumn != previousFirstColumn ? 2.0 * plotBytes : 0.0) +
+        static_cast<double>(graph.renderer.Frame().Width()) * (GRAPH_MARGIN + GRAPH_TOP_EXTRA - GRAPH_STATS_TOP) * sizeof(Pixel);
+
+    int64_t totalNs = MonotonicNowNs() - totalStart;
+    samples[STAGE_TOTAL].allocations += g_Allocations.load() - totalAllocations;
+    samples[STAGE_TOTAL].ns.push_back(totalNs);
+}
+
+CaseResult RunCase(Series& series, int width, int height, Strategy strategy, int frames) {
+    CaseResult result;
+    result.points = 0;
+    result.width = width;
+    result.height = height;
+    result.strategy = strategy;
+    result.frames = frames;
+
+    GraphState graph;
+    graph.renderer.Resize(width, height);
+    graph.renderer.SetPalette(GraphPalette::Dark());
+    int plotWidth = graph.renderer.PlotWidth();
+    graph.decimator.Configure(plotWidth, std::max<int64_t>(1, series.historyNs / std::max(1, plotWidth)));
+    graph.cursor = series.store.VisibleBegin();
+
+    // Cold frame: the whole window, as after a resize or history change
+    StageSamples coldSamples[STAGE_COUNT];
+    RunFrame(series, graph, strategy, true, coldSamples);
+    result.cold = coldSamples[STAGE_TOTAL].Result(1);
+    result.cold.bytesPerFrame = 0.0;
+    for (int stage = 0; stage < STAGE_TOTAL; stage++) {
+        result.cold.bytesPerFrame += coldSamples[stage].bytes;
+    }
+
+    // Reserved so the measurement itself does not allocate
+    StageSamples samples[STAGE_COUNT];
+    StageSamples warmup[STAGE_COUNT];
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        samples[stage].ns.reserve(frames);
+        warmup[stage].ns.reserve(WARMUP_FRAMES);
+    }
+    for (int i = 0; i < WARMUP_FRAMES + frames; i++) {
+        series.nowNs += FRAME_NS;
+        series.Produce(series.nowNs);
+        RunFrame(series, graph, strategy, false, i < WARMUP_FRAMES ? warmup : samples);
+    }
+
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        result.stages[stage] = samples[stage].Result(frames);
+    }
+    result.stages[STAGE_TOTAL].bytesPerFrame = 0.0;
+    for (int stage = 0; stage < STAGE_TOTAL; stage++) {
+        result.stages[STAGE_TOTAL].bytesPerFrame += result.stages[stage].bytesPerFrame;
+    }
+    return result;
+}
+
+void PrintRow(OutputFormat format, const CaseResult& result, const char* stage, const StageResult& row) {
+    const char* strategy = StrategyName(result.strategy);
+    switch (format) {
+        case OutputFormat::Table:
+            printf("%10llu %5dx%-5d %-9s %-9s %10.1f %10.1f %8.2f %14.0f\n",
+                static_cast<unsigned long long>(result.points), result.width, result.height, strategy, stage,
+                row.p50Us, row.p99Us, row.allocationsPerFrame, row.bytesPerFrame);
+            break;
+        case OutputFormat::Csv:
+            printf("%llu,%d,%d,%s,%s,%d,%.3f,%.3f,%.3f,%.0f\n",
+                static_cast<unsigned long long>(result.points), result.width, result.height, strategy, stage,
+                result.frames, row.p50Us, row.p99Us, row.allocationsPerFrame, row.bytesPerFrame);
+            break;
+        case OutputFormat::JsonLines:
+            printf("{\"points\":%llu,\"width\":%d,\"height\":%d,\"strategy\":\"%s\",\"stage\":\"%s\",\"frames\":%d,"
+                "\"p50_us\":%.3f,\"p99_us\":%.3f,\"allocs_per_frame\":%.3f,\"bytes_per_frame\":%.0f}\n",
+                static_cast<unsigned long long>(result.points), result.width, result.height, strategy, stage,
+                result.frames, row.p50Us, row.p99Us, row.allocationsPerFrame, row.bytesPerFrame);
+            break;
+    }
+    fflush(stdout);
+}
+
+void PrintHeader(OutputFormat format) {
+    if (format == OutputFormat::Table) {
+        printf("%10s %-11s %-9s %-9s %10s %10s %8s %14s\n",
+            "points", "size", "strategy", "stage", "p50 us", "p99 us", "allocs", "bytes/frame");
+    } else if (format == OutputFormat::Csv) {
+        printf("points,width,height,strategy,stage,frames,p50_us,p99_us,allocs_per_frame,bytes_per_frame\n");
+    }
+}
+
+// Comma-separated list of positive numbers; a k or M suffix multiplies
+bool ParseList(const char* text, std::vector<uint64_t>& values) {
+    values.clear();
+    while (*text) {
+        char* end;
+        double value = strtod(text, &end);
+        if (end == text || value <= 0) return false;
+        if (*end == 'k' || *end == 'K') {
+            value *= 1e3;
+            end++;
+        } else if (*end == 'M') {
+            value *= 1e6;
+            end++;
+        }
+        values.push_back(static_cast<uint64_t>(value));
+        if (*end == ',') end++;
+        else if (*end) return false;
+        text = end;
+    }
+    return !values.empty();
+}
+
+void PrintUsage() {
+    fprintf(stderr,
+        "Usage: pingplot-graph-bench [options]\n"
+        "  --points <n,...>            Samples in the history window (default: 100,1k,10k,100k,1M,10M)\n"
+        "  --widths <w,...>            Window widths in pixels; height is 9/16 of it, at least 300 (default: 400,1280,1920,3840)\n"
+        "  --strategies <s,...>        envelope, lttb and/or full (default: envelope,lttb,full)\n"
+        "  --frames <n>                Measured frames per case, after %d warmup frames (default: %d)\n"
+        "  --history <s>               History window (default: %.0f)\n"
+        "  --format <table|csv|jsonl>  Output format (default: table)\n"
+        "Stage \"cold\" is the first frame after configuring, which reads the whole window\n",
+        WARMUP_FRAMES, DEFAULT_FRAMES, HISTORY_SECONDS);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::vector<uint64_t> points = { 100, 1000, 10000, 100000, 1000000, 10000000 };
+    std::vector<uint64_t> widths = { 400, 1280, 1920, 3840 };
+    std::vector<Strategy> strategies = { Strategy::Envelope, Strategy::Lttb, Strategy::Full };
+    int frames = DEFAULT_FRAMES;
+    double historySeconds = HISTORY_SECONDS;
+    OutputFormat format = OutputFormat::Table;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        bool hasValue = (i + 1 < argc);
+        bool ok = hasValue;
+        if (strcmp(arg, "--points") == 0 && hasValue) {
+            ok = ParseList(argv[++i], points);
+        } else if (strcmp(arg, "--widths") == 0 && hasValue) {
+            ok = ParseList(argv[++i], widths);
+        } else if (strcmp(arg, "--strategies") == 0 && hasValue) {
+            strategies.clear();
+            std::string list = argv[++i];
+            size_t start = 0;
+            while (ok && start <= list.size()) {
+                size_t comma = list.find(',', start);
+                if (comma == std::string::npos) comma = list.size();
+                Strategy strategy = Strategy::Envelope;
+                ok = ParseStrategy(list.substr(start, comma - start), strategy);
+                strategies.push_back(strategy);
+                start = comma + 1;
+            }
+        } else if (strcmp(arg, "--frames") == 0 && hasValue) {
+            frames = atoi(argv[++i]);
+            ok = frames > 0;
+        } else if (strcmp(arg, "--history") == 0 && hasValue) {
+            historySeconds = atof(argv[++i]);
+            ok = historySeconds >= 1.0;
+        } else if (strcmp(arg, "--format") == 0 && hasValue) {
+            const char* name = argv[++i];
+            if (strcmp(name, "table") == 0) {
+                format = OutputFormat::Table;
+            } else if (strcmp(name, "csv") == 0) {
+                format = OutputFormat::Csv;
+            } else if (strcmp(name, "jsonl") == 0) {
+                format = OutputFormat::JsonLines;
+            } else {
+                ok = false;
+            }
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            PrintUsage();
+            return 2;
+        }
+    }
+
+    PrintHeader(format);
+    int64_t historyNs = static_cast<int64_t>(historySeconds * 1e9);
+    for (uint64_t count : points) {
+        // Room for the window plus the frames the cases stream in
+        size_t capacity = 1024;
+        while (capacity < count * 2) capacity <<= 1;
+        Series series(count, historyNs, capacity);
+        series.nowNs = series.stream.NextSendNs() + historyNs;
+        series.Produce(series.nowNs);
+        for (const Series::Sample& sample : series.added) {
+            series.stats.Add(sample.sendTimeNs, sample.rttNs, sample.status, historyNs);
+        }
+
+        for (uint64_t width : widths) {
+            int height = std::max(300, static_cast<int>(width * 9 / 16));
+            for (Strategy strategy : strategies) {
+                CaseResult result = RunCase(series, static_cast<int>(width), height, strategy, frames);
+                result.points = count;
+                PrintRow(format, result, "cold", result.cold);
+                for (int stage = 0; stage < STAGE_COUNT; stage++) {
+                    PrintRow(format, result, STAGE_NAMES[stage], result.stages[stage]);
+                }
+            }
+        }
+    }
+    return 0;
+}
@@ -1,261 +1,195 @@
 #include "GraphDrawing.h"
-#include <cmath> // For sqrt function
+#include "Clock.h"
+#include "GraphRenderer.h"
+#include "WindowStats.h"
 
-// Function to calculate jitter (standard deviation of ping times)
-double CalculateJitter(const std::vector<double>& pingData) {
-    if (pingData.size() <= 1) {
-        return 0.0;
-    }
-    
-    // Calculate mean first
-    double sum = 0.0;
-    for (const auto& ping : pingData) {
-        sum += ping;
-    }
-    double mean = sum / pingData.size();
-    
-    // Calculate sum of squared differences
-    double sqSum = 0.0;
-    for (const auto& ping : pingData) {
-        double diff = ping - mean;
-        sqSum += diff * diff;
+// Replayed session as last folded into g_GraphDecimator
+static bool s_ReplayDirty = true;
+static WindowStats s_ReplayStats;
+static double s_ReplayPingsPerSecond = 0.0;
+
+void InvalidateReplay() {
+    s_ReplayDirty = true;
+}
+
+// Fold the last historyNs of the replayed session into the decimator and
+// the replay statistics. Records are read straight from the file mapping,
+// starting at the first one inside the window.
+static void LoadReplay(int64_t historyNs) {
+    s_ReplayStats.Reset();
+    s_ReplayPingsPerSecond = 0.0;
+    if (g_ReplaySession.RecordCount() == 0) return;
+
+    int64_t lastSendNs = g_ReplaySession.LastSendNs();
+    uint64_t first = g_ReplaySession.LowerBound(lastSendNs - historyNs);
+    int64_t firstSendNs = 0;
+    uint64_t count = 0;
+    g_ReplaySession.ForEach(first, [&](const SessionRecord& record) {
+        SampleStatus status = static_cast<SampleStatus>(record.status);
+        if (count++ == 0) firstSendNs = record.sendTimeNs;
+        g_GraphDecimator.Add(record.sendTimeNs, record.rttNs, status);
+        s_ReplayStats.Add(record.sendTimeNs, record.rttNs, status, historyNs);
+    });
+    if (lastSendNs > firstSendNs) {
+        s_ReplayPingsPerSecond = count * 1e9 / (lastSendNs - firstSendNs);
     }
-    
-    // Return standard deviation
-    return std::sqrt(sqSum / pingData.size());
 }
 
 // Function to draw the graph
 void DrawGraph(HDC hdc, RECT clientRect) {
-    // Define graph area
-    RECT graphRect = {
-        GRAPH_PADDING,
-        GRAPH_PADDING + 30, // Add space for controls
-        clientRect.right - GRAPH_PADDING,
-        clientRect.bottom - GRAPH_PADDING
-    };
-    
-    // Use appropriate colors based on dark mode setting
-    COLORREF textColor = g_DarkMode ? DARK_TEXT_COLOR : LIGHT_TEXT_COLOR;
-    COLORREF gridColor = g_DarkMode ? DARK_GRAPH_GRID_COLOR : GRAPH_GRID_COLOR;
-    COLORREF lineColor = g_DarkMode ? DARK_GRAPH_LINE_COLOR : GRAPH_LINE_COLOR;
-    COLORREF bgColor = g_DarkMode ? DARK_BACKGROUND_COLOR : BACKGROUND_COLOR;
-    
-    // Fill background with appropriate color based on mode
-    HBRUSH bgBrush = CreateSolidBrush(bgColor);
-    FillRect(hdc, &clientRect, bgBrush);
-    
-    // Draw graph border
-    HPEN borderPen = CreatePen(PS_SOLID, 1, textColor);
-    HPEN oldPen = (HPEN)SelectObject(hdc, borderPen);
-    Rectangle(hdc, graphRect.left, graphRect.top, graphRect.right, graphRect.bottom);
-    SelectObject(hdc, oldPen);
-    DeleteObject(borderPen);
-    
-    // Fill graph area with the background color
-    RECT innerGraphRect = {
-        graphRect.left + 1,
-        graphRect.top + 1,
-        graphRect.right - 1,
-        graphRect.bottom - 1
-    };
-    FillRect(hdc, &innerGraphRect, bgBrush);
-    DeleteObject(bgBrush);
-    
-    // Get data with mutex protection
-    std::vector<double> pingData;
-    {
-        std::lock_guard<std::mutex> lock(g_PingDataMutex);
-        pingData.assign(g_PingTimes.begin(), g_PingTimes.end());
-    }
-    
-    if (pingData.empty()) {
-        // Draw "No data" text if there's no ping data
-        SetTextColor(hdc, g_DarkMode ? DARK_TEXT_COLOR : RGB(100, 100, 100));
-        SetBkMode(hdc, TRANSPARENT);
-        TextOut(hdc, 
-            (graphRect.left + graphRect.right) / 2 - 30,
-            (graphRect.top + graphRect.bottom) / 2,
-            L"No data", 7);
-        return;
+    // The renderer keeps its framebuffer between frames and only redraws
+    // what changed; this function feeds it and blits the result
+    static GraphRenderer renderer;
+    static int rendererWidth = 0;
+    static int rendererHeight = 0;
+    if (clientRect.right != rendererWidth || clientRect.bottom != rendererHeight) {
+        renderer.Resize(clientRect.right, clientRect.bottom);
+        rendererWidth = clientRect.right;
+        rendererHeight = clientRect.bottom;
     }
-    
-    // Calculate max ping time based only on the visible data points (recent values)
-    double recentMaxPing = *std::max_element(pingData.begin(), pingData.end());
-    
-    // Scale adjustment with hysteresis to prevent too frequent rescaling
-    // If new max is higher, scale up immediately
-    if (recentMaxPing > g_MaxPingTime) {
-        g_MaxPingTime = recentMaxPing * 1.2; // Add 20% headroom
-    }
-    // If new max is significantly lower (less than 70% of current scale), scale down gradually
-    else if (recentMaxPing < g_MaxPingTime * 0.7) {
-        // Gradually scale down to prevent jumpy rescaling
-        g_MaxPingTime = g_MaxPingTime * 0.95; // Scale down by 10%
-        
-        // Don't go below the recent max plus some headroom
-        if (g_MaxPingTime < recentMaxPing * 1.2) {
-            g_MaxPingTime = recentMaxPing * 1.2;
-        }
-        
-        // Have a minimum scale to prevent tiny values from dominating
-        if (g_MaxPingTime < 1.0) {
-            g_MaxPingTime = 1.0;
+    renderer.SetPalette(g_DarkMode ? GraphPalette::Dark() : GraphPalette::Light());
+    
+    // Reduce the history to one envelope per pixel column. Only records that
+    // arrived or finished since the last frame are read; the columns are
+    // rebuilt when the width or the history length changes. A replayed
+    // session is folded in once per rebuild and never updated.
+    static int decimatorWidth = 0;
+    static bool decimatorReplaying = false;
+    int graphWidth = renderer.PlotWidth();
+    bool replaying = g_ReplaySession.IsOpen();
+    int64_t historyNs = (int64_t)(g_HistorySeconds * 1e9);
+    int64_t columnNs = graphWidth > 0 ? historyNs / graphWidth : 1;
+    if (columnNs < 1) columnNs = 1;
+    if (graphWidth != decimatorWidth || columnNs != g_GraphDecimator.ColumnNs() ||
+        replaying != decimatorReplaying || (replaying && s_ReplayDirty)) {
+        g_GraphDecimator.Configure(graphWidth, columnNs);
+        decimatorWidth = graphWidth;
+        decimatorReplaying = replaying;
+        if (replaying) {
+            LoadReplay(historyNs);
+            s_ReplayDirty = false;
         }
     }
-    
-    // Draw grid lines
-    HPEN gridPen = CreatePen(PS_DOT, 1, gridColor);
-    oldPen = (HPEN)SelectObject(hdc, gridPen);
-    
-    // Always use exactly 6 divisions for the y-axis
-    const int DIVISIONS = 6;
-    double yGridStep = g_MaxPingTime / DIVISIONS;
-    
-    // Draw horizontal grid lines
-    SetTextColor(hdc, textColor);
-    SetBkMode(hdc, TRANSPARENT);
-    
-    for (int i = 0; i <= DIVISIONS; i++) {
-        // Calculate y position
-        double value = i * yGridStep;
-        int y = graphRect.bottom - (int)((value / g_MaxPingTime) * 
-            (graphRect.bottom - graphRect.top));
-        
-        // Draw grid line
-        MoveToEx(hdc, graphRect.left, y, NULL);
-        LineTo(hdc, graphRect.right, y);
-        
-        // Draw y-axis labels with proper decimal places
-        WCHAR label[16];
-        swprintf_s(label, L"%.0f ms", value);
-        TextOut(hdc, graphRect.left - 50, y - 8, label, (int)wcslen(label));
+    if (!replaying) {
+        // Samples from here on wake the UI for the next frame
+        g_SamplerShared.dataUpdated = false;
+        g_GraphDecimator.Update(g_SampleStore);
     }
     
-    // Vertical grid lines
-    int xGridStep = 100; // pixels
-    for (int x = graphRect.left + xGridStep; x < graphRect.right; x += xGridStep) {
-        MoveToEx(hdc, x, graphRect.top, NULL);
-        LineTo(hdc, x, graphRect.bottom);
+    GraphFrame frame;
+    frame.historySeconds = g_HistorySeconds;
+    frame.hasData = graphWidth > 0 && g_GraphDecimator.HasData();
+    frame.dirtyColumn = g_GraphDecimator.TakeDirtyColumn();
+    
+    // Window statistics are maintained by the sampler; reading them is O(1)
+    if (replaying) {
+        s_ReplayStats.Summarize(frame.stats);
+        frame.pingsPerSecond = s_ReplayPingsPerSecond;
+    } else {
+        g_SamplerShared.stats.Load(frame.stats);
+        frame.pingsPerSecond = g_SamplerShared.pingsPerSecond.load();
+        frame.rateState = g_SamplerShared.rateState.load();
+        frame.controlRate = g_SamplerShared.controlRate.load();
+        frame.controlWindow = g_SamplerShared.controlWindow.load();
     }
     
-    // Draw x-axis labels
-    SetTextColor(hdc, textColor);
-    
-    // Current history length at the start of x-axis
-    WCHAR historyLabel[16];
-    swprintf_s(historyLabel, L"~%.1f s", g_HistorySeconds);
-    TextOut(hdc, graphRect.left, graphRect.bottom + 5, 
-            historyLabel, (int)wcslen(historyLabel));
-    
-    // "0" at the end of x-axis
-    TextOut(hdc, graphRect.right - 10, graphRect.bottom + 5, L"0", 1);
-    
-    // Restore pen
-    SelectObject(hdc, oldPen);
-    DeleteObject(gridPen);
-    
-    // Draw ping time graph
-    HPEN linePen = CreatePen(PS_SOLID, 2, lineColor);
-    SelectObject(hdc, linePen);
-    
-    // Calculate available graph width
-    int graphWidth = graphRect.right - graphRect.left;
-    
-    // We want newest data on the right side
-    // Determine how much horizontal space each point gets
-    double xStep = (double)graphWidth / g_DynamicDataPoints;
-    
-    if (pingData.size() > 0) {
-        // Start drawing from the left side of the graph
-        // Position depends on how many points we have compared to max
-        int startX = int(graphRect.right - ((int)pingData.size() * xStep));
-        if (startX < graphRect.left) startX = graphRect.left;
-        
-        // Calculate the starting index in our data
-        // Skip oldest entries if we have more data than can fit in view
-        size_t startIdx = 0;
-        if (pingData.size() > g_DynamicDataPoints) {
-            startIdx = pingData.size() - g_DynamicDataPoints;
+    static std::vector<ColumnEnvelope> tierColumns;
+    static std::vector<const ColumnEnvelope*> columns;
+    static std::vector<int64_t> lttbPoints;
+    if (frame.hasData) {
+        // Scale adjustment with hysteresis to prevent too frequent rescaling
+        g_MaxPingTime = AdjustGraphScale(g_MaxPingTime, frame.stats.maxMs);
+        
+        // The x-axis is real time: the newest column is on the right edge and
+        // the left edge is g_HistorySeconds before it
+        int64_t firstColumn = g_GraphDecimator.NewestColumn() - graphWidth + 1;
+        
+        // Columns of a second or more come from the rollup tiers, so long
+        // histories cost the same to draw as short ones. Tiers have no dirty
+        // tracking, so those frames are redrawn in full. A replay has no
+        // tiers; its decimator already holds the whole window.
+        int tier = replaying ? -1 : TieredHistory::PickTier(columnNs, historyNs);
+        columns.assign(graphWidth, nullptr);
+        if (tier >= 0) {
+            g_TieredHistory.Decimate(tier, firstColumn, graphWidth, columnNs, tierColumns);
+            for (int i = 0; i < graphWidth; i++) {
+                if (tierColumns[i].column >= 0) columns[i] = &tierColumns[i];
+            }
+            frame.dirtyColumn = GRAPH_DIRTY_ALL;
+        } else {
+            for (int i = 0; i < graphWidth; i++) {
+                columns[i] = g_GraphDecimator.Column(firstColumn + i);
+            }
         }
         
-        // Start at the first point
-        int xPos = startX;
-        int yPos = graphRect.bottom - (int)((pingData[startIdx] / g_MaxPingTime) * 
-            (graphRect.bottom - graphRect.top));
-        MoveToEx(hdc, xPos, yPos, NULL);
-        
-        // Draw line through remaining points, evenly spaced
-        for (size_t i = startIdx + 1; i < pingData.size(); i++) {
-            xPos = startX + (int)((i - startIdx) * xStep);
-            yPos = graphRect.bottom - (int)((pingData[i] / g_MaxPingTime) * 
-                (graphRect.bottom - graphRect.top));
-            LineTo(hdc, xPos, yPos);
+        if (g_UseLttb) {
+            SelectLttb(columns, lttbPoints);
+            frame.lttbPoints = &lttbPoints;
         }
+        frame.columns = &columns;
+        frame.firstColumn = firstColumn;
+        frame.maxPingMs = g_MaxPingTime;
     }
     
-    // Draw average, max ping times, and jitter
-    if (!pingData.empty()) {
-        double currentPing = pingData.back();
-        double averagePing = 0;
-        
-        // Calculate average and find max (use recentMaxPing since we've already calculated it)
-        for (const auto& ping : pingData) {
-            averagePing += ping;
-        }
-        averagePing /= pingData.size();
-        
-        // Calculate jitter (standard deviation)
-        double jitter = CalculateJitter(pingData);
-        
-        // Format ping times with appropriate precision based on value
-        WCHAR currentPingStr[16], avgPingStr[16], maxPingStr[16], jitterStr[16];
-        
-        // Use 3 decimal places for values under 1ms
-        if (currentPing < 1.0) {
-            swprintf_s(currentPingStr, L"%.3f", currentPing);
-        } else {
-            swprintf_s(currentPingStr, L"%.1f", currentPing);
-        }
-        
-        if (averagePing < 1.0) {
-            swprintf_s(avgPingStr, L"%.3f", averagePing);
-        } else {
-            swprintf_s(avgPingStr, L"%.1f", averagePing);
-        }
-        
-        if (recentMaxPing < 1.0) {
-            swprintf_s(maxPingStr, L"%.3f", recentMaxPing);
-        } else {
-            swprintf_s(maxPingStr, L"%.1f", recentMaxPing);
+    // The tool's own overhead is shown with live data and, if asked, taken
+    // off the figures (not the plot, which keeps the raw samples)
+    static CalibrationResult calibration;
+    if (!replaying && g_Calibrator.Latest(calibration)) {
+        frame.calibration = &calibration;
+        if (g_SubtractOverhead) {
+            frame.stats = SubtractOverhead(frame.stats, calibration.loopback);
+            frame.overheadSubtracted = true;
         }
-        
-        if (jitter < 1.0) {
-            swprintf_s(jitterStr, L"%.3f", jitter);
-        } else {
-            swprintf_s(jitterStr, L"%.1f", jitter);
-        }
-        
-        // Display stats - Update to include ping count, PPS, jitter and dynamic data points value
-        WCHAR statsText[256];
-        swprintf_s(statsText, 
-            L"Current: %s ms | Avg: %s ms | Max: %s ms | Jitter: %s ms | Pings per second: %.1f | History: %d points", 
-            currentPingStr, avgPingStr, maxPingStr, jitterStr, g_PingsPerSecond.load(), g_DynamicDataPoints.load());
-        
-        SetTextColor(hdc, textColor);
-        TextOut(hdc, graphRect.left + 10, graphRect.top + 10, 
-            statsText, (int)wcslen(statsText));
     }
-    
-    // Cleanup
-    SelectObject(hdc, oldPen);
-    DeleteObject(linePen);
+    renderer.Render(frame);
+    
+    // The framebuffer is a top-down 32-bit DIB
+    const Framebuffer& image = renderer.Frame();
+    BITMAPINFO info = {};
+    info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    info.bmiHeader.biWidth = image.Width();
+    info.bmiHeader.biHeight = -image.Height();
+    info.bmiHeader.biPlanes = 1;
+    info.bmiHeader.biBitCount = 32;
+    info.bmiHeader.biCompression = BI_RGB;
+    SetDIBitsToDevice(hdc, 0, 0, image.Width(), image.Height(), 0, 0, 0, image.Height(),
+        image.Data(), &info, DIB_RGB_COLORS);
+}
+
+// Frame pacing: the sampler posts once per update the UI has not drawn yet,
+// so nothing wakes the UI while stopped, while no replies come in or while
+// minimized (no paint takes the update)
+static int64_t s_LastFrameNs = 0;
+static bool s_FramePending = false;
+
+void NotifyDataUpdated(void* context) {
+    PostMessage(static_cast<HWND>(context), WM_APP_DATA_UPDATED, 0, 0);
 }
 
-// UI update timer callback
-VOID CALLBACK UIUpdateTimerProc(HWND hwnd, UINT uMsg, UINT_PTR idEvent, DWORD dwTime) {
-    if (g_DataUpdated) {
-        InvalidateRect(hwnd, NULL, FALSE);
-        g_DataUpdated = false;
+static void DrawFrame(HWND hwnd) {
+    s_LastFrameNs = MonotonicNowNs();
+    InvalidateRect(hwnd, NULL, FALSE);
+}
+
+void ScheduleFrame(HWND hwnd) {
+    if (s_FramePending) return;
+    int64_t waitNs = s_LastFrameNs + 1000000000LL / g_MaxFps - MonotonicNowNs();
+    if (waitNs <= 0 || !g_FrameTimer) {
+        DrawFrame(hwnd);
+        return;
+    }
+    
+    // Relative due time in 100 ns units
+    LARGE_INTEGER due;
+    due.QuadPart = -(waitNs / 100 + 1);
+    if (!SetWaitableTimer(g_FrameTimer, &due, 0, NULL, NULL, FALSE)) {
+        DrawFrame(hwnd);
+        return;
     }
+    s_FramePending = true;
+}
+
+void OnFrameTimer(HWND hwnd) {
+    s_FramePending = false;
+    DrawFrame(hwnd);
 }
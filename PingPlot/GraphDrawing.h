@@ -5,5 +5,17 @@
 // Draw the ping graph
 void DrawGraph(HDC hdc, RECT clientRect);
 
-// Timer callback for UI updates
-VOID CALLBACK UIUpdateTimerProc(HWND hwnd, UINT uMsg, UINT_PTR idEvent, DWORD dwTime);
+// Rebuild the graph from g_ReplaySession on the next draw (after it was
+// opened or closed)
+void InvalidateReplay();
+
+// SamplerShared::notifyUpdate for the window passed as context: posts
+// WM_APP_DATA_UPDATED from the probe thread
+void NotifyDataUpdated(void* context);
+
+// Handle WM_APP_DATA_UPDATED: redraw now, or arm g_FrameTimer for when the
+// frame cap allows the next frame
+void ScheduleFrame(HWND hwnd);
+
+// g_FrameTimer fired: draw the frame it was armed for
+void OnFrameTimer(HWND hwnd);
@@ -0,0 +1,310 @@
+#include "GraphRenderer.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+// Use 3 decimal places for values under 1ms
+void FormatPingTime(char (&out)[16], double ms) {
+    snprintf(out, sizeof(out), ms < 1.0 ? "%.3f" : "%.1f", ms);
+}
+
+// Largest multiple of step that is <= value, for negative values too
+int64_t FloorToMultiple(int64_t value, int64_t step) {
+    int64_t quotient = value / step;
+    if (value % step != 0 && value < 0) quotient--;
+    return quotient * step;
+}
+
+} // namespace
+
+double AdjustGraphScale(double scaleMs, double recentMaxMs) {
+    // If new max is higher, scale up immediately
+    if (recentMaxMs > scaleMs) {
+        return recentMaxMs * 1.2; // Add 20% headroom
+    }
+    // If new max is significantly lower (less than 70% of current scale), scale down gradually
+    if (recentMaxMs < scaleMs * 0.7) {
+        scaleMs *= 0.95;
+
+        // Don't go below the recent max plus some headroom
+        if (scaleMs < recentMaxMs * 1.2) scaleMs = recentMaxMs * 1.2;
+
+        // Have a minimum scale to prevent tiny values from dominating
+        if (scaleMs < 1.0) scaleMs = 1.0;
+    }
+    return scaleMs;
+}
+
+GraphPalette GraphPalette::Light() {
+    GraphPalette palette;
+    palette.background = MakePixel(240, 240, 240);
+    palette.grid = MakePixel(200, 200, 200);
+    palette.line = MakePixel(0, 100, 200);
+    palette.loss = MakePixel(220, 40, 40);
+    palette.text = MakePixel(0, 0, 0);
+    palette.noData = MakePixel(100, 100, 100);
+    return palette;
+}
+
+GraphPalette GraphPalette::Dark() {
+    GraphPalette palette;
+    palette.background = MakePixel(30, 30, 30);
+    palette.grid = MakePixel(70, 70, 70);
+    palette.line = MakePixel(0, 150, 255);
+    palette.loss = MakePixel(255, 80, 80);
+    palette.text = MakePixel(220, 220, 220);
+    palette.noData = MakePixel(220, 220, 220);
+    return palette;
+}
+
+void GraphRenderer::Resize(int width, int height) {
+    m_Frame.Resize(width, height);
+    int graphLeft = GRAPH_MARGIN;
+    int graphTop = GRAPH_MARGIN + GRAPH_TOP_EXTRA;
+    int graphRight = width - GRAPH_MARGIN;
+    int graphBottom = height - GRAPH_MARGIN;
+
+    // Inside the one-pixel border
+    m_PlotLeft = graphLeft + 1;
+    m_PlotTop = graphTop + 1;
+    m_PlotBottom = graphBottom - 1;
+    m_PlotWidth = graphRight - 1 - m_PlotLeft;
+    if (m_PlotWidth <= 0 || m_PlotBottom <= m_PlotTop) m_PlotWidth = 0;
+
+    m_GridRows.clear();
+    for (int i = 1; i < GRAPH_Y_DIVISIONS; i++) {
+        m_GridRows.push_back(graphBottom - i * (graphBottom - graphTop) / GRAPH_Y_DIVISIONS);
+    }
+    m_StaticValid = false;
+}
+
+void GraphRenderer::SetPalette(const GraphPalette& palette) {
+    if (memcmp(&palette, &m_Palette, sizeof(palette)) == 0) return;
+    m_Palette = palette;
+    m_StaticValid = false;
+}
+
+void GraphRenderer::Render(const GraphFrame& frame) {
+    m_Redrawn = 0;
+    if (m_PlotWidth <= 0) return; // Window too small to draw into
+
+    if (!m_StaticValid || frame.maxPingMs != m_ScaleMs || frame.historySeconds != m_HistorySeconds) {
+        DrawStatic(frame);
+    }
+    DrawStats(frame);
+
+    if (!frame.hasData || !frame.columns) {
+        ClearColumns(0, m_PlotWidth, frame.firstColumn);
+        const char* text = "No data";
+        m_Frame.DrawText(m_PlotLeft + (m_PlotWidth - Framebuffer::TextWidth(text, GRAPH_TEXT_SCALE)) / 2,
+            (m_PlotTop + m_PlotBottom) / 2, text, m_Palette.noData, GRAPH_TEXT_SCALE);
+        m_PlotValid = false;
+        m_Redrawn = m_PlotWidth;
+        return;
+    }
+    const std::vector<const ColumnEnvelope*>& columns = *frame.columns;
+
+    // Keep what is still valid: scroll by the columns the graph moved on and
+    // redraw from the oldest column that changed or was not shown yet
+    int from = 0;
+    int64_t shift = frame.firstColumn - m_FirstColumn;
+    if (m_PlotValid && !frame.lttbPoints && frame.dirtyColumn != GRAPH_DIRTY_ALL &&
+        shift >= 0 && shift < m_PlotWidth) {
+        m_Frame.ScrollLeft(m_PlotLeft, m_PlotTop, m_PlotLeft + m_PlotWidth, m_PlotBottom, static_cast<int>(shift));
+        int64_t dirty = std::min(frame.dirtyColumn, m_FirstColumn + m_PlotWidth);
+        from = static_cast<int>(std::max<int64_t>(0, std::min<int64_t>(dirty - frame.firstColumn, m_PlotWidth)));
+
+        // A line from a column that scrolled out is not part of a full
+        // redraw either: wipe what is left of it, up to and including the
+        // first column with data, and draw that column and its line to the
+        // next one again
+        if (shift > 0) {
+            int firstData = 0;
+            while (firstData < from && !columns[firstData]) firstData++;
+            ClearColumns(0, std::min(firstData + 1, from), frame.firstColumn);
+            if (firstData < from) {
+                int next = firstData + 1;
+                while (next < from && !columns[next]) next++;
+                DrawColumns(frame, firstData, std::min(next + 1, from));
+            }
+        }
+    }
+    m_FirstColumn = frame.firstColumn;
+    m_PlotValid = true;
+
+    // The line from the last column with data before `from` into the
+    // redrawn part changes, and a steep line also covers pixels of that
+    // column. Redraw from there, starting the line at the data column
+    // before it, whose pixels stay as they are.
+    int anchor = from - 1;
+    while (anchor >= 0 && !columns[anchor]) anchor--;
+    int clearFrom = anchor >= 0 ? anchor : from;
+    int drawFrom = clearFrom - 1;
+    while (drawFrom >= 0 && !columns[drawFrom]) drawFrom--;
+    ClearColumns(clearFrom, m_PlotWidth, frame.firstColumn);
+    DrawColumns(frame, drawFrom >= 0 ? drawFrom : clearFrom, m_PlotWidth);
+    m_Redrawn = m_PlotWidth - clearFrom;
+}
+
+void GraphRenderer::DrawStatic(const GraphFrame& frame) {
+    m_Frame.ResetClip();
+    m_Frame.Fill(m_Palette.background);
+
+    int graphLeft = m_PlotLeft - 1;
+    int graphTop = m_PlotTop - 1;
+    int graphRight = m_PlotLeft + m_PlotWidth + 1;
+    int graphBottom = m_PlotBottom + 1;
+    m_Frame.Rectangle(graphLeft, graphTop, graphRight, graphBottom, m_Palette.text);
+
+    // Y-axis labels next to each grid line, smaller if they do not fit the margin
+    for (int i = 0; i <= GRAPH_Y_DIVISIONS; i++) {
+        double value = i * frame.maxPingMs / GRAPH_Y_DIVISIONS;
+        int y = graphBottom - i * (graphBottom - graphTop) / GRAPH_Y_DIVISIONS;
+        char label[32];
+        snprintf(label, sizeof(label), "%.0f ms", value);
+        int scale = Framebuffer::TextWidth(label, GRAPH_TEXT_SCALE) <= GRAPH_MARGIN - 6 ? GRAPH_TEXT_SCALE : 1;
+        m_Frame.DrawText(graphLeft - 4 - Framebuffer::TextWidth(label, scale), y - FONT_HEIGHT * scale / 2,
+            label, m_Palette.text, scale);
+    }
+
+    // History length at the start of the x-axis, "0" at the end
+    char historyLabel[32];
+    snprintf(historyLabel, sizeof(historyLabel), "%.1f s", frame.historySeconds);
+    m_Frame.DrawText(graphLeft, graphBottom + 5, historyLabel, m_Palette.text, GRAPH_TEXT_SCALE);
+    m_Frame.DrawText(graphRight - Framebuffer::TextWidth("0", GRAPH_TEXT_SCALE), graphBottom + 5, "0",
+        m_Palette.text, GRAPH_TEXT_SCALE);
+
+    m_StaticValid = true;
+    m_PlotValid = false;
+    m_ScaleMs = frame.maxPingMs;
+    m_HistorySeconds = frame.historySeconds;
+}
+
+void GraphRenderer::DrawStats(const GraphFrame& frame) {
+    int graphLeft = m_PlotLeft - 1;
+    int lineHeight = FONT_HEIGHT * GRAPH_TEXT_SCALE + 4;
+    m_Frame.FillRect(graphLeft, GRAPH_STATS_TOP, m_Frame.Width(), m_PlotTop - 1, m_Palette.background);
+    const WindowSummary& stats = frame.stats;
+    if (stats.answered == 0) return;
+
+    char currentPing[16], averagePing[16], minPing[16], maxPing[16], jitter[16];
+    FormatPingTime(currentPing, stats.currentMs);
+    FormatPingTime(averagePing, stats.averageMs);
+    FormatPingTime(minPing, stats.minMs);
+    FormatPingTime(maxPing, stats.maxMs);
+    FormatPingTime(jitter, stats.jitterMs);
+
+    char text[256];
+    snprintf(text, sizeof(text), "Current: %s ms | Avg: %s ms | Min: %s ms | Max: %s ms | Jitter: %s ms",
+        currentPing, averagePing, minPing, maxPing, jitter);
+    m_Frame.DrawText(graphLeft, GRAPH_STATS_TOP, text, m_Palette.text, GRAPH_TEXT_SCALE);
+
+    char control[64] = "";
+    if (frame.rateState != RateState::Off) {
+        snprintf(control, sizeof(control), " (%s, %.0f/s, %d deep)", RateStateName(frame.rateState),
+            frame.controlRate, frame.controlWindow);
+    }
+    char capped[48] = "";
+    if (stats.capped) snprintf(capped, sizeof(capped), " (capped at %.1f s)", stats.spanSeconds);
+    snprintf(text, sizeof(text), "Loss: %.1f%% | Reorder: %.1f%% | Late: %llu | Dup: %llu | Pings per second: %.1f%s | History: %llu samples%s",
+        stats.LossPercent(), stats.ReorderPercent(), static_cast<unsigned long long>(stats.late),
+        static_cast<unsigned long long>(stats.duplicates), frame.pingsPerSecond, control,
+        static_cast<unsigned long long>(stats.Finished()), capped);
+    m_Frame.DrawText(graphLeft, GRAPH_STATS_TOP + lineHeight, text, m_Palette.text, GRAPH_TEXT_SCALE);
+
+    // Tail latency on its own line
+    char p50[16], p90[16], p99[16], p999[16];
+    FormatPingTime(p50, stats.p50Ms);
+    FormatPingTime(p90, stats.p90Ms);
+    FormatPingTime(p99, stats.p99Ms);
+    FormatPingTime(p999, stats.p999Ms);
+    int length = snprintf(text, sizeof(text), "p50: %s ms | p90: %s ms | p99: %s ms | p99.9: %s ms", p50, p90, p99, p999);
+
+    // The tool's own share of every figure, from loopback
+    if (frame.calibration && length > 0 && length < static_cast<int>(sizeof(text))) {
+        const CalibrationResult& calibration = *frame.calibration;
+        char fixed[16], tail[16];
+        FormatPingTime(fixed, calibration.loopback.fixedMs);
+        FormatPingTime(tail, calibration.loopback.p99Ms);
+        snprintf(text + length, sizeof(text) - length, " | Overhead: %s ms (p99 %s ms, %s/%s)%s",
+            fixed, tail, calibration.backend.c_str(), TimestampSourceName(calibration.source),
+            frame.overheadSubtracted ? " subtracted" : "");
+    }
+    m_Frame.DrawText(graphLeft, GRAPH_STATS_TOP + 2 * lineHeight, text, m_Palette.text, GRAPH_TEXT_SCALE);
+}
+
+void GraphRenderer::ClearColumns(int from, int to, int64_t firstColumn) {
+    if (from >= to) return;
+    int x0 = m_PlotLeft + from;
+    int x1 = m_PlotLeft + to;
+    m_Frame.FillRect(x0, m_PlotTop, x1, m_PlotBottom, m_Palette.background);
+
+    // Dotted horizontal lines; the dots follow column numbers so they scroll
+    // with the data
+    for (int y : m_GridRows) {
+        Pixel* row = m_Frame.Row(y);
+        for (int i = from; i < to; i++) {
+            if (((firstColumn + i) & 2) == 0) row[m_PlotLeft + i] = m_Palette.grid;
+        }
+    }
+
+    // Dotted vertical lines every GRAPH_GRID_COLUMNS columns
+    int64_t column = FloorToMultiple(firstColumn + from + GRAPH_GRID_COLUMNS - 1, GRAPH_GRID_COLUMNS);
+    for (; column < firstColumn + to; column += GRAPH_GRID_COLUMNS) {
+        int x = m_PlotLeft + static_cast<int>(column - firstColumn);
+        for (int y = m_PlotTop; y < m_PlotBottom; y++) {
+            if ((y & 2) == 0) m_Frame.Row(y)[x] = m_Palette.grid;
+        }
+    }
+}
+
+void GraphRenderer::DrawColumns(const GraphFrame& frame, int from, int to) {
+    const std::vector<const ColumnEnvelope*>& columns = *frame.columns;
+    m_Frame.SetClip(m_PlotLeft, m_PlotTop, m_PlotLeft + m_PlotWidth, m_PlotBottom);
+    int lossTop = m_PlotBottom - std::max(1, (m_PlotBottom - m_PlotTop) / 20);
+    const int LINE_THICKNESS = 2;
+
+    bool lineStarted = false;
+    int lastX = 0;
+    int lastY = 0;
+    for (int i = from; i < to; i++) {
+        const ColumnEnvelope* envelope = columns[i];
+        if (!envelope) continue;
+        int x = m_PlotLeft + i;
+
+        if (envelope->answered > 0) {
+            if (frame.lttbPoints) {
+                // One representative point per column
+                int y = ToY((*frame.lttbPoints)[i]);
+                m_Frame.Line(lineStarted ? lastX : x, lineStarted ? lastY : y, x, y, m_Palette.line, LINE_THICKNESS);
+                lastY = y;
+            } else {
+                // Join the previous column at the first ping, draw the min-max
+                // span, and continue from the last ping
+                int yFirst = ToY(envelope->firstRttNs);
+                if (lineStarted) {
+                    m_Frame.Line(lastX, lastY, x, yFirst, m_Palette.line, LINE_THICKNESS);
+                }
+                m_Frame.Line(x, ToY(envelope->maxRttNs), x, ToY(envelope->minRttNs), m_Palette.line, LINE_THICKNESS);
+                lastY = ToY(envelope->lastRttNs);
+            }
+            lastX = x;
+            lineStarted = true;
+        }
+
+        if (envelope->lost > 0) {
+            // Lost probes: break the line and mark them along the bottom edge
+            m_Frame.VLine(x, m_PlotBottom - 1, lossTop, m_Palette.loss);
+            lineStarted = false;
+        }
+    }
+    m_Frame.ResetClip();
+}
+
+int GraphRenderer::ToY(int64_t rttNs) const {
+    int height = m_PlotBottom - m_PlotTop;
+    int y = m_PlotBottom - 1 - static_cast<int>(rttNs / 1e6 / m_ScaleMs * (height - 1));
+    return std::max(m_PlotTop, std::min(y, m_PlotBottom - 1));
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "Calibration.h"
+#include "ColumnDecimator.h"
+#include "Framebuffer.h"
+#include "RateController.h"
+#include "WindowStats.h"
+#include <cstdint>
+#include <vector>
+
+// Layout, in pixels: the graph box keeps GRAPH_MARGIN to the window edges
+// (plus GRAPH_TOP_EXTRA above it for the controls and the stats lines)
+const int GRAPH_MARGIN = 60;
+const int GRAPH_TOP_EXTRA = 55;
+const int GRAPH_STATS_TOP = 63;          // First stats line, below the two control rows
+const int GRAPH_TEXT_SCALE = 2;          // Built-in font scale for all text
+const int GRAPH_Y_DIVISIONS = 6;         // Horizontal grid lines split the scale into this many steps
+const int GRAPH_GRID_COLUMNS = 100;      // Vertical grid line every this many columns (time-anchored)
+
+const int64_t GRAPH_DIRTY_ALL = INT64_MIN;  // GraphFrame::dirtyColumn: redraw every column
+const int64_t GRAPH_DIRTY_NONE = INT64_MAX; // GraphFrame::dirtyColumn: nothing changed
+
+struct GraphPalette {
+    Pixel background;
+    Pixel grid;
+    Pixel line;
+    Pixel loss;
+    Pixel text;
+    Pixel noData;
+
+    static GraphPalette Light();
+    static GraphPalette Dark();
+};
+
+// Everything one frame shows
+struct GraphFrame {
+    // One entry per plot column, oldest first; nullptr for columns without
+    // finished probes
+    const std::vector<const ColumnEnvelope*>* columns = nullptr;
+    int64_t firstColumn = 0;          // Column number of (*columns)[0]
+
+    // Oldest column number whose envelope changed since the previous frame
+    int64_t dirtyColumn = GRAPH_DIRTY_ALL;
+
+    // If set, one chosen RTT per column (see SelectLttb) instead of envelopes
+    const std::vector<int64_t>* lttbPoints = nullptr;
+
+    bool hasData = false;
+    double maxPingMs = 1.0;           // Top of the y axis
+    double historySeconds = 0.0;      // Span of the x axis
+    WindowSummary stats;
+    double pingsPerSecond = 0.0;
+
+    // Latest self-calibration, shown after the percentiles; nullptr = none
+    const CalibrationResult* calibration = nullptr;
+    bool overheadSubtracted = false;  // stats already have the overhead taken off
+
+    // Adaptive rate controller, shown after the pings per second
+    RateState rateState = RateState::Off;
+    double controlRate = 0.0;
+    int controlWindow = 0;
+};
+
+// Next top of the y axis for the largest ping in the window: scales up at
+// once with 20% headroom, and down gradually once the scale is well above
+// the data, so it does not jump around
+double AdjustGraphScale(double scaleMs, double recentMaxMs);
+
+// Draws the graph into a persistent Framebuffer without any platform API.
+// The static layer (border, axis labels) is only redrawn when the size,
+// palette or scale changes. The plot keeps its pixels between frames: when
+// the newest column moves on, the plot is scrolled left and only the
+// columns that are new or whose envelope changed are cleared and drawn
+// again. Vertical grid lines are anchored to column numbers so they scroll
+// with the data. LTTB frames and frames without dirty tracking are redrawn
+// in full, which is still O(width).
+class GraphRenderer {
+public:
+    // Size of the whole image; rebuilds everything on the next Render
+    void Resize(int width, int height);
+
+    void SetPalette(const GraphPalette& palette);
+
+    // Number of columns the plot shows (size of GraphFrame::columns)
+    int PlotWidth() const { return m_PlotWidth; }
+    int PlotHeight() const { return m_PlotBottom - m_PlotTop; }
+
+    void Render(const GraphFrame& frame);
+
+    const Framebuffer& Frame() const { return m_Frame; }
+
+    // Plot columns cleared and drawn by the last Render
+    int LastRedrawnColumns() const { return m_Redrawn; }
+
+private:
+    // Background, graph border and axis labels
+    void DrawStatic(const GraphFrame& frame);
+
+    // Stats lines above the graph
+    void DrawStats(const GraphFrame& frame);
+
+    // Restore plot columns [from, to) to background and grid
+    void ClearColumns(int from, int to, int64_t firstColumn);
+
+    // Draw the data of plot columns [from, to), starting the line at `from`
+    void DrawColumns(const GraphFrame& frame, int from, int to);
+
+    int ToY(int64_t rttNs) const;
+
+    Framebuffer m_Frame;
+    GraphPalette m_Palette = GraphPalette::Dark();
+
+    // Plot area inside the border: [m_PlotLeft, m_PlotLeft + m_PlotWidth) x
+    // [m_PlotTop, m_PlotBottom)
+    int m_PlotLeft = 0;
+    int m_PlotTop = 0;
+    int m_PlotBottom = 0;
+    int m_PlotWidth = 0;
+    std::vector<int> m_GridRows;      // Rows of the horizontal grid lines
+
+    // What the framebuffer currently shows
+    bool m_StaticValid = false;
+    bool m_PlotValid = false;
+    double m_ScaleMs = 0.0;
+    double m_HistorySeconds = 0.0;
+    int64_t m_FirstColumn = 0;
+    int m_Redrawn = 0;
+};
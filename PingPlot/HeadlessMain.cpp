@@ -0,0 +1,847 @@
+// Console front end for the portable sampling pipeline. Runs the same
+// Sampler as the GUI without any window or GUI library, prints a stats line
+// per report interval and a summary per host when it stops (after the
+// duration, or on Ctrl+C / SIGTERM). Meant to run unattended on servers:
+// between reports the main thread only sleeps.
+
+#include "Calibration.h"
+#include "ColumnDecimator.h"
+#include "Exporter.h"
+#include "GraphRenderer.h"
+#include "MultiSampler.h"
+#include "SessionFile.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Interval used with several hosts when none is given
+const int MULTI_TARGET_INTERVAL_MS = 1000;
+
+// Smallest store sized for a slow interval
+const size_t MIN_STORE_CAPACITY = 1024;
+
+// How often the main thread checks for the end of the run
+const int WAIT_TICK_MS = 100;
+
+// Default --snapshot-size, the GUI's initial window size
+const int SNAPSHOT_WIDTH = 1600;
+const int SNAPSHOT_HEIGHT = 900;
+
+// Target of --baseline: the local stack answers it, so the jitter it shows
+// is the tool's and the host's own
+const char* const BASELINE_HOST = "127.0.0.1";
+
+// Smallest measured jitter the self-jitter is given as a share of: the
+// resolution it is printed with
+const double MIN_SELF_JITTER_BASE_MS = 0.001;
+
+// What the simulated backend's names resolve to: documentation addresses,
+// one per family, so --all-addresses has something to split
+const char* const SIMULATED_ADDRESSES[] = { "192.0.2.1", "2001:db8::1" };
+
+// Set from the signal handler; polled by WaitForEnd
+volatile std::sig_atomic_t g_StopRequested = 0;
+
+// Setting changes read from stdin with --commands. The reader thread may
+// still wait on stdin when main returns, so the queue outlives main.
+SamplerCommandQueue g_Commands;
+
+void OnStopSignal(int) {
+    g_StopRequested = 1;
+}
+
+void PrintUsage() {
+    fprintf(stderr,
+        "Usage: pingplot-cli [options] <host> [host...]\n"
+        "  --backend <default|icmpapi|socket|sim>  Probe backend (default: default)\n"
+        "  --interval <ms>                         Time between pings, fractions allowed (default: %d)\n"
+        "  --rate <pps>                            Pings per second; sets the interval\n"
+        "  --corrected                             Also report latency corrected for coordinated omission\n"
+        "  --timeout <ms>                          Time to wait for each reply (default: %d)\n"
+        "  --size <bytes>                          Echo payload size; 24 or more carries the probe id (default: 32)\n"
+        "  --inflight <n>                          Probes outstanding at once; >1 pipelines (default: 1)\n"
+        "  --adaptive                              Adjust rate and depth: --rate is the target, --inflight the deepest\n"
+        "                                          pipelining (default: %d); backs off on loss bursts\n"
+        "  --cpu-budget <percent>                  Adaptive, keeping the probe thread under this CPU share of one core\n"
+        "  --duration <s>                          Stop after this many seconds; 0 runs until interrupted (default: 10)\n"
+        "  --report <s>                            Seconds between stats lines; 0 prints only the summary (default: 1)\n"
+        "  --history <s>                           Window the stats lines cover (default: %.0f)\n"
+        "  --threads <n>                           Event-loop threads with several hosts (default: 1)\n"
+        "  --all-addresses                         Probe every address a host resolves to as its own series\n"
+        "  --low-jitter                            Pin the probe thread, raise its priority, lock memory and busy-poll\n"
+        "  --cpu <n>                               CPU for --low-jitter (default: the highest allowed)\n"
+        "  --baseline <s>                          First probe loopback this long with the same settings (self-jitter)\n"
+        "  --no-calibrate                          Skip measuring the tool's own overhead against loopback at start\n"
+        "  --calibrate-every <s>                   Measure the overhead again this often while running (default: 0, never)\n"
+        "  --subtract-overhead                     Report latencies with the measured overhead taken off\n"
+        "  --commands                              Read setting changes from stdin while running (one host only):\n"
+        "                                          interval <ms> | rate <pps> | timeout <ms> | size <bytes> | history <s>\n"
+        "  --record <file>                         Append every probe to a session file (one host only)\n"
+        "  --replay <file>                         Summarize a recorded session file and exit\n"
+        "  --export <csv|jsonl|binary>:<file|->    Stream every probe to a file or stdout (one host only; repeatable)\n"
+        "  --export-policy <drop|coalesce>         What an export that falls behind does (default: drop)\n"
+        "  --snapshot <file.png|file.ppm>          Render the graph of the history window at the end (one host only)\n"
+        "  --snapshot-size <width>x<height>        Snapshot size in pixels (default: %dx%d)\n"
+        "With several hosts every host is probed once per interval (default: %d ms)\n"
+        "Names are looked up again in the background; probing follows a changed answer\n"
+        "Exits with 1 if a host never answered, 2 on bad arguments\n",
+        PING_INTERVAL_MS, DEFAULT_PING_TIMEOUT_MS, RATE_CONTROL_DEFAULT_MAX_IN_FLIGHT, HISTORY_SECONDS,
+        SNAPSHOT_WIDTH, SNAPSHOT_HEIGHT,
+        MULTI_TARGET_INTERVAL_MS);
+}
+
+// How long to run and what to print meanwhile
+struct RunOptions {
+    double durationSeconds = 10.0; // 0 = until interrupted
+    double reportSeconds = 1.0;    // 0 = summary only
+    FILE* report = stdout;         // Where stats lines and summaries go
+    Calibrator* calibrator = nullptr; // Measured overhead; nullptr = not calibrated
+    bool subtractOverhead = false;    // Take the overhead off the reported latencies
+};
+
+// Overhead to take off the reported latencies, or nullptr
+const OverheadEstimate* OverheadToSubtract(const RunOptions& options, CalibrationResult& result) {
+    if (!options.subtractOverhead || !options.calibrator || !options.calibrator->Latest(result)) return nullptr;
+    return &result.loopback;
+}
+
+// What a measurement costs the tool itself: loopback through the backend,
+// and the engine and loop alone against the simulated responder
+void PrintCalibration(FILE* out, const Calibrator& calibrator, bool subtracted) {
+    CalibrationResult result;
+    if (!calibrator.Latest(result)) {
+        fprintf(out, "Overhead: not measured (%s)\n", calibrator.LastError().c_str());
+        fflush(out);
+        return;
+    }
+    const OverheadEstimate& loopback = result.loopback;
+    fprintf(out, "Overhead (%s/%s, %llu %s probes): Min: %.3f ms | p50: %.3f ms | p99: %.3f ms | Max: %.3f ms | Jitter: %.3f ms\n",
+        result.backend.c_str(), TimestampSourceName(result.source), static_cast<unsigned long long>(loopback.probes),
+        result.simulatedBackend ? "simulated" : "loopback", loopback.fixedMs, loopback.p50Ms, loopback.p99Ms, loopback.maxMs, loopback.jitterMs);
+    if (subtracted) fprintf(out, "Min subtracted from the latencies above; Jitter from their jitter\n");
+    if (result.simulated.probes > 0) {
+        fprintf(out, "Overhead of engine and loop alone: p50: %.2f us | p99: %.2f us\n",
+            result.simulated.p50Ms * 1000.0, result.simulated.p99Ms * 1000.0);
+    }
+    fflush(out);
+}
+
+// Coordinated-omission corrected percentiles; nothing unless they are kept
+void PrintCorrected(FILE* out, const char* label, const WindowSummary& corrected) {
+    if (corrected.answered == 0) return;
+    fprintf(out, "%sCorrected p50: %.3f ms | p90: %.3f ms | p99: %.3f ms | p99.9: %.3f ms | Max: %.3f ms\n",
+        label, corrected.p50Ms, corrected.p90Ms, corrected.p99Ms, corrected.p999Ms, corrected.maxMs);
+}
+
+// What the adaptive rate controller is doing; nothing when it is off
+void PrintRateControl(FILE* out, const char* label, const SamplerShared& shared) {
+    RateState state = shared.rateState.load();
+    if (state == RateState::Off) return;
+    fprintf(out, "%sRate control: %s | %.1f/s | %d in flight | CPU %.1f%%\n", label, RateStateName(state),
+        shared.controlRate.load(), shared.controlWindow.load(), shared.controlCpuPercent.load());
+}
+
+// Print the same figures DrawGraph shows, less overhead if given
+void PrintStats(FILE* out, const char* label, const SamplerShared& shared, const OverheadEstimate* overhead = nullptr) {
+    WindowSummary stats;
+    shared.stats.Load(stats);
+    if (overhead) stats = SubtractOverhead(stats, *overhead);
+    if (stats.Finished() == 0) {
+        fprintf(out, "%sNo data\n", label);
+        return;
+    }
+    if (stats.answered == 0) {
+        fprintf(out, "%sNo replies | Loss: %.1f%% | Pings per second: %.1f\n", label, stats.LossPercent(), shared.pingsPerSecond.load());
+        fflush(out);
+        return;
+    }
+
+    fprintf(out, "%sCurrent: %.3f ms | Avg: %.3f ms | Min: %.3f ms | Max: %.3f ms | Jitter: %.3f ms | Loss: %.1f%% | Reorder: %.1f%% | Pings per second: %.1f\n",
+        label, stats.currentMs, stats.averageMs, stats.minMs, stats.maxMs, stats.jitterMs, stats.LossPercent(),
+        stats.ReorderPercent(), shared.pingsPerSecond.load());
+    fprintf(out, "%sp50: %.3f ms | p90: %.3f ms | p99: %.3f ms | p99.9: %.3f ms%s\n",
+        label, stats.p50Ms, stats.p90Ms, stats.p99Ms, stats.p999Ms, overhead ? " | Overhead subtracted" : "");
+    if (stats.capped) {
+        fprintf(out, "%sWindow capped at %llu samples: covers %.1f s of the %.1f s history\n", label,
+            static_cast<unsigned long long>(stats.Finished() + stats.duplicates), stats.spanSeconds,
+            shared.historySeconds.load());
+    }
+    WindowSummary corrected;
+    shared.correctedStats.Load(corrected);
+    PrintCorrected(out, label, corrected);
+    PrintRateControl(out, label, shared);
+    fflush(out);
+}
+
+// Session file settings of a run
+SessionInfo SessionInfoFor(const SamplerConfig& config) {
+    SessionInfo info;
+    info.host = config.host;
+    info.intervalUs = config.intervalUs;
+    info.timeoutMs = config.timeoutMs;
+    info.payloadSize = config.payloadSize;
+    info.maxInFlight = config.maxInFlight;
+    return info;
+}
+
+// SamplerShared::notifySettings: put the change into the session file
+void RecordSettingsChange(void* context, const SamplerConfig& config, uint64_t firstIndex) {
+    static_cast<SessionWriter*>(context)->ChangeSettings(SessionInfoFor(config), firstIndex);
+}
+
+// Figures over a whole run or file, ping style
+void PrintSummary(FILE* out, const std::string& host, const WindowSummary& totals) {
+    fprintf(out, "--- %s statistics ---\n", host.c_str());
+    fprintf(out, "%llu probes, %llu answered, %.1f%% loss\n",
+        static_cast<unsigned long long>(totals.Finished()),
+        static_cast<unsigned long long>(totals.answered), totals.LossPercent());
+    if (totals.late + totals.reordered + totals.duplicates > 0) {
+        fprintf(out, "%llu late, %llu reordered (%.1f%%), %llu duplicates\n",
+            static_cast<unsigned long long>(totals.late), static_cast<unsigned long long>(totals.reordered),
+            totals.ReorderPercent(), static_cast<unsigned long long>(totals.duplicates));
+    }
+    if (totals.answered > 0) {
+        fprintf(out, "Avg: %.3f ms | Min: %.3f ms | Max: %.3f ms | Jitter: %.3f ms\n",
+            totals.averageMs, totals.minMs, totals.maxMs, totals.jitterMs);
+        fprintf(out, "p50: %.3f ms | p90: %.3f ms | p99: %.3f ms | p99.9: %.3f ms\n",
+            totals.p50Ms, totals.p90Ms, totals.p99Ms, totals.p999Ms);
+    }
+    fflush(out);
+}
+
+// Which clock stamped the replies behind the figures
+void PrintTimestamps(FILE* out, const unsigned long long (&counts)[TIMESTAMP_SOURCE_COUNT]) {
+    fprintf(out, "Timestamps:");
+    for (int i = 0; i < TIMESTAMP_SOURCE_COUNT; i++) {
+        fprintf(out, "%s %llu %s", i > 0 ? " |" : "", counts[i], TimestampSourceName(static_cast<TimestampSource>(i)));
+    }
+    fprintf(out, "\n");
+    fflush(out);
+}
+
+void PrintTimestamps(FILE* out, const SamplerShared& shared) {
+    unsigned long long counts[TIMESTAMP_SOURCE_COUNT];
+    for (int i = 0; i < TIMESTAMP_SOURCE_COUNT; i++) {
+        counts[i] = shared.timestamps[i].load();
+    }
+    PrintTimestamps(out, counts);
+}
+
+// How closely the sends kept to their deadlines
+void PrintSchedule(FILE* out, const SamplerShared& shared) {
+    fprintf(out, "Schedule: late p50 %.1f us | p99 %.1f us | max %.1f us | %llu slots skipped\n",
+        shared.lateP50Ns.load() / 1000.0, shared.lateP99Ns.load() / 1000.0, shared.lateMaxNs.load() / 1000.0,
+        shared.skippedSends.load());
+    fflush(out);
+}
+
+// The loopback baseline next to the run: its jitter is the part of the
+// run's jitter the tool and this machine account for themselves
+void PrintBaseline(FILE* out, const WindowSummary& baseline, const WindowSummary& totals) {
+    fprintf(out, "Loopback baseline: %llu probes | Avg: %.3f ms | p99: %.3f ms | Max: %.3f ms | Jitter: %.3f ms\n",
+        static_cast<unsigned long long>(baseline.Finished()), baseline.averageMs, baseline.p99Ms, baseline.maxMs,
+        baseline.jitterMs);
+    // A share of a jitter too small to print means nothing, and the tool
+    // cannot account for more than all of it
+    if (totals.answered > 0) {
+        if (totals.jitterMs >= MIN_SELF_JITTER_BASE_MS) {
+            double percent = std::min(100.0, 100.0 * baseline.jitterMs / totals.jitterMs);
+            fprintf(out, "Self-jitter: %.3f ms of %.3f ms measured (%.1f%%)\n", baseline.jitterMs, totals.jitterMs, percent);
+        } else {
+            fprintf(out, "Self-jitter: %.3f ms of %.3f ms measured (n/a)\n", baseline.jitterMs, totals.jitterMs);
+        }
+    }
+    fflush(out);
+}
+
+// Parse one --commands line, e.g. "interval 2.5". Returns false on anything
+// else.
+bool ParseCommand(const char* line, SamplerCommand& command) {
+    const char* space = strchr(line, ' ');
+    if (!space) return false;
+    std::string name(line, space - line);
+    char* end;
+    double value = strtod(space + 1, &end);
+    if (end == space + 1 || (*end != '\0' && *end != '\n' && *end != '\r')) return false;
+    if (name == "interval" && value >= 0.0) {
+        command = { SamplerSetting::IntervalUs, static_cast<int64_t>(value * 1000.0 + 0.5) };
+    } else if (name == "rate" && value > 0.0) {
+        command = { SamplerSetting::IntervalUs, static_cast<int64_t>(1e6 / value + 0.5) };
+    } else if (name == "timeout" && value >= 1.0) {
+        command = { SamplerSetting::TimeoutMs, static_cast<int64_t>(value) };
+    } else if (name == "size" && value >= 0.0 && value <= MAX_PAYLOAD_SIZE) {
+        command = { SamplerSetting::PayloadSize, static_cast<int64_t>(value) };
+    } else if (name == "history" && value >= 1.0 && value <= MAX_HISTORY_SECONDS) {
+        command = { SamplerSetting::HistoryMs, static_cast<int64_t>(value * 1000.0 + 0.5) };
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Queue the setting changes typed on stdin until it closes
+void ReadCommands() {
+    char line[128];
+    while (fgets(line, sizeof(line), stdin)) {
+        SamplerCommand command;
+        if (!ParseCommand(line, command)) {
+            fprintf(stderr, "Unknown command: %s", line);
+        } else if (!g_Commands.Push(command)) {
+            fprintf(stderr, "Too many commands waiting; dropped: %s", line);
+        }
+    }
+}
+
+// Smallest store that holds the history window at the configured rate, so
+// a slow monitor does not carry the full flood-ping ring. A zero interval
+// has no known rate and gets the full ring.
+size_t StoreCapacityFor(const SamplerConfig& config, float historySeconds) {
+    if (config.intervalUs <= 0) return SAMPLE_STORE_CAPACITY;
+    double probes = historySeconds * 1e6 / config.intervalUs * config.maxInFlight * 2;
+    size_t capacity = MIN_STORE_CAPACITY;
+    while (capacity < probes && capacity < SAMPLE_STORE_CAPACITY) capacity <<= 1;
+    return capacity;
+}
+
+// "<width>x<height>"
+bool ParseSize(const char* text, int& width, int& height) {
+    char* end;
+    width = static_cast<int>(strtol(text, &end, 10));
+    if (*end != 'x') return false;
+    height = static_cast<int>(strtol(end + 1, &end, 10));
+    return *end == '\0';
+}
+
+// Render the history window of the store the way the GUI draws it and write
+// it as PNG, or PPM if the name ends in .ppm
+bool WriteSnapshot(const std::string& path, int width, int height, const SampleStore& store,
+    const SamplerShared& shared, float historySeconds) {
+    GraphRenderer renderer;
+    renderer.Resize(width, height);
+    renderer.SetPalette(GraphPalette::Light());
+    int graphWidth = renderer.PlotWidth();
+
+    GraphFrame frame;
+    frame.historySeconds = historySeconds;
+    shared.stats.Load(frame.stats);
+    frame.pingsPerSecond = shared.pingsPerSecond.load();
+    frame.rateState = shared.rateState.load();
+    frame.controlRate = shared.controlRate.load();
+    frame.controlWindow = shared.controlWindow.load();
+
+    ColumnDecimator decimator;
+    std::vector<const ColumnEnvelope*> columns;
+    if (graphWidth > 0) {
+        int64_t columnNs = static_cast<int64_t>(historySeconds * 1e9) / graphWidth;
+        decimator.Configure(graphWidth, columnNs);
+        decimator.Update(store);
+        frame.hasData = decimator.HasData();
+    }
+    if (frame.hasData) {
+        frame.firstColumn = decimator.NewestColumn() - graphWidth + 1;
+        for (int i = 0; i < graphWidth; i++) {
+            columns.push_back(decimator.Column(frame.firstColumn + i));
+        }
+        frame.columns = &columns;
+        frame.maxPingMs = frame.stats.maxMs * 1.2 > 1.0 ? frame.stats.maxMs * 1.2 : 1.0;
+    }
+    renderer.Render(frame);
+
+    bool ppm = path.size() >= 4 && path.compare(path.size() - 4, 4, ".ppm") == 0;
+    return ppm ? renderer.Frame().WritePpm(path) : renderer.Frame().WritePng(path);
+}
+
+// Resolver for the sim backend: every name gets SIMULATED_ADDRESSES without
+// any DNS traffic
+std::unique_ptr<Resolver> CreateSimulatedResolver() {
+    std::vector<NetAddress> answers;
+    for (const char* text : SIMULATED_ADDRESSES) {
+        NetAddress address;
+        if (ParseNetAddress(text, address)) answers.push_back(address);
+    }
+    return std::unique_ptr<Resolver>(new Resolver(StubLookup(answers)));
+}
+
+// Replace every host by all of its addresses, in the order they resolved.
+// Prints why and returns false if a host does not resolve.
+bool ExpandAddresses(Resolver& resolver, std::vector<std::string>& hosts) {
+    // Look every name up at once, then collect the answers
+    std::vector<std::shared_ptr<ResolvedHost>> resolved;
+    for (const std::string& host : hosts) {
+        resolved.push_back(resolver.Watch(host));
+    }
+    std::atomic<bool> waiting(true);
+    std::vector<std::string> expanded;
+    for (const std::shared_ptr<ResolvedHost>& host : resolved) {
+        Resolver::Wait(*host, waiting);
+        std::vector<NetAddress> addresses;
+        std::string error;
+        host->Addresses(addresses, &error);
+        if (addresses.empty()) {
+            fprintf(stderr, "Could not resolve hostname: %s\nError: %s\n", host->Name().c_str(), error.c_str());
+            return false;
+        }
+        for (const NetAddress& address : addresses) {
+            std::string text = FormatNetAddress(address);
+            if (std::find(expanded.begin(), expanded.end(), text) == expanded.end()) expanded.push_back(text);
+        }
+    }
+    hosts = expanded;
+    return true;
+}
+
+// host with the address it resolved to, if that is known within timeoutMs
+// and differs from the host itself
+std::string DescribeHost(Resolver& resolver, const std::string& host, int timeoutMs) {
+    std::shared_ptr<ResolvedHost> resolved = resolver.Watch(host);
+    std::atomic<bool> waiting(true);
+    Resolver::Wait(*resolved, waiting, timeoutMs);
+    std::vector<NetAddress> addresses;
+    resolved->Addresses(addresses);
+    if (addresses.empty()) return host;
+    std::string text = FormatNetAddress(addresses[0]);
+    return text == host ? host : host + " (" + text + ")";
+}
+
+// Probe loopback for seconds with the run's settings. The jitter it sees is
+// what the tool and this machine add on their own, the floor under any
+// jitter measured to a real host. Returns false if it could not probe.
+bool MeasureBaseline(SamplerConfig config, ProbeBackend backend, double seconds, WindowSummary& baseline,
+    std::string& error) {
+    std::unique_ptr<ProbeEngine> engine = CreateProbeEngine(backend);
+    if (!engine) {
+        error = "Backend not available on this platform";
+        return false;
+    }
+    config.host = BASELINE_HOST;
+    SampleStore store(StoreCapacityFor(config, static_cast<float>(seconds)));
+    SamplerShared shared;
+    Sampler sampler(*engine, store, shared);
+
+    std::atomic<bool> running(true);
+    bool opened = true;
+    std::thread probeThread([&]() {
+        opened = sampler.Run(config, running);
+        running = false;
+    });
+    auto end = std::chrono::steady_clock::now() + std::chrono::duration<double>(seconds);
+    while (running && !g_StopRequested && std::chrono::steady_clock::now() < end) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(WAIT_TICK_MS));
+    }
+    running = false;
+    probeThread.join();
+
+    if (!opened) {
+        error = sampler.LastError();
+        return false;
+    }
+    shared.totals.Load(baseline);
+    return true;
+}
+
+// Sleep until the probe thread stops, the duration passes or a stop signal
+// arrives, calling report() every reportSeconds. Clears running when done.
+template <typename Report>
+void WaitForEnd(std::atomic<bool>& running, const RunOptions& options, Report report) {
+    auto start = std::chrono::steady_clock::now();
+    auto nextReport = start + std::chrono::duration<double>(options.reportSeconds);
+    while (running && !g_StopRequested) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(WAIT_TICK_MS));
+        auto now = std::chrono::steady_clock::now();
+        if (options.reportSeconds > 0 && now >= nextReport && running) {
+            report();
+            nextReport += std::chrono::duration<double>(options.reportSeconds);
+        }
+        if (options.durationSeconds > 0 && now - start >= std::chrono::duration<double>(options.durationSeconds)) {
+            break;
+        }
+    }
+    running = false;
+}
+
+} // namespace
+
+// Print what a session file holds and the figures over all of it
+int ReplaySession(const std::string& path) {
+    SessionReader session;
+    if (!session.Open(path)) {
+        fprintf(stderr, "%s\n", session.LastError().c_str());
+        return 1;
+    }
+
+    const SessionHeader& header = session.Header();
+    printf("Session %s -> %s\n", path.c_str(), header.host);
+    double intervalMs = header.intervalUs ? header.intervalUs / 1000.0 : header.intervalMs;
+    const std::vector<SessionSettingsChange>& changes = session.SettingsChanges();
+    printf("%sInterval: %g ms | Timeout: %u ms | Payload: %u bytes | In flight: %u\n",
+        changes.empty() ? "" : "At start: ", intervalMs, header.timeoutMs, header.payloadSize, header.maxInFlight);
+    for (const SessionSettingsChange& change : changes) {
+        const SessionSettings& settings = change.settings;
+        printf("From record %llu (+%.3f s): Interval: %g ms | Timeout: %u ms | Payload: %u bytes | In flight: %u\n",
+            static_cast<unsigned long long>(change.firstRecord), (settings.changeNs - header.startMonotonicNs) / 1e9,
+            settings.intervalUs / 1000.0, settings.timeoutMs, settings.payloadSize, settings.maxInFlight);
+    }
+    printf("Records: %llu in %zu blocks | Span: %.3f s\n",
+        static_cast<unsigned long long>(session.RecordCount()), session.BlockCount(),
+        (session.LastSendNs() - session.FirstSendNs()) / 1e9);
+
+    RunStats stats;
+    unsigned long long timestamps[TIMESTAMP_SOURCE_COUNT] = {};
+    session.ForEach(0, [&](const SessionRecord& record) {
+        stats.Add(record.rttNs, static_cast<SampleStatus>(record.status));
+        if (static_cast<SampleStatus>(record.status) == SampleStatus::Ok && record.timestampSource < TIMESTAMP_SOURCE_COUNT) {
+            timestamps[record.timestampSource]++;
+        }
+    });
+    WindowSummary totals;
+    stats.Summarize(totals);
+    PrintSummary(stdout, header.host, totals);
+    if (totals.answered > 0) PrintTimestamps(stdout, timestamps);
+    return 0;
+}
+
+// Probe several hosts from MultiSampler event loops
+int RunMultiTarget(const std::vector<std::string>& hosts, SamplerConfig config, ProbeBackend backend,
+    Resolver& resolver, int threadCount, const RunOptions& options, float historySeconds, bool intervalGiven) {
+    if (!intervalGiven) config.intervalUs = MULTI_TARGET_INTERVAL_MS * 1000;
+
+    MultiSampler sampler([backend]() { return CreateProbeEngine(backend); });
+    sampler.SetResolver(&resolver);
+    for (const std::string& host : hosts) {
+        sampler.AddTarget(host);
+    }
+    for (size_t i = 0; i < sampler.TargetCount(); i++) {
+        sampler.Target(i).shared.historySeconds = historySeconds;
+    }
+
+    std::atomic<bool> running(true);
+    bool opened = true;
+    std::thread probeThread([&]() {
+        opened = sampler.Run(config, threadCount, running);
+        running = false;
+    });
+
+    fprintf(options.report, "PingPlot %zu targets on %d thread(s)\n", hosts.size(), threadCount);
+    if (options.calibrator) PrintCalibration(options.report, *options.calibrator, false);
+    WaitForEnd(running, options, [&]() {
+        CalibrationResult calibration;
+        const OverheadEstimate* overhead = OverheadToSubtract(options, calibration);
+        for (size_t i = 0; i < sampler.TargetCount(); i++) {
+            TargetSeries& target = sampler.Target(i);
+            std::string label = target.host + " | ";
+            PrintStats(options.report, label.c_str(), target.shared, overhead);
+        }
+    });
+    probeThread.join();
+
+    if (!opened) {
+        fprintf(stderr, "%s\n", sampler.LastError().c_str());
+        return 1;
+    }
+    CalibrationResult calibration;
+    const OverheadEstimate* overhead = OverheadToSubtract(options, calibration);
+    bool allAnswered = true;
+    for (size_t i = 0; i < sampler.TargetCount(); i++) {
+        TargetSeries& target = sampler.Target(i);
+        WindowSummary totals;
+        target.shared.totals.Load(totals);
+        PrintSummary(options.report, target.host, overhead ? SubtractOverhead(totals, *overhead) : totals);
+        WindowSummary corrected;
+        target.shared.correctedTotals.Load(corrected);
+        PrintCorrected(options.report, "", corrected);
+        if (totals.answered > 0) PrintTimestamps(options.report, target.shared);
+        PrintSchedule(options.report, target.shared);
+        if (totals.answered == 0) allAnswered = false;
+    }
+    if (options.calibrator) PrintCalibration(options.report, *options.calibrator, overhead != nullptr);
+    return allAnswered ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    SamplerConfig config;
+    ProbeBackend backend = ProbeBackend::Default;
+    RunOptions options;
+    float historySeconds = HISTORY_SECONDS;
+    int threadCount = 1;
+    bool intervalGiven = false;
+    bool allAddresses = false;
+    double baselineSeconds = 0.0;
+    bool calibrate = true;
+    bool commands = false;
+    bool inFlightGiven = false;
+    double calibrateSeconds = 0.0;
+    std::string recordPath;
+    std::vector<std::string> exportSpecs;
+    std::string snapshotPath;
+    int snapshotWidth = SNAPSHOT_WIDTH;
+    int snapshotHeight = SNAPSHOT_HEIGHT;
+    ExportPolicy exportPolicy = ExportPolicy::Drop;
+    std::vector<std::string> hosts;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        bool hasValue = (i + 1 < argc);
+        if (strcmp(arg, "--backend") == 0 && hasValue) {
+            if (!ParseProbeBackend(argv[++i], backend)) {
+                fprintf(stderr, "Unknown backend: %s\n", argv[i]);
+                return 2;
+            }
+        } else if (strcmp(arg, "--interval") == 0 && hasValue) {
+            double intervalMs = atof(argv[++i]);
+            config.intervalUs = intervalMs > 0.0 ? static_cast<int64_t>(intervalMs * 1000.0 + 0.5) : 0;
+            intervalGiven = true;
+        } else if (strcmp(arg, "--rate") == 0 && hasValue) {
+            double rate = atof(argv[++i]);
+            if (rate <= 0.0) {
+                fprintf(stderr, "Bad rate: %s\n", argv[i]);
+                return 2;
+            }
+            config.intervalUs = static_cast<int64_t>(1e6 / rate + 0.5);
+            intervalGiven = true;
+        } else if (strcmp(arg, "--corrected") == 0) {
+            config.correctedLatency = true;
+        } else if (strcmp(arg, "--timeout") == 0 && hasValue) {
+            config.timeoutMs = atoi(argv[++i]);
+        } else if (strcmp(arg, "--size") == 0 && hasValue) {
+            config.payloadSize = atoi(argv[++i]);
+        } else if (strcmp(arg, "--inflight") == 0 && hasValue) {
+            config.maxInFlight = atoi(argv[++i]);
+            inFlightGiven = true;
+        } else if (strcmp(arg, "--adaptive") == 0) {
+            config.adaptiveRate = true;
+        } else if (strcmp(arg, "--cpu-budget") == 0 && hasValue) {
+            config.cpuBudgetPercent = atof(argv[++i]);
+            config.adaptiveRate = true;
+        } else if (strcmp(arg, "--duration") == 0 && hasValue) {
+            options.durationSeconds = atof(argv[++i]);
+        } else if (strcmp(arg, "--report") == 0 && hasValue) {
+            options.reportSeconds = atof(argv[++i]);
+        } else if (strcmp(arg, "--history") == 0 && hasValue) {
+            historySeconds = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(arg, "--threads") == 0 && hasValue) {
+            threadCount = atoi(argv[++i]);
+        } else if (strcmp(arg, "--all-addresses") == 0) {
+            allAddresses = true;
+        } else if (strcmp(arg, "--low-jitter") == 0) {
+            config.lowJitter = true;
+        } else if (strcmp(arg, "--cpu") == 0 && hasValue) {
+            config.lowJitterCpu = atoi(argv[++i]);
+        } else if (strcmp(arg, "--baseline") == 0 && hasValue) {
+            baselineSeconds = atof(argv[++i]);
+        } else if (strcmp(arg, "--no-calibrate") == 0) {
+            calibrate = false;
+        } else if (strcmp(arg, "--calibrate-every") == 0 && hasValue) {
+            calibrateSeconds = atof(argv[++i]);
+        } else if (strcmp(arg, "--subtract-overhead") == 0) {
+            options.subtractOverhead = true;
+        } else if (strcmp(arg, "--commands") == 0) {
+            commands = true;
+        } else if (strcmp(arg, "--record") == 0 && hasValue) {
+            recordPath = argv[++i];
+        } else if (strcmp(arg, "--replay") == 0 && hasValue) {
+            return ReplaySession(argv[++i]);
+        } else if (strcmp(arg, "--export") == 0 && hasValue) {
+            exportSpecs.push_back(argv[++i]);
+        } else if (strcmp(arg, "--export-policy") == 0 && hasValue) {
+            if (!ParseExportPolicy(argv[++i], exportPolicy)) {
+                fprintf(stderr, "Unknown export policy: %s\n", argv[i]);
+                return 2;
+            }
+        } else if (strcmp(arg, "--snapshot") == 0 && hasValue) {
+            snapshotPath = argv[++i];
+        } else if (strcmp(arg, "--snapshot-size") == 0 && hasValue) {
+            if (!ParseSize(argv[++i], snapshotWidth, snapshotHeight)) {
+                PrintUsage();
+                return 2;
+            }
+        } else if (arg[0] == '-') {
+            PrintUsage();
+            return 2;
+        } else {
+            hosts.push_back(arg);
+        }
+    }
+    if (config.timeoutMs <= 0 || config.payloadSize < 0 || config.maxInFlight < 1 ||
+        historySeconds < 1.0f || historySeconds > MAX_HISTORY_SECONDS ||
+        options.durationSeconds < 0 || options.reportSeconds < 0 || threadCount < 1 || baselineSeconds < 0 ||
+        calibrateSeconds < 0 || (options.subtractOverhead && !calibrate) || config.cpuBudgetPercent < 0 ||
+        snapshotWidth < 1 || snapshotHeight < 1 || snapshotWidth > 16384 || snapshotHeight > 16384) {
+        PrintUsage();
+        return 2;
+    }
+    if (hosts.empty()) {
+        if (backend != ProbeBackend::Simulated) {
+            PrintUsage();
+            return 2;
+        }
+        hosts.push_back("simulated");
+    }
+
+    // Stop cleanly and still print the summary
+    std::signal(SIGINT, OnStopSignal);
+    std::signal(SIGTERM, OnStopSignal);
+
+    // The simulated backend never sends to its addresses, so its names are
+    // not looked up either
+    std::unique_ptr<Resolver> simulatedResolver;
+    if (backend == ProbeBackend::Simulated) simulatedResolver = CreateSimulatedResolver();
+    Resolver& resolver = simulatedResolver ? *simulatedResolver : DefaultResolver();
+
+    if (allAddresses && !ExpandAddresses(resolver, hosts)) return 1;
+
+    // The tool's own overhead, measured before the run so the two do not
+    // disturb each other; without it the run goes on uncalibrated
+    Calibrator calibrator;
+    if (calibrate) {
+        ProbeOptions calibrationOptions;
+        calibrationOptions.payloadSize = config.payloadSize;
+        calibrationOptions.busyPoll = config.lowJitter;
+        if (!calibrator.Start(backend, calibrationOptions, calibrateSeconds)) {
+            fprintf(stderr, "Calibration: %s\n", calibrator.LastError().c_str());
+        }
+        options.calibrator = &calibrator;
+    }
+    if (hosts.size() > 1) {
+        if (!recordPath.empty() || !exportSpecs.empty() || !snapshotPath.empty() || config.lowJitter ||
+            baselineSeconds > 0 || commands || config.adaptiveRate) {
+            fprintf(stderr, "--record, --export, --snapshot, --low-jitter, --baseline, --commands and --adaptive take a single host\n");
+            return 2;
+        }
+        return RunMultiTarget(hosts, config, backend, resolver, threadCount, options, historySeconds, intervalGiven);
+    }
+    config.host = hosts[0];
+
+    // Without a rate the controller goes as fast as the depth, the CPU
+    // budget and the path allow
+    if (config.adaptiveRate) {
+        if (!intervalGiven) config.intervalUs = 0;
+        if (!inFlightGiven) config.maxInFlight = RATE_CONTROL_DEFAULT_MAX_IN_FLIGHT;
+    }
+
+    std::unique_ptr<ProbeEngine> engine = CreateProbeEngine(backend);
+    if (!engine) {
+        fprintf(stderr, "Backend not available on this platform\n");
+        return 1;
+    }
+
+    // Loopback first, so its figures are not disturbed by the real run
+    WindowSummary baseline;
+    if (baselineSeconds > 0) {
+        fprintf(stderr, "Measuring loopback baseline for %.0f s\n", baselineSeconds);
+        std::string error;
+        if (!MeasureBaseline(config, backend, baselineSeconds, baseline, error)) {
+            fprintf(stderr, "Baseline: %s\n", error.c_str());
+            return 1;
+        }
+    }
+
+    // A rate or history command can raise what the store has to hold, so
+    // a run taking commands gets the full ring from the start
+    SampleStore store(commands ? SAMPLE_STORE_CAPACITY : StoreCapacityFor(config, historySeconds));
+    SamplerShared shared;
+    shared.historySeconds = historySeconds;
+    Sampler sampler(*engine, store, shared);
+    sampler.SetResolver(&resolver);
+    if (commands) {
+        sampler.SetCommands(&g_Commands);
+        std::thread(ReadCommands).detach();
+    }
+
+    SessionWriter recorder;
+    if (!recordPath.empty()) {
+        if (!recorder.Start(recordPath, SessionInfoFor(config), store)) {
+            fprintf(stderr, "%s\n", recorder.LastError().c_str());
+            return 1;
+        }
+        shared.notifySettings = RecordSettingsChange;
+        shared.settingsContext = &recorder;
+    }
+
+    // Stats go to stderr while an export owns stdout
+    std::vector<std::unique_ptr<Exporter>> exporters;
+    for (const std::string& spec : exportSpecs) {
+        size_t colon = spec.find(':');
+        ExportFormat format;
+        if (colon == std::string::npos || !ParseExportFormat(spec.substr(0, colon).c_str(), format)) {
+            fprintf(stderr, "Bad export: %s\n", spec.c_str());
+            return 2;
+        }
+        std::string path = spec.substr(colon + 1);
+        std::string error;
+        std::unique_ptr<ExportSink> sink = CreateExportSink(format, path, error);
+        if (!sink) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+        if (path == "-") options.report = stderr;
+        exporters.emplace_back(new Exporter(std::move(sink), exportPolicy));
+        exporters.back()->Start(store);
+    }
+
+    std::atomic<bool> running(true);
+    bool opened = true;
+    std::thread probeThread([&]() {
+        opened = sampler.Run(config, running);
+        running = false;
+    });
+
+    fprintf(options.report, "PingPlot %s -> %s\n", engine->Name(),
+        DescribeHost(resolver, config.host, config.timeoutMs).c_str());
+    if (options.calibrator) PrintCalibration(options.report, *options.calibrator, false);
+    WaitForEnd(running, options, [&]() {
+        CalibrationResult calibration;
+        PrintStats(options.report, "", shared, OverheadToSubtract(options, calibration));
+    });
+    probeThread.join();
+    recorder.Stop();
+    for (std::unique_ptr<Exporter>& exporter : exporters) {
+        exporter->Stop();
+    }
+
+    if (!opened) {
+        fprintf(stderr, "%s\n", sampler.LastError().c_str());
+        return 1;
+    }
+    WindowSummary totals;
+    shared.totals.Load(totals);
+    CalibrationResult calibration;
+    const OverheadEstimate* overhead = OverheadToSubtract(options, calibration);
+    PrintSummary(options.report, config.host, overhead ? SubtractOverhead(totals, *overhead) : totals);
+    WindowSummary corrected;
+    shared.correctedTotals.Load(corrected);
+    PrintCorrected(options.report, "", corrected);
+    if (totals.answered > 0) PrintTimestamps(options.report, shared);
+    if (config.intervalUs > 0 || config.adaptiveRate) PrintSchedule(options.report, shared);
+    PrintRateControl(options.report, "", shared);
+    if (options.calibrator) PrintCalibration(options.report, *options.calibrator, overhead != nullptr);
+    if (config.lowJitter) fprintf(options.report, "Low jitter: %s\n", sampler.LowJitter().Describe().c_str());
+    if (baselineSeconds > 0) PrintBaseline(options.report, baseline, totals);
+    for (size_t i = 0; i < exporters.size(); i++) {
+        const Exporter& exporter = *exporters[i];
+        fprintf(options.report, "Export %s: %llu exported | %llu coalesced | %llu dropped | %llu skipped\n",
+            exportSpecs[i].c_str(), static_cast<unsigned long long>(exporter.Exported()),
+            static_cast<unsigned long long>(exporter.Coalesced()), static_cast<unsigned long long>(exporter.Dropped()),
+            static_cast<unsigned long long>(exporter.Skipped()));
+    }
+    if (!recordPath.empty()) {
+        fprintf(options.report, "Recorded: %llu | Skipped: %llu\n", static_cast<unsigned long long>(recorder.RecordsWritten()),
+            static_cast<unsigned long long>(recorder.RecordsSkipped()));
+    }
+    if (!snapshotPath.empty()) {
+        if (!WriteSnapshot(snapshotPath, snapshotWidth, snapshotHeight, store, shared, shared.historySeconds.load())) {
+            fprintf(stderr, "Cannot write %s\n", snapshotPath.c_str());
+            return 1;
+        }
+        fprintf(options.report, "Snapshot: %s\n", snapshotPath.c_str());
+    }
+    return totals.answered > 0 ? 0 : 1;
+}
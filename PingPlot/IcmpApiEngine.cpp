@@ -0,0 +1,350 @@
+#ifdef _WIN32
+
+#include "ProbeEngine.h"
+#include "Clock.h"
+#include <WS2tcpip.h>
+#include <winsock2.h>
+#include <windows.h>
+#include <iphlpapi.h>
+#include <icmpapi.h>
+#include <cstring>
+#include <vector>
+
+#pragma comment(lib, "iphlpapi.lib")
+#pragma comment(lib, "ws2_32.lib")
+
+namespace {
+
+// Windows backend built on the ICMP helper API; IPv6 targets go through a
+// second handle from Icmp6CreateFile, opened when the first one is added.
+// With a single probe in flight the echo calls are used synchronously: Send
+// performs the whole round trip and Receive hands back the result. With a larger window every probe gets its
+// own IcmpSendEcho2 request, reply buffer and event, and Receive waits on
+// all outstanding events. Each probe's payload names it and carries its
+// send time. The API discards replies that come after the timeout, so late
+// replies and duplicates are never seen here.
+class IcmpApiEngine : public ProbeEngine {
+public:
+    ~IcmpApiEngine() override {
+        Close();
+    }
+
+    bool Open(const ProbeOptions& options) override {
+        Close();
+        m_Options = options;
+
+        // Open ICMP handle
+        m_Icmp = IcmpCreateFile();
+        if (m_Icmp == INVALID_HANDLE_VALUE) {
+            m_LastError = "Failed to create ICMP handle";
+            Close();
+            return false;
+        }
+
+        FillBuffers(options.payloadSize);
+        m_RunId = NewProbeRunId();
+
+        // One request slot per probe that may be outstanding
+        m_Slots.clear();
+        if (options.maxInFlight > 1) {
+            int slotCount = options.maxInFlight < MAX_ENGINE_IN_FLIGHT ? options.maxInFlight : MAX_ENGINE_IN_FLIGHT;
+            m_Slots.resize(slotCount);
+            for (RequestSlot& slot : m_Slots) {
+                slot.event = CreateEvent(NULL, TRUE, FALSE, NULL);
+                FillSlot(slot);
+                if (slot.event == NULL) {
+                    m_LastError = "Failed to create reply event";
+                    Close();
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    bool AddTarget(const NetAddress& address, int& target) override {
+        target = (int)m_Targets.size();
+        m_Targets.push_back(Target());
+        if (!SetTargetAddress(target, address)) {
+            m_Targets.pop_back();
+            return false;
+        }
+        return true;
+    }
+
+    bool SetTargetAddress(int target, const NetAddress& address) override {
+        if (address.family == 6 && m_Icmp6 == INVALID_HANDLE_VALUE) {
+            m_Icmp6 = Icmp6CreateFile();
+            if (m_Icmp6 == INVALID_HANDLE_VALUE) {
+                m_LastError = "Failed to create ICMPv6 handle";
+                return false;
+            }
+        } else if (address.family != 4 && address.family != 6) {
+            m_LastError = "Not an IPv4 or IPv6 address";
+            return false;
+        }
+
+        Target& entry = m_Targets[target];
+        entry = Target();
+        entry.v6 = address.family == 6;
+        if (entry.v6) {
+            entry.address6.sin6_family = AF_INET6;
+            memcpy(&entry.address6.sin6_addr, address.bytes, 16);
+        } else {
+            memcpy(&entry.address4, address.bytes, 4);
+        }
+        return true;
+    }
+
+    // Outstanding requests keep their own buffers; a slot takes the new
+    // size when it is next used
+    bool SetOptions(const ProbeOptions& options) override {
+        if (options.payloadSize < 0 || options.payloadSize > MAX_PAYLOAD_SIZE) {
+            m_LastError = "Bad payload size";
+            return false;
+        }
+        m_Options.timeoutMs = options.timeoutMs;
+        if (options.payloadSize != m_Options.payloadSize) {
+            m_Options.payloadSize = options.payloadSize;
+            FillBuffers(options.payloadSize);
+        }
+        return true;
+    }
+
+    bool Send(int target, uint32_t sequence, int64_t& sendTimeNs) override {
+        if (!m_Slots.empty()) {
+            return SendAsync(target, sequence, sendTimeNs);
+        }
+
+        Target& destination = m_Targets[target];
+        sendTimeNs = MonotonicNowNs();
+        WriteProbePayload((uint8_t*)m_SendData.data(), m_SendData.size(), m_RunId, sequence, sendTimeNs);
+        DWORD result = 0;
+        if (destination.v6) {
+            // With no event or APC routine the call is synchronous
+            result = Icmp6SendEcho2(m_Icmp6, NULL, NULL, NULL, &m_Source6, &destination.address6,
+                m_SendData.data(), (WORD)m_SendData.size(), NULL,
+                m_ReplyBuffer.data(), (DWORD)m_ReplyBuffer.size(), m_Options.timeoutMs);
+        } else {
+            result = IcmpSendEcho(m_Icmp, destination.address4.S_un.S_addr,
+                m_SendData.data(), (WORD)m_SendData.size(), NULL,
+                m_ReplyBuffer.data(), (DWORD)m_ReplyBuffer.size(), m_Options.timeoutMs);
+        }
+
+        // Use our own high-precision timing instead of the API's integer milliseconds
+        m_Reply.target = target;
+        m_Reply.sequence = sequence;
+        m_Reply.receiveTimeNs = MonotonicNowNs();
+        m_HasReply = false;
+        if (result > 0) {
+            ReadReply(m_ReplyBuffer.data(), destination.v6, m_SendData.size(), sequence, m_Reply);
+            m_HasReply = true;
+        }
+        return true;
+    }
+
+    bool Receive(ProbeReply& reply, int64_t timeoutNs) override {
+        if (!m_Slots.empty()) {
+            // Waits here are in whole milliseconds; SCHEDULE_SPIN_NS covers
+            // the rounding
+            return ReceiveAsync(reply, static_cast<DWORD>((timeoutNs + 999999) / 1000000));
+        }
+
+        if (!m_HasReply) {
+            return false;
+        }
+        reply = m_Reply;
+        m_HasReply = false;
+        return true;
+    }
+
+    void Close() override {
+        if (m_Icmp != INVALID_HANDLE_VALUE) {
+            // Closing the handle cancels outstanding IcmpSendEcho2 requests
+            IcmpCloseHandle(m_Icmp);
+            m_Icmp = INVALID_HANDLE_VALUE;
+        }
+        if (m_Icmp6 != INVALID_HANDLE_VALUE) {
+            IcmpCloseHandle(m_Icmp6);
+            m_Icmp6 = INVALID_HANDLE_VALUE;
+        }
+        for (RequestSlot& slot : m_Slots) {
+            if (slot.event != NULL) {
+                CloseHandle(slot.event);
+                slot.event = NULL;
+            }
+        }
+        m_Slots.clear();
+        m_Targets.clear();
+    }
+
+    const char* Name() const override { return "icmpapi"; }
+
+private:
+    struct Target {
+        bool v6 = false;
+        IN_ADDR address4 = {};
+        sockaddr_in6 address6 = {};
+    };
+
+    // An outstanding IcmpSendEcho2 request
+    struct RequestSlot {
+        HANDLE event = NULL;
+        std::vector<char> replyBuffer;
+        std::vector<char> sendData;
+        int target = 0;
+        uint32_t sequence = 0;
+        bool v6 = false;
+        bool active = false;
+        bool failed = false; // The send failed synchronously; the reply buffer holds nothing of it
+    };
+
+    // Send time from the payload an echo reply carries back, or 0
+    int64_t EchoedSendTime(const void* data, size_t length, uint32_t sequence) const {
+        uint32_t echoedSequence = 0;
+        int64_t sendTimeNs = 0;
+        if (data == NULL) return 0;
+        if (!ReadProbePayload((const uint8_t*)data, length, m_RunId, echoedSequence, sendTimeNs)) return 0;
+        return echoedSequence == sequence ? sendTimeNs : 0;
+    }
+
+    // Send data with filler after the payload header, which Send fills in,
+    // and a reply buffer to match
+    void FillBuffers(int payloadSize) {
+        m_SendData.assign(payloadSize, 0);
+        static const char pattern[] = "PingPlotData";
+        for (int i = 0; i < payloadSize; i++) {
+            m_SendData[i] = pattern[i % (sizeof(pattern) - 1)];
+        }
+        m_ReplyBuffer.assign(sizeof(ICMPV6_ECHO_REPLY) + sizeof(ICMP_ECHO_REPLY) + payloadSize + 8, 0);
+    }
+
+    // Give a request slot buffers of the current size
+    void FillSlot(RequestSlot& slot) {
+        slot.replyBuffer.assign(m_ReplyBuffer.size() + 16, 0); // Room for an IO_STATUS_BLOCK
+        slot.sendData = m_SendData; // Kept until the request completes
+    }
+
+    // Fill status and echoed send time from a parsed reply buffer. An ICMPv6
+    // reply is followed by the echoed data, which has the request's length.
+    void ReadReply(const char* buffer, bool v6, size_t sentLength, uint32_t sequence, ProbeReply& reply) const {
+        if (v6) {
+            const ICMPV6_ECHO_REPLY* echo = (const ICMPV6_ECHO_REPLY*)buffer;
+            bool ok = echo->Status == IP_SUCCESS;
+            reply.status = ok ? ProbeStatus::Ok : ProbeStatus::Unreachable;
+            reply.echoedSendTimeNs = ok ? EchoedSendTime(echo + 1, sentLength, sequence) : 0;
+        } else {
+            const ICMP_ECHO_REPLY* echo = (const ICMP_ECHO_REPLY*)buffer;
+            bool ok = echo->Status == IP_SUCCESS;
+            reply.status = ok ? ProbeStatus::Ok : ProbeStatus::Unreachable;
+            reply.echoedSendTimeNs = ok ? EchoedSendTime(echo->Data, echo->DataSize, sequence) : 0;
+        }
+    }
+
+    // Start an asynchronous echo request in a free slot
+    bool SendAsync(int target, uint32_t sequence, int64_t& sendTimeNs) {
+        RequestSlot* slot = NULL;
+        for (RequestSlot& candidate : m_Slots) {
+            if (!candidate.active) {
+                slot = &candidate;
+                break;
+            }
+        }
+        if (slot == NULL) {
+            m_LastError = "Too many probes in flight";
+            return false;
+        }
+
+        if (slot->sendData.size() != m_SendData.size()) FillSlot(*slot);
+        ResetEvent(slot->event);
+        slot->target = target;
+        slot->sequence = sequence;
+        slot->active = true;
+        slot->failed = false;
+        sendTimeNs = MonotonicNowNs();
+        WriteProbePayload((uint8_t*)slot->sendData.data(), slot->sendData.size(), m_RunId, sequence, sendTimeNs);
+        Target& destination = m_Targets[target];
+        slot->v6 = destination.v6;
+        DWORD result = 0;
+        if (destination.v6) {
+            result = Icmp6SendEcho2(m_Icmp6, slot->event, NULL, NULL, &m_Source6, &destination.address6,
+                slot->sendData.data(), (WORD)slot->sendData.size(), NULL,
+                slot->replyBuffer.data(), (DWORD)slot->replyBuffer.size(), m_Options.timeoutMs);
+        } else {
+            result = IcmpSendEcho2(m_Icmp, slot->event, NULL, NULL, destination.address4.S_un.S_addr,
+                slot->sendData.data(), (WORD)slot->sendData.size(), NULL,
+                slot->replyBuffer.data(), (DWORD)slot->replyBuffer.size(), m_Options.timeoutMs);
+        }
+        if (result == 0 && GetLastError() != ERROR_IO_PENDING) {
+            // Failed synchronously (e.g. no route); report it as a reply
+            // without parsing the buffer, which still holds an earlier probe's
+            slot->failed = true;
+            SetEvent(slot->event);
+        }
+        return true;
+    }
+
+    // Wait for any outstanding request to complete
+    bool ReceiveAsync(ProbeReply& reply, DWORD timeoutMs) {
+        HANDLE events[MAX_ENGINE_IN_FLIGHT];
+        RequestSlot* slots[MAX_ENGINE_IN_FLIGHT];
+        DWORD count = 0;
+        for (RequestSlot& slot : m_Slots) {
+            if (slot.active) {
+                events[count] = slot.event;
+                slots[count] = &slot;
+                count++;
+            }
+        }
+        if (count == 0) {
+            Sleep(timeoutMs);
+            return false;
+        }
+
+        DWORD wait = WaitForMultipleObjects(count, events, FALSE, timeoutMs);
+        if (wait >= WAIT_OBJECT_0 + count) {
+            return false;
+        }
+
+        RequestSlot* slot = slots[wait - WAIT_OBJECT_0];
+        reply.target = slot->target;
+        reply.sequence = slot->sequence;
+        reply.receiveTimeNs = MonotonicNowNs();
+        reply.echoedSendTimeNs = 0;
+        slot->active = false;
+        if (slot->failed) {
+            reply.status = ProbeStatus::Unreachable;
+            return true;
+        }
+
+        DWORD replies = slot->v6
+            ? Icmp6ParseReplies(slot->replyBuffer.data(), (DWORD)slot->replyBuffer.size())
+            : IcmpParseReplies(slot->replyBuffer.data(), (DWORD)slot->replyBuffer.size());
+        if (replies == 0) {
+            reply.status = (GetLastError() == IP_REQ_TIMED_OUT) ? ProbeStatus::Timeout : ProbeStatus::Unreachable;
+        } else {
+            ReadReply(slot->replyBuffer.data(), slot->v6, slot->sendData.size(), slot->sequence, reply);
+        }
+        return true;
+    }
+
+    ProbeOptions m_Options;
+    HANDLE m_Icmp = INVALID_HANDLE_VALUE;
+    HANDLE m_Icmp6 = INVALID_HANDLE_VALUE; // Opened with the first IPv6 target
+    sockaddr_in6 m_Source6 = { AF_INET6 }; // Unspecified source address
+    uint32_t m_RunId = 0; // Identifies this engine's probes in their payload
+    std::vector<Target> m_Targets;
+    std::vector<char> m_SendData;
+    std::vector<char> m_ReplyBuffer;
+    ProbeReply m_Reply;
+    bool m_HasReply = false;
+    std::vector<RequestSlot> m_Slots;
+};
+
+} // namespace
+
+std::unique_ptr<ProbeEngine> CreateIcmpApiEngine() {
+    return std::unique_ptr<ProbeEngine>(new IcmpApiEngine());
+}
+
+#endif // _WIN32
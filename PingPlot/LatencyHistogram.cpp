@@ -0,0 +1,72 @@
+#include "LatencyHistogram.h"
+#include <cstring>
+
+LatencyHistogram::LatencyHistogram() {
+    Clear();
+}
+
+void LatencyHistogram::Clear() {
+    memset(m_Buckets, 0, sizeof(m_Buckets));
+    memset(m_Groups, 0, sizeof(m_Groups));
+    m_Total = 0;
+}
+
+// Values below SUB_BUCKET_COUNT map to themselves. Above that the value is
+// shifted right until it has SUB_BUCKET_BITS bits left; its top half selects
+// the bucket within the power of two, the shift selects the power of two.
+size_t LatencyHistogram::BucketOf(int64_t valueNs) {
+    if (valueNs < static_cast<int64_t>(SUB_BUCKET_COUNT)) {
+        return valueNs < 0 ? 0 : static_cast<size_t>(valueNs);
+    }
+    int shift = HighestBit(static_cast<uint64_t>(valueNs)) - SUB_BUCKET_BITS + 1;
+    if (shift > MAX_SHIFT) return BUCKET_COUNT - 1;
+    return static_cast<size_t>(shift) * (SUB_BUCKET_COUNT / 2) + static_cast<size_t>(valueNs >> shift);
+}
+
+int64_t LatencyHistogram::ValueOf(size_t bucket) {
+    if (bucket < SUB_BUCKET_COUNT) return static_cast<int64_t>(bucket);
+    size_t half = SUB_BUCKET_COUNT / 2;
+    int shift = static_cast<int>((bucket - half) / half);
+    int64_t low = static_cast<int64_t>(bucket - shift * half) << shift;
+    return low + (int64_t(1) << shift) / 2;
+}
+
+void LatencyHistogram::Add(int64_t valueNs) {
+    size_t bucket = BucketOf(valueNs);
+    m_Buckets[bucket]++;
+    m_Groups[bucket / SUB_BUCKET_COUNT]++;
+    m_Total++;
+}
+
+void LatencyHistogram::Remove(int64_t valueNs) {
+    size_t bucket = BucketOf(valueNs);
+    if (m_Buckets[bucket] == 0) return;
+    m_Buckets[bucket]--;
+    m_Groups[bucket / SUB_BUCKET_COUNT]--;
+    m_Total--;
+}
+
+int64_t LatencyHistogram::Percentile(double q) const {
+    if (m_Total == 0) return 0;
+    if (q < 0.0) q = 0.0;
+    if (q > 1.0) q = 1.0;
+
+    // Rank of the wanted sample, 1-based
+    uint64_t rank = static_cast<uint64_t>(q * m_Total + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > m_Total) rank = m_Total;
+
+    // Find the group first, then the bucket inside it
+    uint64_t seen = 0;
+    size_t group = 0;
+    while (group < GROUP_COUNT - 1 && seen + m_Groups[group] < rank) {
+        seen += m_Groups[group++];
+    }
+    size_t bucket = group * SUB_BUCKET_COUNT;
+    size_t end = bucket + SUB_BUCKET_COUNT < BUCKET_COUNT ? bucket + SUB_BUCKET_COUNT : BUCKET_COUNT;
+    for (; bucket < end - 1; bucket++) {
+        seen += m_Buckets[bucket];
+        if (seen >= rank) break;
+    }
+    return ValueOf(bucket);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Index of the highest set bit; value must be non-zero
+inline int HighestBit(uint64_t value) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return static_cast<int>(index);
+#else
+    return 63 - __builtin_clzll(value);
+#endif
+}
+
+// Log-linear (HDR-style) histogram of latencies in nanoseconds. Values below
+// 128 ns are counted exactly; above that every power of two is split into 64
+// buckets, so a reported value is within about 1% of the true one. The top
+// bucket covers everything from TOP_BUCKET_NS (about 272 s) up. Memory is
+// fixed (about 17 KB) however many samples are counted; Add, Remove and
+// Percentile are all constant time: a percentile walks at most 17 group
+// totals and one group.
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    void Clear();
+
+    void Add(int64_t valueNs);
+
+    // Undo an Add of the same value
+    void Remove(int64_t valueNs);
+
+    uint64_t Count() const { return m_Total; }
+
+    // Value at quantile q (0..1), e.g. 0.99 for p99. 0 when empty.
+    int64_t Percentile(double q) const;
+
+private:
+    static const int SUB_BUCKET_BITS = 7;
+    static const size_t SUB_BUCKET_COUNT = size_t(1) << SUB_BUCKET_BITS; // Exact range, and buckets per group
+    static const int MAX_MAGNITUDE = 37;                                  // Highest bit split into buckets
+    static const int MAX_SHIFT = MAX_MAGNITUDE - SUB_BUCKET_BITS + 1;
+    static const size_t BUCKET_COUNT = (MAX_SHIFT + 2) * (SUB_BUCKET_COUNT / 2);
+    static const size_t GROUP_COUNT = (BUCKET_COUNT + SUB_BUCKET_COUNT - 1) / SUB_BUCKET_COUNT;
+
+    // Lowest value of the top bucket, which also takes everything from
+    // 2^(MAX_MAGNITUDE + 1) ns up: 127 << 31 ns ~ 272.7 s
+    static const int64_t TOP_BUCKET_NS = static_cast<int64_t>(SUB_BUCKET_COUNT - 1) << MAX_SHIFT;
+
+    static size_t BucketOf(int64_t valueNs);
+
+    // Middle of the value range a bucket covers
+    static int64_t ValueOf(size_t bucket);
+
+    uint64_t m_Buckets[BUCKET_COUNT]; // 64-bit: whole-run histograms outgrow 2^32 within a day at 100k/s
+    uint64_t m_Groups[GROUP_COUNT];   // Sum of each run of SUB_BUCKET_COUNT buckets
+    uint64_t m_Total = 0;
+};
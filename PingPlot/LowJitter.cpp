@@ -0,0 +1,168 @@
+#include "LowJitter.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#ifdef _WIN32
+// Working set added to the minimum while low-jitter mode is on, so the
+// sampler's buffers are not trimmed out of RAM
+const size_t LOW_JITTER_WORKING_SET = 64 * 1024 * 1024;
+#endif
+
+// Touch the stack below the caller, so the probe loop's deepest calls find
+// it already mapped
+#if defined(_MSC_VER)
+__declspec(noinline)
+#else
+__attribute__((noinline))
+#endif
+void PrefaultStack() {
+    volatile uint8_t pages[LOW_JITTER_STACK_PREFAULT];
+    for (size_t i = 0; i < sizeof(pages); i += 4096) {
+        pages[i] = 0;
+    }
+}
+
+} // namespace
+
+std::string LowJitterState::Describe() const {
+    std::string text = cpu >= 0 ? "cpu " + std::to_string(cpu) : "not pinned";
+    text += realtime ? ", real-time priority" : raisedPriority ? ", raised priority" : ", normal priority";
+    text += memoryLocked ? ", memory locked" : ", memory not locked";
+    return text;
+}
+
+#ifdef _WIN32
+
+LowJitterState EnterLowJitterMode(int cpu) {
+    LowJitterState state;
+    state.active = true;
+
+    DWORD_PTR processMask = 0;
+    DWORD_PTR systemMask = 0;
+    if (GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask)) {
+        for (int i = 0; i < (int)(sizeof(DWORD_PTR) * 8); i++) {
+            if (processMask & ((DWORD_PTR)1 << i)) {
+                state.previousCpus.push_back(i);
+            }
+        }
+        if (cpu < 0 && !state.previousCpus.empty()) cpu = state.previousCpus.back();
+    }
+    if (cpu >= 0 && cpu < (int)(sizeof(DWORD_PTR) * 8) &&
+        SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu) != 0) {
+        state.cpu = cpu;
+    }
+
+    // Time-critical is the top of the process's priority class; the
+    // real-time class itself is left alone, as it can starve the system
+    state.previousPriority = GetThreadPriority(GetCurrentThread());
+    if (state.previousCpus.size() > 1 && SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL)) {
+        state.realtime = true;
+    } else if (SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST)) {
+        state.raisedPriority = true;
+    }
+
+    SIZE_T minimum = 0;
+    SIZE_T maximum = 0;
+    if (GetProcessWorkingSetSize(GetCurrentProcess(), &minimum, &maximum)) {
+        state.previousWorkingSetMin = minimum;
+        state.previousWorkingSetMax = maximum;
+        state.memoryLocked = SetProcessWorkingSetSize(GetCurrentProcess(), minimum + LOW_JITTER_WORKING_SET,
+            maximum + LOW_JITTER_WORKING_SET) != 0;
+    }
+    PrefaultStack();
+    return state;
+}
+
+void LeaveLowJitterMode(const LowJitterState& state) {
+    if (!state.active) return;
+    if (state.cpu >= 0) {
+        DWORD_PTR mask = 0;
+        for (int cpu : state.previousCpus) {
+            mask |= (DWORD_PTR)1 << cpu;
+        }
+        SetThreadAffinityMask(GetCurrentThread(), mask);
+    }
+    if (state.realtime || state.raisedPriority) SetThreadPriority(GetCurrentThread(), state.previousPriority);
+    if (state.memoryLocked) {
+        SetProcessWorkingSetSize(GetCurrentProcess(), state.previousWorkingSetMin, state.previousWorkingSetMax);
+    }
+}
+
+#else
+
+LowJitterState EnterLowJitterMode(int cpu) {
+    LowJitterState state;
+    state.active = true;
+
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (pthread_getaffinity_np(pthread_self(), sizeof(allowed), &allowed) == 0) {
+        for (int i = 0; i < CPU_SETSIZE; i++) {
+            if (CPU_ISSET(i, &allowed)) state.previousCpus.push_back(i);
+        }
+        if (cpu < 0 && !state.previousCpus.empty()) cpu = state.previousCpus.back();
+    }
+    if (cpu >= 0 && cpu < CPU_SETSIZE) {
+        cpu_set_t pinned;
+        CPU_ZERO(&pinned);
+        CPU_SET(cpu, &pinned);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(pinned), &pinned) == 0) state.cpu = cpu;
+    }
+
+    // SCHED_FIFO needs CAP_SYS_NICE or an RLIMIT_RTPRIO allowance; the
+    // kernel's real-time throttling still leaves the CPU some time for others
+    sched_param param = {};
+    pthread_getschedparam(pthread_self(), &state.previousPolicy, &param);
+    state.previousPriority = param.sched_priority;
+    param.sched_priority = LOW_JITTER_RT_PRIORITY;
+    if (state.previousCpus.size() > 1 && pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0) {
+        state.realtime = true;
+    } else {
+        pid_t thread = static_cast<pid_t>(syscall(SYS_gettid));
+        state.previousPriority = getpriority(PRIO_PROCESS, thread);
+        state.raisedPriority = setpriority(PRIO_PROCESS, thread, LOW_JITTER_NICE) == 0;
+    }
+
+    // Fault in and lock what is mapped now, then lock later allocations as
+    // they are first touched. Needs CAP_IPC_LOCK or a large RLIMIT_MEMLOCK.
+    if (mlockall(MCL_CURRENT) == 0) {
+        state.memoryLocked = true;
+#ifdef MCL_ONFAULT
+        mlockall(MCL_CURRENT | MCL_FUTURE | MCL_ONFAULT);
+#endif
+    }
+    PrefaultStack();
+    return state;
+}
+
+void LeaveLowJitterMode(const LowJitterState& state) {
+    if (!state.active) return;
+    if (state.cpu >= 0 && !state.previousCpus.empty()) {
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        for (int cpu : state.previousCpus) {
+            CPU_SET(cpu, &allowed);
+        }
+        pthread_setaffinity_np(pthread_self(), sizeof(allowed), &allowed);
+    }
+    if (state.realtime) {
+        sched_param param = {};
+        param.sched_priority = state.previousPriority;
+        pthread_setschedparam(pthread_self(), state.previousPolicy, &param);
+    } else if (state.raisedPriority) {
+        setpriority(PRIO_PROCESS, static_cast<pid_t>(syscall(SYS_gettid)), state.previousPriority);
+    }
+    if (state.memoryLocked) munlockall();
+}
+
+#endif
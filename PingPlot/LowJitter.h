@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// SCHED_FIFO priority of a low-jitter probe thread: above normal threads and
+// below the kernel's own real-time work
+const int LOW_JITTER_RT_PRIORITY = 10;
+
+// Nice value tried when real-time scheduling is not permitted
+const int LOW_JITTER_NICE = -10;
+
+// Stack touched up front so the probe loop never grows it by faulting
+const size_t LOW_JITTER_STACK_PREFAULT = 256 * 1024;
+
+// What EnterLowJitterMode set up for the calling thread. Every step is
+// best-effort; whatever the OS refused is left as it was.
+struct LowJitterState {
+    bool active = false;
+    int cpu = -1;                // CPU the thread is pinned to; -1 = not pinned
+    bool realtime = false;       // SCHED_FIFO / THREAD_PRIORITY_TIME_CRITICAL
+    bool raisedPriority = false; // Above normal without being real-time
+    bool memoryLocked = false;   // Pages locked in RAM (mlockall / working set minimum)
+
+    // One line for status output, e.g. "cpu 3, real-time priority, memory locked"
+    std::string Describe() const;
+
+    // Settings to restore in LeaveLowJitterMode
+    std::vector<int> previousCpus; // Affinity before pinning
+    int previousPolicy = 0;        // Scheduling policy (Linux)
+    int previousPriority = 0;      // Real-time priority or nice value (Linux), thread priority (Windows)
+    size_t previousWorkingSetMin = 0; // Windows only
+    size_t previousWorkingSetMax = 0;
+};
+
+// Pin the calling thread to cpu (-1 = the highest CPU it may run on, which
+// usually takes the fewest interrupts), raise it to real-time priority where
+// permitted (else to a higher nice level), lock the process's memory and
+// pre-fault this thread's stack, so the probe loop takes no page faults. A
+// thread that may only run on one CPU is not made real-time: busy-polling,
+// it would starve everything else there.
+LowJitterState EnterLowJitterMode(int cpu);
+
+// Undo what EnterLowJitterMode set up for the calling thread
+void LeaveLowJitterMode(const LowJitterState& state);
@@ -0,0 +1,242 @@
+#include "MultiSampler.h"
+#include "Clock.h"
+#include <algorithm>
+#include <thread>
+
+namespace {
+
+// Deadline in a loop's timer heap
+struct TimerEvent {
+    enum Kind : uint8_t { Send, Timeout };
+
+    int64_t dueNs;
+    uint32_t target;   // Index into the loop's target list
+    uint32_t sequence; // Probe to expire (Timeout only)
+    Kind kind;
+};
+
+// Most timer heap entries reserved up front for one loop (about 24 MB); a
+// larger heap grows as it fills
+const size_t MAX_TIMER_RESERVE = size_t(1) << 20;
+
+// Orders the heap so the earliest deadline is on top
+struct LaterFirst {
+    bool operator()(const TimerEvent& a, const TimerEvent& b) const {
+        return a.dueNs > b.dueNs;
+    }
+};
+
+// Per-target state owned by one event loop
+struct LoopTarget {
+    LoopTarget(TargetSeries& series) : recorder(series.store, series.shared) {}
+
+    SeriesRecorder recorder;
+    PendingProbes pending;
+    ProbeSchedule schedule;
+    ResolvedHost* host = nullptr;
+    NetAddress address;           // Address being probed
+    uint32_t hostGeneration = 0;
+    int engineTarget = 0;
+    uint32_t sequence = 0;
+};
+
+} // namespace
+
+MultiSampler::MultiSampler(ProbeEngineFactory factory)
+    : m_Factory(factory) {}
+
+// Register a host to probe
+void MultiSampler::AddTarget(const std::string& host) {
+    std::unique_ptr<TargetSeries> series(new TargetSeries());
+    series->host = host;
+    m_Targets.push_back(std::move(series));
+}
+
+// Split the targets across threadCount event loops and run them
+bool MultiSampler::Run(const SamplerConfig& config, int threadCount, const std::atomic<bool>& running) {
+    if (threadCount < 1) threadCount = 1;
+    if (static_cast<size_t>(threadCount) > m_Targets.size()) threadCount = static_cast<int>(m_Targets.size());
+
+    // Start every lookup before any loop waits on one
+    Resolver& resolver = m_Resolver ? *m_Resolver : DefaultResolver();
+    m_Hosts.clear();
+    for (const std::unique_ptr<TargetSeries>& series : m_Targets) {
+        m_Hosts.push_back(resolver.Watch(series->host));
+    }
+
+    std::vector<std::string> errors(threadCount);
+    std::vector<char> results(threadCount, 0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < threadCount; i++) {
+        threads.emplace_back([&, i]() {
+            results[i] = RunLoop(i, threadCount, config, running, errors[i]);
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    m_Hosts.clear();
+
+    for (int i = 0; i < threadCount; i++) {
+        if (!results[i]) {
+            m_LastError = errors[i];
+            return false;
+        }
+    }
+    return true;
+}
+
+// One event loop: send on schedule, expire timeouts and match replies for
+// every target it owns, all through a single engine wait
+bool MultiSampler::RunLoop(size_t first, size_t stride, const SamplerConfig& config,
+    const std::atomic<bool>& running, std::string& error) {
+    std::unique_ptr<ProbeEngine> engine = m_Factory();
+    if (!engine) {
+        error = "Backend not available on this platform";
+        return false;
+    }
+
+    ProbeOptions options;
+    options.timeoutMs = config.timeoutMs;
+    options.payloadSize = config.payloadSize;
+    options.maxInFlight = MAX_ENGINE_IN_FLIGHT;
+    if (!engine->Open(options)) {
+        error = engine->LastError();
+        return false;
+    }
+
+    int window = config.maxInFlight < 1 ? 1 : config.maxInFlight;
+    std::vector<std::unique_ptr<LoopTarget>> targets;
+    for (size_t i = first; i < m_Targets.size(); i += stride) {
+        std::unique_ptr<LoopTarget> target(new LoopTarget(*m_Targets[i]));
+        target->host = m_Hosts[i].get();
+        Resolver::Wait(*target->host, running);
+        if (!running) {
+            engine->Close();
+            return true;
+        }
+        std::vector<NetAddress> addresses;
+        std::string lookupError;
+        target->hostGeneration = target->host->Addresses(addresses, &lookupError);
+        if (addresses.empty()) {
+            error = "Could not resolve hostname: " + m_Targets[i]->host + "\nError: " + lookupError;
+            engine->Close();
+            return false;
+        }
+        target->address = addresses[0];
+        if (!engine->AddTarget(target->address, target->engineTarget)) {
+            error = engine->LastError();
+            engine->Close();
+            return false;
+        }
+        target->pending.Reset(window, ReplyHistory(config.intervalUs * 1000, config.timeoutMs, window));
+        target->recorder.SetCorrection(config.correctedLatency);
+        target->recorder.Start();
+        targets.push_back(std::move(target));
+    }
+
+    const int64_t intervalNs = config.intervalUs * 1000;
+    const int64_t timeoutNs = static_cast<int64_t>(config.timeoutMs) * 1000000;
+
+    // A timeout stays in the heap until it fires, answered or not, so each
+    // target holds one per probe sent within a timeout, plus its send.
+    // Reserved here so the loop does not allocate.
+    int64_t perInterval = intervalNs > 0 ? intervalNs : 1;
+    int64_t timeouts = (timeoutNs + perInterval - 1) / perInterval;
+    size_t perTarget = static_cast<size_t>(std::min<int64_t>(timeouts, MAX_REPLY_HISTORY)) + window + 1;
+    std::vector<TimerEvent> timers;
+    timers.reserve(std::min(targets.size() * perTarget, MAX_TIMER_RESERVE));
+
+    // Spread the first sends over one interval so the targets don't burst
+    int64_t start = MonotonicNowNs();
+    for (size_t i = 0; i < targets.size(); i++) {
+        targets[i]->schedule.Start(intervalNs, start + static_cast<int64_t>(intervalNs * (double)i / targets.size()));
+        timers.push_back({ targets[i]->schedule.DueNs(), static_cast<uint32_t>(i), 0, TimerEvent::Send });
+    }
+    std::make_heap(timers.begin(), timers.end(), LaterFirst());
+
+    // Map engine target indices back to loop targets
+    std::vector<uint32_t> byEngineTarget(targets.size());
+    for (size_t i = 0; i < targets.size(); i++) {
+        byEngineTarget[targets[i]->engineTarget] = static_cast<uint32_t>(i);
+    }
+
+    // Sends rescheduled while firing; they join the heap afterwards, so a
+    // send that is due again at once (zero interval) waits for the next pass
+    std::vector<TimerEvent> rescheduled;
+    rescheduled.reserve(targets.size());
+
+    while (running) {
+        int64_t now = MonotonicNowNs();
+
+        // Fire every deadline that is due
+        while (!timers.empty() && timers.front().dueNs <= now) {
+            std::pop_heap(timers.begin(), timers.end(), LaterFirst());
+            TimerEvent event = timers.back();
+            timers.pop_back();
+            LoopTarget& target = *targets[event.target];
+
+            if (event.kind == TimerEvent::Timeout) {
+                if (PendingProbes::Entry* probe = target.pending.Expire(event.sequence)) {
+                    target.recorder.Complete(*probe, now - probe->sendTimeNs, SampleStatus::Timeout);
+                }
+                continue;
+            }
+
+            // Send, unless this target's window is full; then skip a slot
+            if (target.pending.Count() < static_cast<size_t>(window)) {
+                NetAddress address = target.address;
+                if (target.host->Follow(address, target.hostGeneration) &&
+                    engine->SetTargetAddress(target.engineTarget, address)) {
+                    target.address = address;
+                }
+                uint32_t sequence = ++target.sequence;
+                int64_t sendTime = 0;
+                if (engine->Send(target.engineTarget, sequence, sendTime)) {
+                    target.recorder.Track(target.pending, target.recorder.Begin(sendTime, sequence, target.schedule.Sent(sendTime)));
+                    timers.push_back({ sendTime + timeoutNs, event.target, sequence, TimerEvent::Timeout });
+                    std::push_heap(timers.begin(), timers.end(), LaterFirst());
+                } else {
+                    target.recorder.Record(now, sequence, target.schedule.Sent(now), 0, SampleStatus::Unreachable);
+                }
+            } else {
+                target.schedule.Skip(now);
+            }
+            rescheduled.push_back({ target.schedule.DueNs(), event.target, 0, TimerEvent::Send });
+        }
+        for (const TimerEvent& event : rescheduled) {
+            timers.push_back(event);
+            std::push_heap(timers.begin(), timers.end(), LaterFirst());
+        }
+        rescheduled.clear();
+
+        // Wait for replies until the next deadline. A send waits as its
+        // schedule says. Timeouts need no precision, so their wait rounds up
+        // to a whole millisecond: with hundreds of targets they are often
+        // less than 1 ms apart, and each would cost a wakeup of its own.
+        int64_t wakeTime = timers.empty() ? now + 100000000 : timers.front().dueNs;
+        int64_t waitNs;
+        if (!timers.empty() && timers.front().kind == TimerEvent::Send) {
+            waitNs = targets[timers.front().target]->schedule.WaitNs(now, wakeTime);
+        } else {
+            waitNs = wakeTime > now ? (wakeTime - now + 999999) / 1000000 * 1000000 : 0;
+        }
+        if (waitNs > 100000000) waitNs = 100000000; // Notice running == false promptly
+
+        ProbeReply reply;
+        while (engine->Receive(reply, waitNs)) {
+            if (reply.target >= 0 && static_cast<size_t>(reply.target) < byEngineTarget.size()) {
+                LoopTarget& target = *targets[byEngineTarget[reply.target]];
+                target.recorder.HandleReply(target.pending, reply);
+            }
+            // Drain everything already queued, then go back to the timers
+            waitNs = 0;
+        }
+    }
+
+    for (std::unique_ptr<LoopTarget>& target : targets) {
+        target->recorder.Finish();
+    }
+    engine->Close();
+    return true;
+}
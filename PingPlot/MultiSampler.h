@@ -0,0 +1,62 @@
+#pragma once
+
+#include "Sampler.h"
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Ring capacity per target; hosts are usually probed at low rates
+const size_t MULTI_TARGET_STORE_CAPACITY = 4096;
+
+// One probed host with its own history and counters
+struct TargetSeries {
+    TargetSeries() : store(MULTI_TARGET_STORE_CAPACITY) {}
+
+    std::string host;
+    SampleStore store;
+    SamplerShared shared;
+};
+
+// Creates the engine for one event-loop thread
+typedef std::function<std::unique_ptr<ProbeEngine>()> ProbeEngineFactory;
+
+// Probes many hosts from a small, fixed number of event-loop threads. Each
+// thread owns one engine and multiplexes the sends and receives of its share
+// of the targets; per-target send and timeout deadlines live in one binary
+// heap, so the work per probe is O(log targets) and no thread is idle-waiting
+// on a single host.
+class MultiSampler {
+public:
+    explicit MultiSampler(ProbeEngineFactory factory);
+
+    // Register a host; call before Run
+    void AddTarget(const std::string& host);
+
+    // Resolve through this resolver instead of DefaultResolver()
+    void SetResolver(Resolver* resolver) { m_Resolver = resolver; }
+
+    // Probe all targets with threadCount loops until running becomes false.
+    // Every target sends once per config.intervalUs with at most
+    // config.maxInFlight probes outstanding. All hosts are resolved at once;
+    // each loop starts probing when its own hosts have answered, and targets
+    // follow address changes like Sampler does. Returns false if a host did
+    // not resolve or an engine or target could not be opened; the reason is
+    // available from LastError().
+    bool Run(const SamplerConfig& config, int threadCount, const std::atomic<bool>& running);
+
+    size_t TargetCount() const { return m_Targets.size(); }
+    TargetSeries& Target(size_t index) { return *m_Targets[index]; }
+
+    const std::string& LastError() const { return m_LastError; }
+
+private:
+    // Event loop for targets first, first + stride, first + 2 * stride, ...
+    bool RunLoop(size_t first, size_t stride, const SamplerConfig& config,
+        const std::atomic<bool>& running, std::string& error);
+
+    ProbeEngineFactory m_Factory;
+    Resolver* m_Resolver = nullptr; // nullptr = DefaultResolver()
+    std::vector<std::unique_ptr<TargetSeries>> m_Targets;
+    std::vector<std::shared_ptr<ResolvedHost>> m_Hosts; // Per target while running
+    std::string m_LastError;
+};
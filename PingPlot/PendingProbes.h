@@ -0,0 +1,176 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// How a reply relates to the probes sent so far
+enum class ReplyClass : uint8_t {
+    OnTime,    // First reply to a probe still waiting, in sequence order
+    Reordered, // First reply to a probe still waiting, after a later probe's reply
+    Late,      // First reply to a probe that already timed out
+    Duplicate, // Another reply to a probe that was already answered
+    Unknown    // Not a probe this table knows (too old, or another run's)
+};
+
+// Fewest and most finished probes kept so late replies and duplicates can
+// still be matched
+const size_t MIN_REPLY_HISTORY = 64;
+const size_t MAX_REPLY_HISTORY = 16384;
+
+// Probes to keep for a schedule: everything sent within two timeouts, which
+// covers a reply that is late by up to another timeout
+inline size_t ReplyHistory(int64_t intervalNs, int timeoutMs, int maxInFlight) {
+    size_t history = MAX_REPLY_HISTORY;
+    if (intervalNs > 0) {
+        int64_t probes = 2 * static_cast<int64_t>(timeoutMs) * 1000000 / intervalNs;
+        history = probes < static_cast<int64_t>(MAX_REPLY_HISTORY) ? static_cast<size_t>(probes) : MAX_REPLY_HISTORY;
+    }
+    if (history < MIN_REPLY_HISTORY) history = MIN_REPLY_HISTORY;
+    if (history < static_cast<size_t>(maxInFlight)) history = static_cast<size_t>(maxInFlight);
+    return history;
+}
+
+// Probes that have been sent, keyed by sequence number, and the reply matcher
+// built on them. Sequences are issued in order, so the table is a ring
+// indexed by the low bits of the sequence and timeouts expire oldest first.
+// A probe stays in the ring after it is answered or expires until its slot is
+// reused, which is what tells a late reply or a duplicate from an unknown
+// one. Nothing allocates after Reset, except Grow when the settings change.
+class PendingProbes {
+public:
+    enum State : uint8_t {
+        Free,
+        Waiting,  // Sent, no reply yet
+        Expired,  // Timed out without a reply
+        Answered
+    };
+
+    struct Entry {
+        uint32_t sequence = 0;
+        uint32_t skippedBefore = 0; // Schedule slots passed over just before it
+        int64_t sendTimeNs = 0;
+        int64_t intendedNs = 0;     // When its schedule wanted it sent
+        int64_t intervalNs = 0;     // Schedule interval; 0 = unscheduled
+        uint64_t record = 0;        // SampleStore index reserved at send
+        uint64_t windowIndex = 0;   // WindowStats entry of its result
+        State state = Free;
+    };
+
+    // Size the ring for a window of maxInFlight probes, remembering at least
+    // history probes
+    void Reset(int maxInFlight, size_t history = 0) {
+        size_t capacity = 1;
+        while (capacity < static_cast<size_t>(maxInFlight) || capacity < history) capacity <<= 1;
+        m_Entries.assign(capacity, Entry());
+        m_Mask = capacity - 1;
+        m_Oldest = 0;
+        m_Count = 0;
+        m_HighestAnswered = 0;
+        m_AnyAnswered = false;
+    }
+
+    // Remember at least history probes from now on, keeping every entry.
+    // Where two land in one slot of the larger ring the newer one stays.
+    void Grow(size_t history) {
+        if (history <= m_Entries.size()) return;
+        size_t capacity = m_Entries.size();
+        while (capacity < history) capacity <<= 1;
+        std::vector<Entry> entries(capacity);
+        for (const Entry& entry : m_Entries) {
+            if (entry.state == Free) continue;
+            Entry& slot = entries[entry.sequence & (capacity - 1)];
+            if (slot.state == Free || static_cast<int32_t>(entry.sequence - slot.sequence) > 0) slot = entry;
+        }
+        m_Entries.swap(entries);
+        m_Mask = capacity - 1;
+    }
+
+    // Probes still waiting for a reply
+    size_t Count() const { return m_Count; }
+    size_t Capacity() const { return m_Entries.size(); }
+
+    // True while the slot sequence would take still holds a probe waiting
+    // for a reply, i.e. the outstanding sequences span the whole ring
+    bool Occupied(uint32_t sequence) const {
+        const Entry& entry = m_Entries[sequence & m_Mask];
+        return entry.state == Waiting && entry.sequence != sequence;
+    }
+
+    // Register a probe that was just sent. A probe still waiting in its slot
+    // is given up on first: it is copied to displaced and true is returned,
+    // so the caller can record it as timed out.
+    bool Add(const Entry& probe, Entry& displaced) {
+        Entry& entry = m_Entries[probe.sequence & m_Mask];
+        bool overwrote = entry.state == Waiting;
+        if (overwrote) {
+            entry.state = Expired;
+            displaced = entry;
+            m_Count--;
+            Advance();
+        }
+        if (m_Count == 0) m_Oldest = probe.sequence;
+        entry = probe;
+        entry.state = Waiting;
+        m_Count++;
+        return overwrote;
+    }
+
+    // Give up on the probe with this sequence. Returns nullptr if it is not
+    // (or no longer) waiting. The entry stays valid until its slot is reused.
+    Entry* Expire(uint32_t sequence) {
+        Entry& entry = m_Entries[sequence & m_Mask];
+        if (entry.state != Waiting || entry.sequence != sequence) return nullptr;
+        entry.state = Expired;
+        m_Count--;
+        Advance();
+        return &entry;
+    }
+
+    // Classify a reply and mark its probe answered. echoedSendTimeNs is the
+    // send time the reply carried back (0 if none); a mismatch means the
+    // slot has been reused since. probe receives the matched entry unless
+    // the class is Unknown.
+    ReplyClass Match(uint32_t sequence, int64_t echoedSendTimeNs, Entry*& probe) {
+        Entry& entry = m_Entries[sequence & m_Mask];
+        if (entry.state == Free || entry.sequence != sequence) return ReplyClass::Unknown;
+        if (echoedSendTimeNs != 0 && echoedSendTimeNs != entry.sendTimeNs) return ReplyClass::Unknown;
+        probe = &entry;
+
+        if (entry.state == Answered) return ReplyClass::Duplicate;
+        if (entry.state == Expired) {
+            entry.state = Answered;
+            return ReplyClass::Late;
+        }
+
+        entry.state = Answered;
+        m_Count--;
+        Advance();
+        // Reordered when a probe sent after it was answered first
+        bool reordered = m_AnyAnswered && static_cast<int32_t>(sequence - m_HighestAnswered) < 0;
+        if (!reordered) m_HighestAnswered = sequence;
+        m_AnyAnswered = true;
+        return reordered ? ReplyClass::Reordered : ReplyClass::OnTime;
+    }
+
+    // Oldest probe still waiting, or nullptr when nothing is
+    const Entry* Oldest() const {
+        if (m_Count == 0) return nullptr;
+        return &m_Entries[m_Oldest & m_Mask];
+    }
+
+private:
+    // Skip over entries that are no longer waiting
+    void Advance() {
+        while (m_Count > 0 && m_Entries[m_Oldest & m_Mask].state != Waiting) {
+            m_Oldest++;
+        }
+    }
+
+    std::vector<Entry> m_Entries;
+    size_t m_Mask = 0;
+    uint32_t m_Oldest = 0;
+    size_t m_Count = 0;
+    uint32_t m_HighestAnswered = 0; // Newest sequence answered so far
+    bool m_AnyAnswered = false;
+};
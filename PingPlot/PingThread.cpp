@@ -1,177 +1,127 @@
 #include "PingThread.h"
 #include "GraphDrawing.h"
 
+// SamplerShared::notifySettings: put the change into the session file being
+// recorded, if any
+void RecordSettingsChange(void* /*context*/, const SamplerConfig& config, uint64_t firstIndex) {
+    SessionInfo info;
+    info.host = config.host;
+    info.intervalUs = config.intervalUs;
+    info.timeoutMs = config.timeoutMs;
+    info.payloadSize = config.payloadSize;
+    info.maxInFlight = config.maxInFlight;
+    g_SessionWriter.ChangeSettings(info, firstIndex);
+}
+
 // Function for pinging a host
 void PingThread() {
-    // Initialize Winsock (required for DNS resolution)
-    WSADATA wsaData;
-    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
-        MessageBox(g_hWnd, L"Failed to initialize Winsock", L"Error", MB_ICONERROR);
-        g_ThreadRunning = false;
-        return;
-    }
-
-    // Open ICMP handle
-    HANDLE hIcmp = IcmpCreateFile();
-    if (hIcmp == INVALID_HANDLE_VALUE) {
-        MessageBox(g_hWnd, L"Failed to create ICMP handle", L"Error", MB_ICONERROR);
-        WSACleanup();
-        g_ThreadRunning = false;
-        return;
-    }
-
     // Convert wide string to narrow string
     char hostBuffer[256];
     WideCharToMultiByte(CP_ACP, 0, g_HostToPing.c_str(), -1, hostBuffer, sizeof(hostBuffer), NULL, NULL);
+
+    SamplerConfig config;
+    config.host = hostBuffer;
+    config.intervalUs = g_PingIntervalUs;
+    config.maxInFlight = g_MaxInFlight;
+    config.lowJitter = g_LowJitter;
     
-    // Try to convert string as IP address first
-    IN_ADDR addr;
-    BOOL isIpAddress = (InetPton(AF_INET, g_HostToPing.c_str(), &addr) == 1);
-    
-    // If not a valid IP, try to resolve as hostname
-    if (!isIpAddress) {
-        struct addrinfo hints = {0};
-        struct addrinfo* result = NULL;
-        
-        hints.ai_family = AF_INET; // IPv4
-        hints.ai_socktype = SOCK_STREAM;
-        hints.ai_protocol = IPPROTO_TCP;
-        
-        // Use getaddrinfo to resolve the hostname
-        int res = getaddrinfo(hostBuffer, NULL, &hints, &result);
-        
-        if (res != 0 || !result) {
-            // Get the specific error message
-            WCHAR errorMsg[256];
-            swprintf_s(errorMsg, L"Could not resolve hostname: %S\nError: %d", hostBuffer, res);
-            MessageBox(g_hWnd, errorMsg, L"Error", MB_ICONERROR);
-            IcmpCloseHandle(hIcmp);
-            WSACleanup();
-            g_ThreadRunning = false;
-            return;
-        }
-        
-        // Get the IP address from the first result
-        struct sockaddr_in* sockaddr_ipv4 = (struct sockaddr_in*)result->ai_addr;
-        addr = sockaddr_ipv4->sin_addr;
-        
-        // Free the address info
-        freeaddrinfo(result);
-    }
-    
-    // Prepare for ping
-    char replyBuffer[sizeof(ICMP_ECHO_REPLY) + 32];
-    unsigned long replySize = sizeof(replyBuffer);
-    char sendData[32] = "PingPlotData";
+    // Adaptive: the interval is the target rate (0 = as fast as allowed) and
+    // the in-flight window the deepest pipelining, unless left at 1
+    config.adaptiveRate = g_AdaptiveRate;
+    if (g_AdaptiveRate && g_MaxInFlight == 1) config.maxInFlight = RATE_CONTROL_DEFAULT_MAX_IN_FLIGHT;
+
+    // Probe with the platform's default backend
+    std::unique_ptr<ProbeEngine> engine = CreateProbeEngine(ProbeBackend::Default);
+    Sampler sampler(*engine, g_SampleStore, g_SamplerShared);
+    sampler.SetHistory(&g_TieredHistory);
+    sampler.SetResolver(&g_Resolver);
+    sampler.SetCommands(&g_SamplerCommands);
     
-    // Initialize PPS tracking time
-    g_LastPPSUpdateTime = std::chrono::steady_clock::now();
-    g_LastPPSCount = g_TotalPings.load();
+    // Measure the tool's own overhead against loopback before probing and
+    // again every few minutes; a failure only leaves the overhead unknown
+    ProbeOptions calibrationOptions;
+    calibrationOptions.busyPoll = g_LowJitter;
+    g_Calibrator.Start(ProbeBackend::Default, calibrationOptions, GUI_CALIBRATION_PERIOD_SECONDS);
     
-    // Ping loop
-    while (g_Running) {
-        // Use high-resolution timer for more precise measurements
-        auto startTime = std::chrono::high_resolution_clock::now();
-        
-        // Send ping using the address
-        DWORD result = IcmpSendEcho(hIcmp, addr.S_un.S_addr, 
-            sendData, sizeof(sendData), NULL, replyBuffer, replySize, DEFAULT_PING_TIMEOUT_MS);
-        
-        auto endTime = std::chrono::high_resolution_clock::now();
-        
-        // Increment ping counter regardless of success
-        g_TotalPings++;
-        
-        // Calculate pings per second every 1 second
-        auto now = std::chrono::steady_clock::now();
-        auto timeSinceLastUpdate = std::chrono::duration_cast<std::chrono::milliseconds>(now - g_LastPPSUpdateTime).count();
-        if (timeSinceLastUpdate >= 1000) {  // Update PPS once per second
-            unsigned long long currentCount = g_TotalPings.load();
-            unsigned long long countDifference = currentCount - g_LastPPSCount;
-            double secondsElapsed = timeSinceLastUpdate / 1000.0;
-            
-            g_PingsPerSecond = countDifference / secondsElapsed;
-            
-            // Update dynamic data points to use configurable history seconds
-            int newDataPoints = static_cast<int>(g_PingsPerSecond * g_HistorySeconds);
-            // Ensure we have at least some minimum number of data points
-            if (newDataPoints < 100) newDataPoints = 100;
-            // Cap it to prevent excessive memory usage
-            if (newDataPoints > 10000) newDataPoints = 10000;
-            g_DynamicDataPoints = newDataPoints;
-            
-            g_LastPPSUpdateTime = now;
-            g_LastPPSCount = currentCount;
-        }
-        
-        if (result > 0) {
-            // Use our own high-precision timing instead of the API's integer milliseconds
-            double pingTime = std::chrono::duration<double, std::milli>(endTime - startTime).count();
-            
-            // Save the ping time
-            {
-                std::lock_guard<std::mutex> lock(g_PingDataMutex);
-                g_PingTimes.push_back(pingTime);
-                if (g_PingTimes.size() > g_DynamicDataPoints) {
-                    g_PingTimes.pop_front();
-                }
-            }
-            
-            // Just mark that we have new data, don't request redraw here
-            g_DataUpdated = true;
-        } else {
-            // Ping failed, store timeout value
-            std::lock_guard<std::mutex> lock(g_PingDataMutex);
-            g_PingTimes.push_back(DEFAULT_PING_TIMEOUT_MS);
-            if (g_PingTimes.size() > g_DynamicDataPoints) {
-                g_PingTimes.pop_front();
-            }
-            
-            // Just mark that we have new data, don't request redraw here
-            g_DataUpdated = true;
-        }
-        
-        // Calculate sleep time to maintain ping interval
-        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime);
-        int sleepTime = g_PingInterval - (int)elapsed.count();
-        
-        if (sleepTime > 0) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(sleepTime));
-        }
+    if (!sampler.Run(config, g_Running)) {
+        WCHAR errorMsg[512];
+        swprintf_s(errorMsg, L"%S", sampler.LastError().c_str());
+        MessageBox(g_hWnd, errorMsg, L"Error", MB_ICONERROR);
     }
-    
-    // Clean up
-    IcmpCloseHandle(hIcmp);
-    WSACleanup();
+    g_Calibrator.Stop();
+
     g_ThreadRunning = false; // Mark thread as finished
 }
 
+// Start writing g_SampleStore to PingPlot-<host>-<date>-<time>.pps in the
+// working directory
+void StartRecording() {
+    char hostBuffer[256];
+    WideCharToMultiByte(CP_ACP, 0, g_HostToPing.c_str(), -1, hostBuffer, sizeof(hostBuffer), NULL, NULL);
+
+    // Keep the host part of the name to characters every file system takes
+    std::string safeHost = hostBuffer;
+    for (char& c : safeHost) {
+        if (!isalnum((unsigned char)c) && c != '.' && c != '-') c = '_';
+    }
+    SYSTEMTIME now;
+    GetLocalTime(&now);
+    char path[320];
+    sprintf_s(path, "PingPlot-%s-%04d%02d%02d-%02d%02d%02d.pps", safeHost.c_str(),
+        now.wYear, now.wMonth, now.wDay, now.wHour, now.wMinute, now.wSecond);
+
+    SessionInfo info;
+    info.host = hostBuffer;
+    info.intervalUs = g_PingIntervalUs;
+    info.timeoutMs = DEFAULT_PING_TIMEOUT_MS;
+    info.maxInFlight = g_MaxInFlight;
+    info.payloadSize = SamplerConfig().payloadSize; // The probe thread sends the default payload
+    if (!g_SessionWriter.Start(path, info, g_SampleStore)) {
+        WCHAR errorMsg[512];
+        swprintf_s(errorMsg, L"%S", g_SessionWriter.LastError().c_str());
+        MessageBox(g_hWnd, errorMsg, L"Error", MB_ICONERROR);
+    }
+}
+
 // Function to start pinging
 void StartPinging() {
     // Make sure any previous thread is completely stopped
     StopPinging();
     
+    // Live data replaces a replayed session
+    if (g_ReplaySession.IsOpen()) {
+        g_ReplaySession.Close();
+        SetWindowText(g_hBtnReplay, L"Replay...");
+        InvalidateReplay();
+    }
+    
     // Get host from edit box
     WCHAR hostBuffer[256];
     GetWindowText(g_hEditHost, hostBuffer, 256);
     g_HostToPing = hostBuffer;
     
     // Clear previous data
-    {
-        std::lock_guard<std::mutex> lock(g_PingDataMutex);
-        g_PingTimes.clear();
-    }
+    g_SampleStore.Clear();
+    g_GraphDecimator.Reset();
+    g_TieredHistory.Clear();
     
     // Reset ping counter
-    g_TotalPings = 0;
-    g_PingsPerSecond = 0.0;
+    g_SamplerShared.Reset();
+    g_SamplerShared.historySeconds = g_HistorySeconds;
     
-    // Set up UI update timer if it's not already running
-    if (g_UITimer == 0) {
-        g_UITimer = SetTimer(g_hWnd, 1, UI_UPDATE_INTERVAL_MS, UIUpdateTimerProc);
+    if (g_Recording) {
+        StartRecording();
     }
     
-    // Start pinging thread
+    // The probe thread wakes the UI when it has something new to draw
+    g_SamplerShared.notifyUpdate = NotifyDataUpdated;
+    g_SamplerShared.notifyContext = g_hWnd;
+    
+    // Interval changes made while recording go into the session file
+    g_SamplerShared.notifySettings = RecordSettingsChange;
+    
+    // Start pinging thread; settings queued for an earlier run are in its config
+    g_SamplerCommands.Clear();
     g_Running = true;
     g_ThreadRunning = true;
     g_PingThreadHandle = std::thread(PingThread);
@@ -187,11 +137,8 @@ void StopPinging() {
         g_PingThreadHandle.join();
     }
     
-    // Kill the UI update timer
-    if (g_UITimer != 0) {
-        KillTimer(g_hWnd, g_UITimer);
-        g_UITimer = 0;
-    }
+    // Flush what the run recorded; a frame still pending draws the last data
+    g_SessionWriter.Stop();
 }
 
 // Function to update the ping frequency
@@ -199,20 +146,36 @@ void UpdatePingFrequency() {
     WCHAR buffer[16];
     GetWindowText(g_hEditFrequency, buffer, 16);
     
-    int newInterval = _wtoi(buffer);
+    // Milliseconds, down to the microsecond (0.5 = 2000 pings per second)
+    double newInterval = _wtof(buffer);
     
     // Validate input - ensure it's between 0ms and 10000ms
-    if (newInterval >= 0 && newInterval <= 10000) {
-        g_PingInterval = newInterval;
+    if (newInterval >= 0.0 && newInterval <= 10000.0) {
+        g_PingIntervalUs = static_cast<int64_t>(newInterval * 1000.0 + 0.5);
         
         // Update the edit box in case the value was changed due to validation
-        swprintf_s(buffer, L"%d", g_PingInterval);
+        swprintf_s(buffer, L"%g", g_PingIntervalUs / 1000.0);
         SetWindowText(g_hEditFrequency, buffer);
     } else {
         // Reset to current value if invalid
-        swprintf_s(buffer, L"%d", g_PingInterval);
+        swprintf_s(buffer, L"%g", g_PingIntervalUs / 1000.0);
         SetWindowText(g_hEditFrequency, buffer);
         MessageBox(g_hWnd, L"Please enter a value between 0ms and 10000 ms", 
             L"Invalid Input", MB_ICONWARNING);
     }
+
+    // In-flight window, capped by what the ICMP backend can wait on
+    GetWindowText(g_hEditInFlight, buffer, 16);
+    int newInFlight = _wtoi(buffer);
+    if (newInFlight >= 1 && newInFlight <= MAX_ENGINE_IN_FLIGHT) {
+        g_MaxInFlight = newInFlight;
+        swprintf_s(buffer, L"%d", g_MaxInFlight);
+        SetWindowText(g_hEditInFlight, buffer);
+    } else {
+        swprintf_s(buffer, L"%d", g_MaxInFlight);
+        SetWindowText(g_hEditInFlight, buffer);
+        WCHAR message[96];
+        swprintf_s(message, L"Please enter an in-flight window between 1 and %d", MAX_ENGINE_IN_FLIGHT);
+        MessageBox(g_hWnd, message, L"Invalid Input", MB_ICONWARNING);
+    }
 }
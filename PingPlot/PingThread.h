@@ -11,5 +11,8 @@ void StartPinging();
 // Stop pinging
 void StopPinging();
 
-// Update ping frequency
+// Start writing the current run to a new session file
+void StartRecording();
+
+// Update ping frequency and in-flight window
 void UpdatePingFrequency();
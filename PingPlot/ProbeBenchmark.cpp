@@ -0,0 +1,433 @@
+// Throughput and overhead benchmark for the probe loops. Runs the blocking
+// and pipelined Sampler loops and the MultiSampler event loop flat out
+// (no interval) against a zero-latency simulated responder and against
+// loopback, each with and without a reader polling the sample store the
+// whole time. For every run it reports the sustained probes per second,
+// CPU time per probe, the RTTs measured (with a zero-latency responder
+// these are pure timestamp, engine and wakeup overhead) and how many
+// records the reader lost to the writer. Two calibration rows give the
+// cost of one clock read and the wakeup overshoot of a short sleep.
+
+#include "Clock.h"
+#include "MultiSampler.h"
+#include "Sampler.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+namespace {
+
+const double DEFAULT_DURATION_SECONDS = 2.0;
+const int DEFAULT_IN_FLIGHT = 64;
+const int DEFAULT_TARGETS = 16;
+const int CLOCK_READS = 1000000;
+const int WAKEUP_SLEEPS = 200;
+const int WAKEUP_SLEEP_US = 100;
+
+// CPU time used so far by the whole process / the calling thread
+int64_t ProcessCpuNs() {
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return static_cast<int64_t>(k.QuadPart + u.QuadPart) * 100;
+#else
+    timespec now;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+#endif
+}
+
+int64_t ThreadCpuNs() {
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user);
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return static_cast<int64_t>(k.QuadPart + u.QuadPart) * 100;
+#else
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+#endif
+}
+
+enum class Mode { Blocking, Pipelined, MultiTarget };
+
+const char* ModeName(Mode mode) {
+    switch (mode) {
+        case Mode::Blocking: return "blocking";
+        case Mode::Pipelined: return "pipelined";
+        case Mode::MultiTarget: return "multi";
+    }
+    return "?";
+}
+
+enum class Responder { Simulated, Loopback };
+
+const char* ResponderName(Responder responder) {
+    return responder == Responder::Simulated ? "sim" : "loopback";
+}
+
+enum class OutputFormat { Table, Csv, JsonLines };
+
+struct BenchOptions {
+    double durationSeconds = DEFAULT_DURATION_SECONDS;
+    int inFlight = DEFAULT_IN_FLIGHT;
+    int targets = DEFAULT_TARGETS;
+    int threads = 1;
+    OutputFormat format = OutputFormat::Table;
+};
+
+struct RunResult {
+    std::string mode;
+    std::string responder;
+    bool reader = false;
+    uint64_t probes = 0;
+    double probesPerSecond = 0.0;
+    double cpuNsPerProbe = 0.0;  // Probe threads only; the reader is not counted
+    double rttP50Us = 0.0;
+    double rttP99Us = 0.0;
+    uint64_t readerRecords = 0;  // Records the reader copied
+    uint64_t readerSkipped = 0;  // Records overwritten before the reader got to them
+};
+
+// Polls the stores as fast as it can, like a GUI or exporter that never
+// sleeps, to show what a reader costs the writer
+class StoreReader {
+public:
+    explicit StoreReader(std::vector<const SampleStore*> stores) : m_Stores(stores) {}
+
+    void Start() {
+        m_Running = true;
+        m_Thread = std::thread([this]() {
+            int64_t cpuStart = ThreadCpuNs();
+            std::vector<uint64_t> cursors(m_Stores.size());
+            for (size_t i = 0; i < m_Stores.size(); i++) {
+                cursors[i] = m_Stores[i]->Head();
+            }
+            SampleColumns columns;
+            while (m_Running) {
+                for (size_t i = 0; i < m_Stores.size(); i++) {
+                    m_Skipped += m_Stores[i]->ReadFrom(cursors[i], columns, COLUMN_ALL);
+                    m_Records += columns.Size();
+                }
+                std::this_thread::yield();
+            }
+            m_CpuNs = ThreadCpuNs() - cpuStart;
+        });
+    }
+
+    void Stop() {
+        if (!m_Thread.joinable()) return;
+        m_Running = false;
+        m_Thread.join();
+    }
+
+    uint64_t Records() const { return m_Records; }
+    uint64_t Skipped() const { return m_Skipped; }
+    int64_t CpuNs() const { return m_CpuNs; }
+
+private:
+    std::vector<const SampleStore*> m_Stores;
+    std::thread m_Thread;
+    std::atomic<bool> m_Running{false};
+    uint64_t m_Records = 0;
+    uint64_t m_Skipped = 0;
+    int64_t m_CpuNs = 0;
+};
+
+std::unique_ptr<ProbeEngine> CreateEngine(Responder responder) {
+    if (responder == Responder::Loopback) return CreateProbeEngine(ProbeBackend::Default);
+    return CreateSimulatedEngine(SimulatedResponderConfig());
+}
+
+// Answered RTTs still in the stores, in microseconds, sorted
+void CollectRtts(const std::vector<const SampleStore*>& stores, RunResult& result) {
+    std::vector<int64_t> rtts;
+    SampleColumns columns;
+    for (const SampleStore* store : stores) {
+        store->Snapshot(columns, COLUMN_RTT | COLUMN_STATUS);
+        for (size_t i = 0; i < columns.Size(); i++) {
+            if (columns.status[i] == SampleStatus::Ok) rtts.push_back(columns.rttNs[i]);
+        }
+    }
+    if (rtts.empty()) return;
+    std::sort(rtts.begin(), rtts.end());
+    result.rttP50Us = rtts[(rtts.size() - 1) / 2] / 1e3;
+    result.rttP99Us = rtts[(rtts.size() - 1) * 99 / 100] / 1e3;
+}
+
+// Probe for the configured duration; false (with error set) if the engine
+// could not be opened
+bool RunProbes(Mode mode, Responder responder, bool withReader, const BenchOptions& options,
+    RunResult& result, std::string& error) {
+    SamplerConfig config;
+    config.intervalUs = 0;
+    config.timeoutMs = DEFAULT_PING_TIMEOUT_MS;
+    config.maxInFlight = mode == Mode::Blocking ? 1 : options.inFlight;
+
+    std::atomic<bool> running(true);
+    bool opened = true;
+    std::vector<const SampleStore*> stores;
+    std::vector<SamplerShared*> shareds;
+
+    // Each mode keeps its own series; the probe thread runs until stopped
+    SampleStore store;
+    SamplerShared shared;
+    std::unique_ptr<ProbeEngine> engine;
+    std::unique_ptr<Sampler> sampler;
+    std::unique_ptr<MultiSampler> multi;
+    std::thread probeThread;
+    if (mode == Mode::MultiTarget) {
+        multi.reset(new MultiSampler([responder]() { return CreateEngine(responder); }));
+        for (int i = 0; i < options.targets; i++) {
+            // Loopback answers all of 127/8, so every target is its own host.
+            // Numeric addresses keep DNS out of the measurement.
+            int host = i + 1;
+            multi->AddTarget("127." + std::to_string((host >> 16) & 0xFF) + "." + std::to_string((host >> 8) & 0xFF) +
+                "." + std::to_string(host & 0xFF));
+        }
+        for (size_t i = 0; i < multi->TargetCount(); i++) {
+            stores.push_back(&multi->Target(i).store);
+            shareds.push_back(&multi->Target(i).shared);
+        }
+    } else {
+        engine = CreateEngine(responder);
+        if (!engine) {
+            error = "Backend not available on this platform";
+            return false;
+        }
+        config.host = "127.0.0.1";
+        sampler.reset(new Sampler(*engine, store, shared));
+        stores.push_back(&store);
+        shareds.push_back(&shared);
+    }
+
+    StoreReader reader(stores);
+    if (withReader) reader.Start();
+
+    int64_t cpuStart = ProcessCpuNs();
+    int64_t start = MonotonicNowNs();
+    probeThread = std::thread([&]() {
+        if (multi) {
+            opened = multi->Run(config, options.threads, running);
+        } else {
+            opened = sampler->Run(config, running);
+        }
+        running = false;
+    });
+    std::this_thread::sleep_for(std::chrono::duration<double>(options.durationSeconds));
+    running = false;
+    probeThread.join();
+    int64_t elapsedNs = MonotonicNowNs() - start;
+    reader.Stop();
+    int64_t cpuNs = ProcessCpuNs() - cpuStart - reader.CpuNs();
+
+    if (!opened) {
+        error = multi ? multi->LastError() : sampler->LastError();
+        return false;
+    }
+
+    result.mode = ModeName(mode);
+    result.responder = ResponderName(responder);
+    result.reader = withReader;
+    for (SamplerShared* series : shareds) {
+        result.probes += series->totalPings.load();
+    }
+    result.probesPerSecond = result.probes * 1e9 / elapsedNs;
+    result.cpuNsPerProbe = result.probes ? static_cast<double>(cpuNs) / result.probes : 0.0;
+    result.readerRecords = reader.Records();
+    result.readerSkipped = reader.Skipped();
+    CollectRtts(stores, result);
+    return true;
+}
+
+// Cost of one MonotonicNowNs() call, in microseconds
+RunResult MeasureClockRead() {
+    RunResult result;
+    result.mode = "clock-read";
+    result.responder = "-";
+    int64_t sink = 0;
+    int64_t start = MonotonicNowNs();
+    for (int i = 0; i < CLOCK_READS; i++) {
+        sink += MonotonicNowNs();
+    }
+    int64_t elapsedNs = MonotonicNowNs() - start;
+    result.probes = sink == 0 ? 0 : CLOCK_READS;
+    result.rttP50Us = result.rttP99Us = elapsedNs / 1e3 / CLOCK_READS;
+    return result;
+}
+
+// How much later than asked a short sleep returns, in microseconds
+RunResult MeasureWakeup() {
+    RunResult result;
+    result.mode = "sleep-wakeup";
+    result.responder = "-";
+    std::vector<int64_t> overshoot;
+    for (int i = 0; i < WAKEUP_SLEEPS; i++) {
+        int64_t start = MonotonicNowNs();
+        std::this_thread::sleep_for(std::chrono::microseconds(WAKEUP_SLEEP_US));
+        overshoot.push_back(MonotonicNowNs() - start - WAKEUP_SLEEP_US * 1000);
+    }
+    std::sort(overshoot.begin(), overshoot.end());
+    result.probes = WAKEUP_SLEEPS;
+    result.rttP50Us = overshoot[(overshoot.size() - 1) / 2] / 1e3;
+    result.rttP99Us = overshoot[(overshoot.size() - 1) * 99 / 100] / 1e3;
+    return result;
+}
+
+void PrintHeader(OutputFormat format) {
+    if (format == OutputFormat::Table) {
+        printf("%-12s %-9s %-6s %10s %12s %12s %10s %10s %12s %10s\n", "mode", "responder", "reader", "probes",
+            "probes/s", "cpu ns/probe", "rtt p50 us", "rtt p99 us", "reader recs", "skipped");
+    } else if (format == OutputFormat::Csv) {
+        printf("mode,responder,reader,probes,probes_per_second,cpu_ns_per_probe,rtt_p50_us,rtt_p99_us,"
+            "reader_records,reader_skipped\n");
+    }
+}
+
+void PrintRow(OutputFormat format, const RunResult& row) {
+    unsigned long long probes = row.probes;
+    unsigned long long records = row.readerRecords;
+    unsigned long long skipped = row.readerSkipped;
+    const char* reader = row.reader ? "on" : "off";
+    switch (format) {
+        case OutputFormat::Table:
+            printf("%-12s %-9s %-6s %10llu %12.0f %12.0f %10.3f %10.3f %12llu %10llu\n", row.mode.c_str(),
+                row.responder.c_str(), reader, probes, row.probesPerSecond, row.cpuNsPerProbe, row.rttP50Us,
+                row.rttP99Us, records, skipped);
+            break;
+        case OutputFormat::Csv:
+            printf("%s,%s,%s,%llu,%.1f,%.1f,%.3f,%.3f,%llu,%llu\n", row.mode.c_str(), row.responder.c_str(), reader,
+                probes, row.probesPerSecond, row.cpuNsPerProbe, row.rttP50Us, row.rttP99Us, records, skipped);
+            break;
+        case OutputFormat::JsonLines:
+            printf("{\"mode\":\"%s\",\"responder\":\"%s\",\"reader\":\"%s\",\"probes\":%llu,\"probes_per_second\":%.1f,"
+                "\"cpu_ns_per_probe\":%.1f,\"rtt_p50_us\":%.3f,\"rtt_p99_us\":%.3f,\"reader_records\":%llu,"
+                "\"reader_skipped\":%llu}\n",
+                row.mode.c_str(), row.responder.c_str(), reader, probes, row.probesPerSecond, row.cpuNsPerProbe,
+                row.rttP50Us, row.rttP99Us, records, skipped);
+            break;
+    }
+    fflush(stdout);
+}
+
+void PrintUsage() {
+    fprintf(stderr,
+        "Usage: pingplot-probe-bench [options]\n"
+        "  --duration <s>              Length of each run (default: %.0f)\n"
+        "  --responders <sim,loopback> Responders to probe (default: sim,loopback)\n"
+        "  --modes <blocking,pipelined,multi>  Probe loops to run (default: all)\n"
+        "  --inflight <n>              Probes outstanding in pipelined and multi runs (default: %d)\n"
+        "  --targets <n>               Hosts in multi runs (default: %d)\n"
+        "  --threads <n>               Event-loop threads in multi runs (default: 1)\n"
+        "  --format <table|csv|jsonl>  Output format (default: table)\n"
+        "Rows clock-read and sleep-wakeup carry their overhead in the rtt columns\n",
+        DEFAULT_DURATION_SECONDS, DEFAULT_IN_FLIGHT, DEFAULT_TARGETS);
+}
+
+// Comma-separated names; each must be one of `names`
+bool ParseNames(const std::string& list, const std::vector<std::string>& names, std::vector<int>& selected) {
+    selected.clear();
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t comma = list.find(',', start);
+        if (comma == std::string::npos) comma = list.size();
+        auto found = std::find(names.begin(), names.end(), list.substr(start, comma - start));
+        if (found == names.end()) return false;
+        selected.push_back(static_cast<int>(found - names.begin()));
+        start = comma + 1;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    std::vector<int> responders = { 0, 1 };
+    std::vector<int> modes = { 0, 1, 2 };
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        bool hasValue = (i + 1 < argc);
+        bool ok = hasValue;
+        if (strcmp(arg, "--duration") == 0 && hasValue) {
+            options.durationSeconds = atof(argv[++i]);
+            ok = options.durationSeconds > 0;
+        } else if (strcmp(arg, "--responders") == 0 && hasValue) {
+            ok = ParseNames(argv[++i], { "sim", "loopback" }, responders);
+        } else if (strcmp(arg, "--modes") == 0 && hasValue) {
+            ok = ParseNames(argv[++i], { "blocking", "pipelined", "multi" }, modes);
+        } else if (strcmp(arg, "--inflight") == 0 && hasValue) {
+            options.inFlight = atoi(argv[++i]);
+            ok = options.inFlight > 1;
+        } else if (strcmp(arg, "--targets") == 0 && hasValue) {
+            options.targets = atoi(argv[++i]);
+            ok = options.targets > 0;
+        } else if (strcmp(arg, "--threads") == 0 && hasValue) {
+            options.threads = atoi(argv[++i]);
+            ok = options.threads > 0;
+        } else if (strcmp(arg, "--format") == 0 && hasValue) {
+            const char* name = argv[++i];
+            if (strcmp(name, "table") == 0) {
+                options.format = OutputFormat::Table;
+            } else if (strcmp(name, "csv") == 0) {
+                options.format = OutputFormat::Csv;
+            } else if (strcmp(name, "jsonl") == 0) {
+                options.format = OutputFormat::JsonLines;
+            } else {
+                ok = false;
+            }
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            PrintUsage();
+            return 2;
+        }
+    }
+
+    PrintHeader(options.format);
+    PrintRow(options.format, MeasureClockRead());
+    PrintRow(options.format, MeasureWakeup());
+
+    int failures = 0;
+    for (int responder : responders) {
+        for (int mode : modes) {
+            for (int withReader = 0; withReader < 2; withReader++) {
+                RunResult result;
+                std::string error;
+                if (!RunProbes(static_cast<Mode>(mode), static_cast<Responder>(responder), withReader != 0, options,
+                    result, error)) {
+                    fprintf(stderr, "%s %s: %s\n", ModeName(static_cast<Mode>(mode)),
+                        ResponderName(static_cast<Responder>(responder)), error.c_str());
+                    failures++;
+                    break;
+                }
+                PrintRow(options.format, result);
+            }
+        }
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,77 @@
+#include "ProbeEngine.h"
+#include <cstring>
+#include <random>
+
+// Backend constructors live next to their implementations
+#ifdef _WIN32
+std::unique_ptr<ProbeEngine> CreateIcmpApiEngine();
+#else
+std::unique_ptr<ProbeEngine> CreateSocketEngine();
+#endif
+
+// Create an engine for the requested backend
+std::unique_ptr<ProbeEngine> CreateProbeEngine(ProbeBackend backend) {
+    switch (backend) {
+        case ProbeBackend::Default:
+#ifdef _WIN32
+            return CreateIcmpApiEngine();
+#else
+            return CreateSocketEngine();
+#endif
+
+        case ProbeBackend::IcmpApi:
+#ifdef _WIN32
+            return CreateIcmpApiEngine();
+#else
+            return nullptr;
+#endif
+
+        case ProbeBackend::DatagramSocket:
+#ifdef _WIN32
+            return nullptr;
+#else
+            return CreateSocketEngine();
+#endif
+
+        case ProbeBackend::Simulated:
+            return CreateSimulatedEngine(SimulatedResponderConfig());
+    }
+    return nullptr;
+}
+
+// Parse a backend name from the command line
+bool ParseProbeBackend(const std::string& name, ProbeBackend& backend) {
+    if (name == "default") {
+        backend = ProbeBackend::Default;
+    } else if (name == "icmpapi") {
+        backend = ProbeBackend::IcmpApi;
+    } else if (name == "socket") {
+        backend = ProbeBackend::DatagramSocket;
+    } else if (name == "sim") {
+        backend = ProbeBackend::Simulated;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+uint32_t NewProbeRunId() {
+    std::random_device device;
+    return device() ^ static_cast<uint32_t>(MonotonicNowNs());
+}
+
+void WriteProbePayload(uint8_t* payload, size_t length, uint32_t runId, uint32_t sequence, int64_t sendTimeNs) {
+    if (length < sizeof(ProbePayload)) return;
+    ProbePayload header = { PROBE_PAYLOAD_MAGIC, runId, sequence, 0, sendTimeNs };
+    memcpy(payload, &header, sizeof(header));
+}
+
+bool ReadProbePayload(const uint8_t* payload, size_t length, uint32_t runId, uint32_t& sequence, int64_t& sendTimeNs) {
+    if (length < sizeof(ProbePayload)) return false;
+    ProbePayload header;
+    memcpy(&header, payload, sizeof(header));
+    if (header.magic != PROBE_PAYLOAD_MAGIC || header.runId != runId) return false;
+    sequence = header.sequence;
+    sendTimeNs = header.sendTimeNs;
+    return true;
+}
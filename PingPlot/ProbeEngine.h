@@ -0,0 +1,152 @@
+#pragma once
+
+#include "Clock.h"
+#include "Resolver.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Outcome of a single probe
+enum class ProbeStatus : uint8_t {
+    Ok,
+    Timeout,
+    Unreachable
+};
+
+// Options passed to an engine when a target is opened
+struct ProbeOptions {
+    int timeoutMs = 1000;   // How long a reply may take before the probe counts as lost
+    int payloadSize = 32;   // Bytes of echo payload after the ICMP header
+    int maxInFlight = 1;    // Probes that may be outstanding at once (1 = send after reply)
+    bool busyPoll = false;  // Receive is polled with a zero timeout; let the OS poll the device too
+};
+
+// Largest echo payload an engine accepts (fits an IPv4 datagram)
+const int MAX_PAYLOAD_SIZE = 65000;
+
+// A reply collected from an engine
+struct ProbeReply {
+    int target = 0;            // Index returned by AddTarget
+    uint32_t sequence = 0;
+    ProbeStatus status = ProbeStatus::Ok;
+    int64_t receiveTimeNs = 0; // Arrival time on the MonotonicNowNs() clock
+    TimestampSource timestampSource = TimestampSource::Application; // Who took receiveTimeNs
+    int64_t echoedSendTimeNs = 0; // Send time carried back in the payload; 0 if the reply had none
+};
+
+// Start of the echo payload of every probe. It names the run and the probe
+// and carries the send time, so a reply is tied to its probe by content even
+// where the ICMP header's 16-bit identifier is rewritten (datagram sockets)
+// or its 16-bit sequence has wrapped. Filler follows up to the payload size.
+// Only this process reads it back, so fields are in host byte order.
+struct ProbePayload {
+    uint32_t magic;     // PROBE_PAYLOAD_MAGIC
+    uint32_t runId;     // Drawn by the engine at Open
+    uint32_t sequence;  // Full probe sequence; the ICMP header carries its low 16 bits
+    uint32_t reserved;
+    int64_t sendTimeNs; // MonotonicNowNs() at send
+};
+
+const uint32_t PROBE_PAYLOAD_MAGIC = 0x50504C54; // "PPLT"
+
+// Random identifier for the probes of one engine
+uint32_t NewProbeRunId();
+
+// Write the payload header at the start of payload if it fits
+void WriteProbePayload(uint8_t* payload, size_t length, uint32_t runId, uint32_t sequence, int64_t sendTimeNs);
+
+// Read a payload header back. Returns false if there is none or it belongs
+// to another run.
+bool ReadProbePayload(const uint8_t* payload, size_t length, uint32_t runId, uint32_t& sequence, int64_t& sendTimeNs);
+
+// Widen a 16-bit ICMP sequence to the full sequence closest to, and not
+// after, the newest one sent
+inline uint32_t ExtendSequence(uint32_t newest, uint16_t low) {
+    return newest - static_cast<uint16_t>(static_cast<uint16_t>(newest) - low);
+}
+
+// Interface every probing backend implements. An engine is used from a
+// single thread: Open, AddTarget for every address, then any number of
+// Send/Receive, then Close. All targets share one wait, so a single thread
+// can multiplex many hosts. Names are resolved beforehand (see Resolver);
+// SetTargetAddress moves a target to a new address between probes. With
+// maxInFlight > 1 Send must not wait for the reply; replies may then arrive
+// in any order and are matched by target and sequence number. Sequences are
+// 32-bit and increase by one per probe; the engine carries them in the probe
+// payload.
+class ProbeEngine {
+public:
+    virtual ~ProbeEngine() = default;
+
+    // Prepare the engine (sockets, handles) with the given options
+    virtual bool Open(const ProbeOptions& options) = 0;
+
+    // Register an IPv4 or IPv6 address. target receives its index.
+    virtual bool AddTarget(const NetAddress& address, int& target) = 0;
+
+    // Probe a target at a different address from now on. Replies still
+    // coming from the old one are no longer attributed to it.
+    virtual bool SetTargetAddress(int target, const NetAddress& address) = 0;
+
+    // Take a new timeout and payload size from the next Send on, without
+    // reopening; probes already sent keep theirs. The other options keep
+    // their Open values.
+    virtual bool SetOptions(const ProbeOptions& options) = 0;
+
+    // Send one echo request. sendTimeNs receives the timestamp taken at send.
+    virtual bool Send(int target, uint32_t sequence, int64_t& sendTimeNs) = 0;
+
+    // Wait up to timeoutNs for a reply from any target. Returns false if
+    // nothing arrived. Backends honour the timeout as finely as the OS lets
+    // them.
+    virtual bool Receive(ProbeReply& reply, int64_t timeoutNs) = 0;
+
+    // Release all targets and OS handles
+    virtual void Close() = 0;
+
+    // Short backend name for status lines
+    virtual const char* Name() const = 0;
+
+    // Description of the last failure from Open/Send/Receive
+    const std::string& LastError() const { return m_LastError; }
+
+protected:
+    std::string m_LastError;
+};
+
+// Available backends
+enum class ProbeBackend {
+    Default,        // IcmpApi on Windows, DatagramSocket elsewhere
+    IcmpApi,        // IcmpSendEcho (Windows only)
+    DatagramSocket, // SOCK_DGRAM/IPPROTO_ICMP sockets (Linux)
+    Simulated       // In-process responder, no network access
+};
+
+// Behaviour of the simulated responder
+struct SimulatedResponderConfig {
+    double baseRttMs = 0.0;  // Fixed part of every round trip
+    double jitterMs = 0.0;   // Uniform random extra delay in [0, jitterMs)
+    double lossRate = 0.0;   // Fraction of probes that never get a reply
+    double duplicateRate = 0.0; // Fraction of replies that arrive twice
+    uint32_t seed = 1;       // Seed for the loss/jitter generator
+};
+
+// Create an engine for the requested backend. Returns nullptr if the backend
+// is not available on this platform.
+std::unique_ptr<ProbeEngine> CreateProbeEngine(ProbeBackend backend);
+
+// Most probes a backend can keep outstanding (IcmpSendEcho2 waits on at most
+// MAXIMUM_WAIT_OBJECTS events)
+#ifdef _WIN32
+const int MAX_ENGINE_IN_FLIGHT = 64;
+#else
+const int MAX_ENGINE_IN_FLIGHT = 4096;
+#endif
+
+// Create a simulated engine with explicit responder behaviour
+std::unique_ptr<ProbeEngine> CreateSimulatedEngine(const SimulatedResponderConfig& config);
+
+// Parse a backend name ("default", "icmpapi", "socket", "sim"). Returns false
+// on an unknown name.
+bool ParseProbeBackend(const std::string& name, ProbeBackend& backend);
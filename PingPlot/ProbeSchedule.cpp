@@ -0,0 +1,98 @@
+#include "ProbeSchedule.h"
+#include "Clock.h"
+#include <thread>
+
+void ProbeSchedule::Start(int64_t intervalNs, int64_t startNs) {
+    m_IntervalNs = intervalNs > 0 ? intervalNs : 0;
+    m_DueNs = startNs;
+    m_Skipped = 0;
+    m_SkippedAtSend = 0;
+    m_Sent = false;
+}
+
+void ProbeSchedule::SetInterval(int64_t intervalNs, int64_t nowNs) {
+    m_IntervalNs = intervalNs > 0 ? intervalNs : 0;
+    if (m_Sent) m_DueNs = m_LastSlotNs + m_IntervalNs;
+    if (m_DueNs < nowNs) m_DueNs = nowNs;
+}
+
+ScheduledSend ProbeSchedule::Sent(int64_t sendTimeNs) {
+    ScheduledSend slot;
+    m_Sent = true;
+    if (m_IntervalNs == 0) {
+        m_DueNs = sendTimeNs;
+        slot.intendedNs = sendTimeNs;
+        m_LastSlotNs = sendTimeNs;
+        return slot;
+    }
+    slot.intendedNs = m_DueNs < sendTimeNs ? m_DueNs : sendTimeNs;
+    m_LastSlotNs = slot.intendedNs;
+    slot.intervalNs = m_IntervalNs;
+    slot.skippedBefore = static_cast<uint32_t>(m_Skipped - m_SkippedAtSend);
+
+    // Slots this send was too late for go on the next send's account
+    m_SkippedAtSend = m_Skipped;
+    Advance(sendTimeNs);
+    return slot;
+}
+
+void ProbeSchedule::Skip(int64_t nowNs) {
+    if (m_IntervalNs == 0) {
+        m_DueNs = nowNs;
+        return;
+    }
+    m_Skipped++;
+    Advance(nowNs);
+}
+
+// The next slot stays on the grid. If it is already more than a whole
+// interval over, the slots before the current one are dropped.
+void ProbeSchedule::Advance(int64_t nowNs) {
+    m_DueNs += m_IntervalNs;
+    if (nowNs - m_DueNs >= m_IntervalNs) {
+        int64_t missed = (nowNs - m_DueNs) / m_IntervalNs;
+        m_DueNs += missed * m_IntervalNs;
+        m_Skipped += static_cast<uint64_t>(missed);
+    }
+}
+
+int64_t ProbeSchedule::WaitNs(int64_t nowNs, int64_t deadlineNs) const {
+    if (m_BusyPoll) return 0;
+    if (m_IntervalNs >= COARSE_SCHEDULE_INTERVAL_NS) {
+        return deadlineNs > nowNs ? deadlineNs - nowNs : 0;
+    }
+    int64_t sleepNs = deadlineNs - m_SpinNs - nowNs;
+    return sleepNs > 0 ? sleepNs : 0;
+}
+
+// Coarse sleep to within the spin window, then spin on the clock. The spin
+// window follows the oversleep the OS actually delivers, decaying slowly.
+// It also decays on waits too short to sleep at all, or a single slow wakeup
+// would leave a fast schedule spinning for good.
+void ProbeSchedule::WaitUntil(int64_t deadlineNs, const std::atomic<bool>& running) {
+    int64_t now = MonotonicNowNs();
+    int64_t sleepUntil = deadlineNs - m_SpinNs;
+    if (now >= sleepUntil && !m_BusyPoll && now < deadlineNs) {
+        int64_t spinNs = m_SpinNs - m_SpinNs / 16;
+        m_SpinNs = spinNs < SCHEDULE_SPIN_NS ? SCHEDULE_SPIN_NS : spinNs;
+    }
+    if (now < sleepUntil && !m_BusyPoll) {
+        // Long waits go in slices so running == false is noticed promptly
+        while (now < sleepUntil && running) {
+            int64_t wake = sleepUntil - now > SCHEDULE_SLICE_NS ? now + SCHEDULE_SLICE_NS : sleepUntil;
+            std::this_thread::sleep_until(std::chrono::steady_clock::time_point(
+                std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(wake))));
+            now = MonotonicNowNs();
+        }
+        int64_t oversleepNs = now - sleepUntil;
+        int64_t spinNs = m_SpinNs - m_SpinNs / 16;
+        if (oversleepNs + oversleepNs / 2 > spinNs) spinNs = oversleepNs + oversleepNs / 2;
+        if (spinNs < SCHEDULE_SPIN_NS) spinNs = SCHEDULE_SPIN_NS;
+        if (spinNs > MAX_SCHEDULE_SPIN_NS) spinNs = MAX_SCHEDULE_SPIN_NS;
+        m_SpinNs = spinNs;
+    }
+    while (now < deadlineNs && running) {
+        std::this_thread::yield();
+        now = MonotonicNowNs();
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// How far before a deadline a waiting thread stops sleeping and starts to
+// spin. The sleep overshoot actually seen widens it up to the maximum.
+#ifdef _WIN32
+const int64_t SCHEDULE_SPIN_NS = 1500000;    // Sleeps wake on the ~1 ms timer tick
+const int64_t MAX_SCHEDULE_SPIN_NS = 3000000;
+#else
+const int64_t SCHEDULE_SPIN_NS = 100000;
+const int64_t MAX_SCHEDULE_SPIN_NS = 2000000;
+#endif
+
+// Schedules with intervals from this long up are waited on right up to the
+// deadline: the OS wakeup delay is small next to the interval, and nothing
+// spins. Event loops with hundreds of slow targets depend on that.
+const int64_t COARSE_SCHEDULE_INTERVAL_NS = 20000000;
+
+// Longest single sleep in WaitUntil
+const int64_t SCHEDULE_SLICE_NS = 100000000;
+
+// Where one send sat on its schedule
+struct ScheduledSend {
+    int64_t intendedNs = 0;     // When the send was due
+    int64_t intervalNs = 0;     // Schedule interval; 0 = unscheduled
+    uint32_t skippedBefore = 0; // Slots passed over since the previous send
+};
+
+// Send schedule on absolute deadlines: send k is due at start + k * interval
+// on the MonotonicNowNs() clock, so wakeup error never adds up from one probe
+// to the next. A late send is still made at once; slots missed entirely (a
+// stall, or a reply slower than the interval in the blocking loop) are
+// skipped instead of being sent in a burst, and the grid keeps its phase. A
+// zero interval means "as fast as possible": every send is due immediately.
+class ProbeSchedule {
+public:
+    // Begin the grid with the first send due at startNs
+    void Start(int64_t intervalNs, int64_t startNs);
+
+    // Switch to a new interval from the next send on. That send is due one
+    // new interval after the previous send's slot, or at once if that has
+    // passed; the grid continues from there and nothing counts as skipped.
+    void SetInterval(int64_t intervalNs, int64_t nowNs);
+
+    int64_t IntervalNs() const { return m_IntervalNs; }
+
+    // Never sleep: WaitNs always returns 0 and WaitUntil spins the whole way.
+    // Costs a CPU; removes the OS wakeup from every send.
+    void SetBusyPoll(bool busyPoll) { m_BusyPoll = busyPoll; }
+    bool BusyPoll() const { return m_BusyPoll; }
+
+    // When the next send is due
+    int64_t DueNs() const { return m_DueNs; }
+
+    bool IsDue(int64_t nowNs) const { return nowNs >= m_DueNs; }
+
+    // Account for a send made at sendTimeNs for the due slot and move on to
+    // the next one. Returns the slot it was made for.
+    ScheduledSend Sent(int64_t sendTimeNs);
+
+    // Move on without sending (no room in the in-flight window)
+    void Skip(int64_t nowNs);
+
+    // Longest a loop may block before deadlineNs. Fast schedules wake in
+    // time to spin up to it (0 means poll); coarse ones block until it.
+    int64_t WaitNs(int64_t nowNs, int64_t deadlineNs) const;
+
+    // Sleep, then spin, until deadlineNs or until running goes false
+    void WaitUntil(int64_t deadlineNs, const std::atomic<bool>& running);
+
+private:
+    // Step to the next slot, skipping those already over at nowNs
+    void Advance(int64_t nowNs);
+
+    int64_t m_IntervalNs = 0;
+    int64_t m_DueNs = 0;
+    int64_t m_SpinNs = SCHEDULE_SPIN_NS;
+    uint64_t m_Skipped = 0;
+    uint64_t m_SkippedAtSend = 0; // m_Skipped as of the previous send
+    int64_t m_LastSlotNs = 0;     // Slot of the previous send
+    bool m_Sent = false;          // A send was made since Start
+    bool m_BusyPoll = false;
+};
@@ -0,0 +1,148 @@
+#include "RateController.h"
+#include <algorithm>
+#include <cmath>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+namespace {
+
+// Weight of one period in the usual loss
+const double USUAL_LOSS_WEIGHT = 0.1;
+
+// Headroom on the RTT when sizing the window
+const double WINDOW_RTT_FACTOR = 1.5;
+
+// CPU time the calling thread has used
+int64_t ThreadCpuNs() {
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) return 0;
+    uint64_t ticks = (static_cast<uint64_t>(kernel.dwHighDateTime) << 32 | kernel.dwLowDateTime) +
+        (static_cast<uint64_t>(user.dwHighDateTime) << 32 | user.dwLowDateTime);
+    return static_cast<int64_t>(ticks * 100); // 100 ns units
+#else
+    timespec now;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now) != 0) return 0;
+    return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+#endif
+}
+
+} // namespace
+
+const char* RateStateName(RateState state) {
+    switch (state) {
+        case RateState::Off: return "off";
+        case RateState::Ramping: return "ramping";
+        case RateState::Steady: return "steady";
+        case RateState::LossBackoff: return "loss backoff";
+        case RateState::CpuLimited: return "cpu limited";
+        case RateState::DepthLimited: return "depth limited";
+    }
+    return "off";
+}
+
+void RateController::Start(const RateTarget& target, int64_t nowNs) {
+    m_Target = target;
+    if (m_Target.maxInFlight < 1) m_Target.maxInFlight = 1;
+    double limit = target.samplesPerSecond > 0 ? target.samplesPerSecond : RATE_CONTROL_MAX_RATE;
+    m_Rate = std::max(RATE_CONTROL_MIN_RATE, std::min(limit, RATE_CONTROL_START_RATE));
+    m_Window = 1;
+    m_State = RateState::Ramping;
+    m_Ceiling = 0.0;
+    m_UsualLoss = 0.0;
+    m_Hold = 0;
+    m_CpuPercent = 0.0;
+    m_NextUpdateNs = nowNs + RATE_CONTROL_PERIOD_NS;
+    m_PeriodStartNs = nowNs;
+    m_PeriodCpuNs = ThreadCpuNs();
+    m_PeriodFinished = 0;
+    m_PeriodLost = 0;
+}
+
+void RateController::SetTargetRate(double samplesPerSecond) {
+    m_Target.samplesPerSecond = samplesPerSecond > 0 ? samplesPerSecond : 0.0;
+}
+
+int RateController::WindowFor(int64_t rttNs) const {
+    double inFlight = m_Rate * rttNs / 1e9 * WINDOW_RTT_FACTOR;
+    int window = static_cast<int>(std::ceil(inFlight)) + 1;
+    return std::max(1, std::min(window, m_Target.maxInFlight));
+}
+
+bool RateController::Update(int64_t nowNs, uint64_t finished, uint64_t lost, int64_t rttNs) {
+    int64_t elapsedNs = nowNs - m_PeriodStartNs;
+    if (elapsedNs <= 0) return false;
+    int64_t cpuNs = ThreadCpuNs();
+    m_CpuPercent = 100.0 * (cpuNs - m_PeriodCpuNs) / elapsedNs;
+
+    // Late replies take probes back off the lost count
+    uint64_t periodFinished = finished - m_PeriodFinished;
+    uint64_t periodLost = lost > m_PeriodLost ? lost - m_PeriodLost : 0;
+    double periodLoss = periodFinished ? static_cast<double>(periodLost) / periodFinished : 0.0;
+    double achieved = periodFinished * 1e9 / elapsedNs;
+    m_PeriodStartNs = nowNs;
+    m_PeriodCpuNs = cpuNs;
+    m_PeriodFinished = finished;
+    m_PeriodLost = lost;
+    m_NextUpdateNs = nowNs + RATE_CONTROL_PERIOD_NS;
+
+    double target = m_Target.samplesPerSecond > 0 ? m_Target.samplesPerSecond : RATE_CONTROL_MAX_RATE;
+    double budget = m_Target.cpuPercent;
+    double previousRate = m_Rate;
+    int previousWindow = m_Window;
+    double rate = m_Rate;
+
+    bool burst = periodLost >= LOSS_BURST_MIN_PROBES && periodLoss > m_UsualLoss + LOSS_BURST_MARGIN &&
+        periodLoss > 2 * m_UsualLoss;
+    if (burst) {
+        // Loss that comes with the rate (a rate-limited responder or a full
+        // queue) goes away when it drops
+        m_Ceiling = std::min(rate, std::max(achieved, RATE_CONTROL_MIN_RATE));
+        rate *= RATE_CONTROL_BACKOFF;
+        m_Hold = RATE_CONTROL_HOLD_PERIODS;
+        m_State = RateState::LossBackoff;
+    } else {
+        if (periodFinished > 0) m_UsualLoss += (periodLoss - m_UsualLoss) * USUAL_LOSS_WEIGHT;
+
+        if (budget > 0 && m_CpuPercent > budget) {
+            rate *= std::max(RATE_CONTROL_BACKOFF, budget / m_CpuPercent);
+            m_State = RateState::CpuLimited;
+        } else if (rate > target) {
+            rate = target;
+            m_State = RateState::Steady;
+        } else if (m_Hold > 0) {
+            m_Hold--;
+        } else if (rate < target) {
+            double next = rate * RATE_CONTROL_GROWTH;
+            if (m_Ceiling > 0 && next > m_Ceiling * RATE_CONTROL_CEILING_MARGIN) {
+                next = std::max(rate, m_Ceiling * RATE_CONTROL_CEILING_MARGIN) + m_Ceiling * RATE_CONTROL_CREEP;
+            }
+
+            // Stay under the budget on the way up, assuming CPU grows with the rate
+            if (budget > 0 && m_CpuPercent > 0 && m_CpuPercent * next / rate > budget) {
+                next = std::max(rate, rate * budget / m_CpuPercent);
+            }
+
+            // A loop that did not keep up with the last increase gets no further
+            if (achieved < rate * 0.75 && periodFinished > 0) {
+                m_State = RateState::DepthLimited;
+            } else if (next > rate) {
+                rate = std::min(next, target);
+                m_State = rate >= target ? RateState::Steady : RateState::Ramping;
+            } else {
+                m_State = RateState::CpuLimited;
+            }
+        } else {
+            m_State = RateState::Steady;
+        }
+    }
+
+    m_Rate = std::max(RATE_CONTROL_MIN_RATE, std::min(rate, target));
+    m_Window = WindowFor(rttNs);
+    return m_Rate != previousRate || m_Window != previousWindow;
+}
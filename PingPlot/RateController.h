@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+
+// How often the controller looks back and adjusts
+const int64_t RATE_CONTROL_PERIOD_NS = 250000000;
+
+// Rates it works between, in probes per second. Without a rate target it
+// climbs as far as the CPU budget and the path allow, up to the maximum.
+const double RATE_CONTROL_MIN_RATE = 1.0;
+const double RATE_CONTROL_START_RATE = 50.0;
+const double RATE_CONTROL_MAX_RATE = 100000.0;
+
+// Increase per period while ramping up, and cut on a loss burst
+const double RATE_CONTROL_GROWTH = 1.25;
+const double RATE_CONTROL_BACKOFF = 0.5;
+
+// Periods without an increase after a backoff
+const int RATE_CONTROL_HOLD_PERIODS = 8;
+
+// Within this fraction of a rate that caused a loss burst, the ramp only
+// creeps up by RATE_CONTROL_CREEP of that rate per period
+const double RATE_CONTROL_CEILING_MARGIN = 0.9;
+const double RATE_CONTROL_CREEP = 0.02;
+
+// A period is a loss burst when at least this many probes were lost and its
+// loss is above the usual loss by the margin and at least twice it, so a
+// path that always drops a few percent is not throttled for it
+const uint64_t LOSS_BURST_MIN_PROBES = 3;
+const double LOSS_BURST_MARGIN = 0.05;
+
+// Deepest pipelining when the user set no in-flight limit
+const int RATE_CONTROL_DEFAULT_MAX_IN_FLIGHT = 32;
+
+// What the controller aims for
+struct RateTarget {
+    double samplesPerSecond = 0.0; // 0 = as fast as the other limits allow
+    double cpuPercent = 0.0;       // Probe thread CPU budget in percent of one core; 0 = none
+    int maxInFlight = 1;           // Deepest pipelining allowed
+};
+
+// What limits the rate at the moment
+enum class RateState : uint8_t {
+    Off,         // Not adaptive: the configured interval applies
+    Ramping,     // Climbing towards the target
+    Steady,      // At the target
+    LossBackoff, // Backed off after a loss burst (or ICMP rate limiting)
+    CpuLimited,  // Held at the CPU budget
+    DepthLimited // The in-flight limit or the loop cannot send faster
+};
+
+// Short name for status lines
+const char* RateStateName(RateState state);
+
+// Closed-loop send rate: every RATE_CONTROL_PERIOD_NS it looks at the loss
+// and the probe thread's CPU time over the last period and adjusts the rate
+// AIMD style. It ramps up multiplicatively towards the target, halves on a
+// loss burst and holds a while, remembers the rate the burst happened at
+// and approaches it slowly the next time, and scales down in proportion
+// when over the CPU budget. The pipelining depth follows the rate: enough
+// probes in flight to cover the typical RTT at that rate, up to the limit.
+// Used from the probe thread only.
+class RateController {
+public:
+    void Start(const RateTarget& target, int64_t nowNs);
+
+    // New rate target from the next period on (0 = as fast as allowed)
+    void SetTargetRate(double samplesPerSecond);
+
+    bool Due(int64_t nowNs) const { return nowNs >= m_NextUpdateNs; }
+    int64_t NextUpdateNs() const { return m_NextUpdateNs; }
+
+    // Adjust for the period ending at nowNs. finished and lost are run
+    // totals of the probes, rttNs the typical RTT right now (0 if unknown).
+    // Reads the calling thread's CPU time. Returns true if the interval or
+    // the window changed.
+    bool Update(int64_t nowNs, uint64_t finished, uint64_t lost, int64_t rttNs);
+
+    double Rate() const { return m_Rate; }
+    int64_t IntervalNs() const { return static_cast<int64_t>(1e9 / m_Rate); }
+    int Window() const { return m_Window; }
+    RateState State() const { return m_State; }
+    double CpuPercent() const { return m_CpuPercent; }
+
+private:
+    // Pipelining depth for the current rate
+    int WindowFor(int64_t rttNs) const;
+
+    RateTarget m_Target;
+    RateState m_State = RateState::Off;
+    double m_Rate = RATE_CONTROL_START_RATE;
+    int m_Window = 1;
+    double m_Ceiling = 0.0;   // Rate of the last loss burst; 0 = none yet
+    double m_UsualLoss = 0.0; // Slow average of the loss outside bursts
+    int m_Hold = 0;           // Periods left without an increase
+    double m_CpuPercent = 0.0;
+    int64_t m_NextUpdateNs = 0;
+    int64_t m_PeriodStartNs = 0;
+    int64_t m_PeriodCpuNs = 0;
+    uint64_t m_PeriodFinished = 0;
+    uint64_t m_PeriodLost = 0;
+};
@@ -0,0 +1,266 @@
+#include "Resolver.h"
+#include "Clock.h"
+#include <cstring>
+#ifdef _WIN32
+#include <WS2tcpip.h>
+#include <winsock2.h>
+
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif
+
+bool NetAddress::operator==(const NetAddress& other) const {
+    return family == other.family && memcmp(bytes, other.bytes, sizeof(bytes)) == 0;
+}
+
+// FNV-1a over the family and the address bytes
+size_t NetAddressHash::operator()(const NetAddress& address) const {
+    uint64_t hash = 14695981039346656037ULL;
+    hash = (hash ^ address.family) * 1099511628211ULL;
+    for (uint8_t byte : address.bytes) {
+        hash = (hash ^ byte) * 1099511628211ULL;
+    }
+    return static_cast<size_t>(hash);
+}
+
+bool ParseNetAddress(const std::string& text, NetAddress& address) {
+    address = NetAddress();
+    if (inet_pton(AF_INET, text.c_str(), address.bytes) == 1) {
+        address.family = 4;
+        return true;
+    }
+    if (inet_pton(AF_INET6, text.c_str(), address.bytes) == 1) {
+        address.family = 6;
+        return true;
+    }
+    return false;
+}
+
+std::string FormatNetAddress(const NetAddress& address) {
+    char text[INET6_ADDRSTRLEN] = "";
+    if (address.family == 4) {
+        inet_ntop(AF_INET, address.bytes, text, sizeof(text));
+    } else if (address.family == 6) {
+        inet_ntop(AF_INET6, address.bytes, text, sizeof(text));
+    }
+    return text;
+}
+
+bool SystemLookup(const std::string& host, std::vector<NetAddress>& addresses, int64_t& ttlNs, std::string& error) {
+    addrinfo hints = {};
+    addrinfo* result = nullptr;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    // Only families this host has an address in, so a v4-only machine is
+    // not handed AAAA answers it cannot probe
+    hints.ai_flags = AI_ADDRCONFIG;
+
+    int res = getaddrinfo(host.c_str(), nullptr, &hints, &result);
+    if (res != 0 || !result) {
+        // With nothing but loopback configured AI_ADDRCONFIG filters out
+        // every family; ask again without it so localhost still resolves
+        hints.ai_flags = 0;
+        res = getaddrinfo(host.c_str(), nullptr, &hints, &result);
+    }
+    if (res != 0 || !result) {
+#ifdef _WIN32
+        error = std::to_string(res);
+#else
+        error = gai_strerror(res);
+#endif
+        return false;
+    }
+
+    // getaddrinfo gives no TTL; the resolver's default applies
+    ttlNs = 0;
+    addresses.clear();
+    for (addrinfo* entry = result; entry; entry = entry->ai_next) {
+        NetAddress address;
+        if (entry->ai_family == AF_INET) {
+            address.family = 4;
+            memcpy(address.bytes, &reinterpret_cast<sockaddr_in*>(entry->ai_addr)->sin_addr, 4);
+        } else if (entry->ai_family == AF_INET6) {
+            address.family = 6;
+            memcpy(address.bytes, &reinterpret_cast<sockaddr_in6*>(entry->ai_addr)->sin6_addr, 16);
+        } else {
+            continue;
+        }
+        bool seen = false;
+        for (const NetAddress& known : addresses) {
+            if (known == address) seen = true;
+        }
+        if (!seen) addresses.push_back(address);
+    }
+    freeaddrinfo(result);
+    return true;
+}
+
+LookupFunction StubLookup(const std::vector<NetAddress>& answers, int64_t ttlNs, int delayMs) {
+    return [answers, ttlNs, delayMs](const std::string& /*host*/, std::vector<NetAddress>& addresses,
+        int64_t& ttl, std::string& /*error*/) {
+        if (delayMs > 0) std::this_thread::sleep_for(std::chrono::milliseconds(delayMs));
+        addresses = answers;
+        ttl = ttlNs;
+        return true;
+    };
+}
+
+uint32_t ResolvedHost::Addresses(std::vector<NetAddress>& out, std::string* error) const {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    out = m_Addresses;
+    if (error) *error = m_Error;
+    return m_Generation.load(std::memory_order_relaxed);
+}
+
+bool ResolvedHost::Follow(NetAddress& address, uint32_t& generation) const {
+    if (Generation() == generation) return false;
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    generation = m_Generation.load(std::memory_order_relaxed);
+    if (m_Addresses.empty()) return false;
+    for (const NetAddress& known : m_Addresses) {
+        if (known == address) return false;
+    }
+    address = m_Addresses[0];
+    return true;
+}
+
+void ResolvedHost::Update(bool ok, const std::vector<NetAddress>& addresses, const std::string& error) {
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (ok) {
+            if (addresses != m_Addresses) {
+                m_Addresses = addresses;
+                m_Generation.store(m_Generation.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+            }
+            m_Error.clear();
+        } else {
+            m_Error = error;
+        }
+    }
+    m_Resolved.store(true, std::memory_order_release);
+}
+
+Resolver::Resolver(LookupFunction lookup, int64_t defaultTtlNs, int threads, int64_t retryNs)
+    : m_Lookup(lookup), m_DefaultTtlNs(defaultTtlNs), m_RetryNs(retryNs) {
+#ifdef _WIN32
+    // getaddrinfo needs Winsock
+    WSADATA wsaData;
+    m_WinsockStarted = WSAStartup(MAKEWORD(2, 2), &wsaData) == 0;
+#endif
+    if (threads < 1) threads = 1;
+    for (int i = 0; i < threads; i++) {
+        m_Workers.emplace_back(&Resolver::WorkerLoop, this);
+    }
+}
+
+Resolver::~Resolver() {
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stopping = true;
+    }
+    m_Wake.notify_all();
+    for (std::thread& worker : m_Workers) {
+        worker.join();
+    }
+#ifdef _WIN32
+    if (m_WinsockStarted) WSACleanup();
+#endif
+}
+
+std::shared_ptr<ResolvedHost> Resolver::Watch(const std::string& host) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    auto it = m_Hosts.find(host);
+    if (it != m_Hosts.end()) return it->second;
+
+    std::shared_ptr<ResolvedHost> entry(new ResolvedHost(host));
+    NetAddress literal;
+    if (ParseNetAddress(host, literal)) {
+        entry->m_Literal = true;
+        entry->Update(true, std::vector<NetAddress>(1, literal), std::string());
+    } else {
+        m_Wake.notify_one();
+    }
+    m_Hosts[host] = entry;
+    return entry;
+}
+
+bool Resolver::Wait(const ResolvedHost& host, const std::atomic<bool>& running, int timeoutMs) {
+    int64_t deadline = MonotonicNowNs() + static_cast<int64_t>(timeoutMs) * 1000000;
+    while (!host.Resolved() && running) {
+        if (timeoutMs >= 0 && MonotonicNowNs() >= deadline) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(DNS_WAIT_TICK_MS));
+    }
+    return host.Resolved();
+}
+
+// Look up whatever is due; sleep until the next entry is
+void Resolver::WorkerLoop() {
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    std::vector<NetAddress> addresses;
+    std::string error;
+    while (!m_Stopping) {
+        int64_t now = MonotonicNowNs();
+        int64_t wakeNs = now + m_RetryNs;
+        ResolvedHost* due = NextDue(now, wakeNs);
+        if (!due) {
+            m_Wake.wait_for(lock, std::chrono::nanoseconds(wakeNs - now));
+            continue;
+        }
+
+        // The entry may leave the cache meanwhile; keep it alive
+        std::shared_ptr<ResolvedHost> host = m_Hosts[due->Name()];
+        host->m_InProgress = true;
+        lock.unlock();
+
+        m_Lookups++;
+        int64_t ttlNs = 0;
+        addresses.clear();
+        error.clear();
+        bool ok = m_Lookup(host->Name(), addresses, ttlNs, error);
+        if (ok && addresses.empty()) {
+            ok = false;
+            error = "No addresses";
+        }
+        host->Update(ok, addresses, error);
+
+        lock.lock();
+        host->m_InProgress = false;
+        host->m_NextLookupNs = MonotonicNowNs() + (!ok ? m_RetryNs : ttlNs > 0 ? ttlNs : m_DefaultTtlNs);
+    }
+}
+
+ResolvedHost* Resolver::NextDue(int64_t nowNs, int64_t& wakeNs) {
+    ResolvedHost* next = nullptr;
+    for (auto it = m_Hosts.begin(); it != m_Hosts.end();) {
+        ResolvedHost& host = *it->second;
+        bool watched = it->second.use_count() > 1;
+        if (host.m_InProgress) {
+            ++it;
+            continue;
+        }
+        // Unwatched entries stay cached until they expire; literals until
+        // nobody uses them
+        if (!watched && (host.m_Literal || host.m_NextLookupNs <= nowNs)) {
+            it = m_Hosts.erase(it);
+            continue;
+        }
+        if (!host.m_Literal) {
+            if (host.m_NextLookupNs <= nowNs) {
+                if (!next || host.m_NextLookupNs < next->m_NextLookupNs) next = &host;
+            } else if (host.m_NextLookupNs < wakeNs) {
+                wakeNs = host.m_NextLookupNs;
+            }
+        }
+        ++it;
+    }
+    return next;
+}
+
+Resolver& DefaultResolver() {
+    static Resolver resolver;
+    return resolver;
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+const int64_t DEFAULT_DNS_TTL_NS = 60000000000LL; // How long an answer is used when the lookup gives no TTL
+const int64_t DNS_RETRY_NS = 5000000000LL;        // Wait before looking up a name again after a failure
+const int DNS_WORKER_THREADS = 4;                 // Lookups that may be in progress at once
+const int DNS_WAIT_TICK_MS = 10;                  // Poll interval of Resolver::Wait
+
+// An IPv4 or IPv6 address in network byte order
+struct NetAddress {
+    uint8_t family = 0;      // 4 or 6; 0 = none
+    uint8_t bytes[16] = {};  // First 4 bytes for IPv4
+
+    bool operator==(const NetAddress& other) const;
+    bool operator!=(const NetAddress& other) const { return !(*this == other); }
+};
+
+// Hash for keying maps by address
+struct NetAddressHash {
+    size_t operator()(const NetAddress& address) const;
+};
+
+// Parse a numeric IPv4 or IPv6 address. Returns false for anything else.
+bool ParseNetAddress(const std::string& text, NetAddress& address);
+
+// Numeric text form of an address
+std::string FormatNetAddress(const NetAddress& address);
+
+// Looks up host. Fills addresses in preference order and ttlNs with how long
+// they may be used (0 = the resolver's default), or error on failure.
+// Called from resolver worker threads.
+typedef std::function<bool(const std::string& host, std::vector<NetAddress>& addresses, int64_t& ttlNs,
+    std::string& error)> LookupFunction;
+
+// getaddrinfo for IPv4 and IPv6, in the order the system prefers them
+bool SystemLookup(const std::string& host, std::vector<NetAddress>& addresses, int64_t& ttlNs, std::string& error);
+
+// Lookup that answers every name with the same addresses after delayMs,
+// without touching the network. Backs the simulated backend.
+LookupFunction StubLookup(const std::vector<NetAddress>& answers, int64_t ttlNs = 0, int delayMs = 0);
+
+// The current addresses of one name. The resolver updates it in the
+// background; Generation changes whenever the address list does, so users
+// poll it with one atomic load and copy the list only when it moved.
+class ResolvedHost {
+public:
+    explicit ResolvedHost(const std::string& name) : m_Name(name) {}
+
+    const std::string& Name() const { return m_Name; }
+
+    // True once the first lookup has finished, successfully or not
+    bool Resolved() const { return m_Resolved.load(std::memory_order_acquire); }
+
+    uint32_t Generation() const { return m_Generation.load(std::memory_order_acquire); }
+
+    // Copy the addresses (empty if the name never resolved) and the last
+    // error. Returns the generation copied.
+    uint32_t Addresses(std::vector<NetAddress>& out, std::string* error = nullptr) const;
+
+    // Keep a probed address on the current answer: if the generation moved
+    // past generation and the list no longer holds address, address becomes
+    // the first one listed. Returns true if address changed. One atomic load
+    // while nothing changed.
+    bool Follow(NetAddress& address, uint32_t& generation) const;
+
+private:
+    friend class Resolver;
+
+    // Store a lookup result. A failure keeps the addresses already known.
+    void Update(bool ok, const std::vector<NetAddress>& addresses, const std::string& error);
+
+    const std::string m_Name;
+    mutable std::mutex m_Mutex;
+    std::vector<NetAddress> m_Addresses;
+    std::string m_Error;
+    std::atomic<uint32_t> m_Generation{0};
+    std::atomic<bool> m_Resolved{false};
+
+    // Scheduling, guarded by the resolver's mutex
+    bool m_Literal = false;    // Numeric address; never looked up
+    bool m_InProgress = false;
+    int64_t m_NextLookupNs = 0;
+};
+
+// Resolves names off the probe path. Every name is looked up on a worker
+// thread, cached for its TTL and looked up again in the background while
+// anyone still watches it, so a changed answer (a CDN rotating addresses)
+// reaches the probe loops without stopping them. Numeric addresses are
+// answered at once. Names nobody watches any more leave the cache when they
+// expire, so restarting a run within the TTL does not wait on DNS.
+class Resolver {
+public:
+    explicit Resolver(LookupFunction lookup = SystemLookup, int64_t defaultTtlNs = DEFAULT_DNS_TTL_NS,
+        int threads = DNS_WORKER_THREADS, int64_t retryNs = DNS_RETRY_NS);
+    ~Resolver();
+
+    // The cache entry for host, queued for lookup if it is new or stale.
+    // Never blocks on DNS.
+    std::shared_ptr<ResolvedHost> Watch(const std::string& host);
+
+    // Block until host has its first answer, timeoutMs passes (< 0 = no
+    // limit) or running goes false. Returns host.Resolved().
+    static bool Wait(const ResolvedHost& host, const std::atomic<bool>& running, int timeoutMs = -1);
+
+    // Lookups started so far
+    uint64_t Lookups() const { return m_Lookups.load(); }
+
+private:
+    void WorkerLoop();
+
+    // Entry with the earliest due lookup, or nullptr; drops expired entries
+    // nobody watches. Called with m_Mutex held.
+    ResolvedHost* NextDue(int64_t nowNs, int64_t& wakeNs);
+
+    LookupFunction m_Lookup;
+    const int64_t m_DefaultTtlNs;
+    const int64_t m_RetryNs;
+    std::mutex m_Mutex;
+    std::condition_variable m_Wake;
+    std::map<std::string, std::shared_ptr<ResolvedHost>> m_Hosts;
+    std::vector<std::thread> m_Workers;
+    bool m_Stopping = false;
+    std::atomic<uint64_t> m_Lookups{0};
+#ifdef _WIN32
+    bool m_WinsockStarted = false;
+#endif
+};
+
+// Shared resolver using SystemLookup, created on first use
+Resolver& DefaultResolver();
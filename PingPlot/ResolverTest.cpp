@@ -0,0 +1,240 @@
+// Tests for Resolver and ResolvedHost against stub lookups: the first
+// answer, re-resolution when the TTL runs out, Follow keeping or moving a
+// probed address, retrying after a failed lookup and dropping unwatched
+// names from the cache. Runs under ctest; exits non-zero on any failure.
+
+#include "Clock.h"
+#include "Resolver.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const int64_t TEST_TTL_NS = 50000000;   // Short enough that re-lookups come quickly
+const int64_t TEST_RETRY_NS = 50000000;
+const int TEST_TIMEOUT_MS = 2000;       // Longest any condition is waited for
+
+int g_Failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::printf("%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+            g_Failures++; \
+        } \
+    } while (0)
+
+NetAddress Address(const char* text) {
+    NetAddress address;
+    ParseNetAddress(text, address);
+    return address;
+}
+
+std::vector<NetAddress> Addresses(const ResolvedHost& host) {
+    std::vector<NetAddress> addresses;
+    host.Addresses(addresses);
+    return addresses;
+}
+
+// Poll until done() holds or TEST_TIMEOUT_MS passes. Returns done().
+bool WaitFor(const std::function<bool()>& done) {
+    int64_t deadline = MonotonicNowNs() + static_cast<int64_t>(TEST_TIMEOUT_MS) * 1000000;
+    while (!done() && MonotonicNowNs() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return done();
+}
+
+// Lookup the test can change between calls: answers through a StubLookup,
+// or fails
+struct ScriptedLookup {
+    std::mutex mutex;
+    LookupFunction answer;
+    bool fail = false;
+
+    void Answer(const std::vector<NetAddress>& answers, int64_t ttlNs) {
+        std::lock_guard<std::mutex> lock(mutex);
+        answer = StubLookup(answers, ttlNs);
+        fail = false;
+    }
+
+    void Fail() {
+        std::lock_guard<std::mutex> lock(mutex);
+        fail = true;
+    }
+};
+
+LookupFunction Scripted(const std::shared_ptr<ScriptedLookup>& script) {
+    return [script](const std::string& host, std::vector<NetAddress>& addresses, int64_t& ttlNs, std::string& error) {
+        std::lock_guard<std::mutex> lock(script->mutex);
+        if (script->fail) {
+            error = "Scripted failure";
+            return false;
+        }
+        return script->answer(host, addresses, ttlNs, error);
+    };
+}
+
+void TestFirstResolution() {
+    const NetAddress a = Address("192.0.2.1");
+    Resolver resolver(StubLookup(std::vector<NetAddress>(1, a), 0, 20));
+    std::atomic<bool> running(true);
+
+    std::shared_ptr<ResolvedHost> host = resolver.Watch("host.test");
+    CHECK(!host->Resolved());
+    CHECK(host->Generation() == 0);
+    CHECK(Resolver::Wait(*host, running, TEST_TIMEOUT_MS));
+    CHECK(Addresses(*host) == std::vector<NetAddress>(1, a));
+    CHECK(host->Generation() == 1);
+    CHECK(resolver.Lookups() == 1);
+
+    // Watching the same name again shares the entry
+    CHECK(resolver.Watch("host.test") == host);
+
+    // Numeric addresses are answered at once, without a lookup
+    std::shared_ptr<ResolvedHost> literal = resolver.Watch("2001:db8::1");
+    CHECK(literal->Resolved());
+    CHECK(Addresses(*literal) == std::vector<NetAddress>(1, Address("2001:db8::1")));
+    CHECK(resolver.Lookups() == 1);
+}
+
+void TestTtlAndFollow() {
+    const NetAddress a = Address("192.0.2.1");
+    const NetAddress b = Address("192.0.2.2");
+    const NetAddress c = Address("2001:db8::3");
+    std::shared_ptr<ScriptedLookup> script(new ScriptedLookup());
+    script->Answer(std::vector<NetAddress>(1, a), TEST_TTL_NS);
+    Resolver resolver(Scripted(script));
+    std::atomic<bool> running(true);
+
+    std::shared_ptr<ResolvedHost> host = resolver.Watch("host.test");
+    CHECK(Resolver::Wait(*host, running, TEST_TIMEOUT_MS));
+    NetAddress probed = Addresses(*host)[0];
+    uint32_t generation = host->Generation();
+    CHECK(generation == 1);
+    CHECK(!host->Follow(probed, generation));
+
+    // The same answer again, once the TTL is over, leaves the generation
+    uint64_t lookups = resolver.Lookups();
+    CHECK(WaitFor([&] { return resolver.Lookups() >= lookups + 2; }));
+    CHECK(host->Generation() == 1);
+
+    // A new list that still holds the probed address: the generation moves,
+    // the probe stays where it is
+    script->Answer({ b, a }, TEST_TTL_NS);
+    CHECK(WaitFor([&] { return host->Generation() == 2; }));
+    CHECK(!host->Follow(probed, generation));
+    CHECK(probed == a);
+    CHECK(generation == 2);
+
+    // A list without it: the probe moves to the first address listed
+    script->Answer({ c, b }, TEST_TTL_NS);
+    CHECK(WaitFor([&] { return host->Generation() == 3; }));
+    CHECK(host->Follow(probed, generation));
+    CHECK(probed == c);
+    CHECK(generation == 3);
+    CHECK(!host->Follow(probed, generation));
+}
+
+void TestRetryAfterFailure() {
+    const NetAddress a = Address("192.0.2.1");
+    std::shared_ptr<ScriptedLookup> script(new ScriptedLookup());
+    script->Fail();
+    Resolver resolver(Scripted(script), DEFAULT_DNS_TTL_NS, DNS_WORKER_THREADS, TEST_RETRY_NS);
+    std::atomic<bool> running(true);
+
+    // A failed first lookup still counts as resolved, with the error and no
+    // addresses
+    std::shared_ptr<ResolvedHost> host = resolver.Watch("host.test");
+    CHECK(Resolver::Wait(*host, running, TEST_TIMEOUT_MS));
+    std::vector<NetAddress> addresses;
+    std::string error;
+    host->Addresses(addresses, &error);
+    CHECK(addresses.empty());
+    CHECK(!error.empty());
+    CHECK(host->Generation() == 0);
+    NetAddress probed;
+    uint32_t generation = 0;
+    CHECK(!host->Follow(probed, generation));
+
+    // It is looked up again after the retry delay, not after the TTL
+    script->Answer(std::vector<NetAddress>(1, a), 0);
+    CHECK(WaitFor([&] { return host->Generation() == 1; }));
+    host->Addresses(addresses, &error);
+    CHECK(addresses == std::vector<NetAddress>(1, a));
+    CHECK(error.empty());
+    CHECK(host->Follow(probed, generation));
+    CHECK(probed == a);
+}
+
+void TestFailureKeepsAddresses() {
+    const NetAddress a = Address("192.0.2.1");
+    std::shared_ptr<ScriptedLookup> script(new ScriptedLookup());
+    script->Answer(std::vector<NetAddress>(1, a), TEST_TTL_NS);
+    Resolver resolver(Scripted(script), DEFAULT_DNS_TTL_NS, DNS_WORKER_THREADS, TEST_RETRY_NS);
+    std::atomic<bool> running(true);
+
+    std::shared_ptr<ResolvedHost> host = resolver.Watch("host.test");
+    CHECK(Resolver::Wait(*host, running, TEST_TIMEOUT_MS));
+
+    // A re-lookup that fails keeps the last good answer
+    script->Fail();
+    uint64_t lookups = resolver.Lookups();
+    CHECK(WaitFor([&] { return resolver.Lookups() > lookups; }));
+    std::vector<NetAddress> addresses;
+    std::string error;
+    CHECK(WaitFor([&] { host->Addresses(addresses, &error); return !error.empty(); }));
+    CHECK(addresses == std::vector<NetAddress>(1, a));
+    CHECK(host->Generation() == 1);
+}
+
+void TestCacheEviction() {
+    const NetAddress a = Address("192.0.2.1");
+    Resolver resolver(StubLookup(std::vector<NetAddress>(1, a), TEST_TTL_NS, 20));
+    std::atomic<bool> running(true);
+
+    std::shared_ptr<ResolvedHost> host = resolver.Watch("host.test");
+    CHECK(Resolver::Wait(*host, running, TEST_TIMEOUT_MS));
+    CHECK(resolver.Lookups() == 1);
+
+    // Watched again within the TTL: answered from the cache
+    host.reset();
+    host = resolver.Watch("host.test");
+    CHECK(host->Resolved());
+    CHECK(resolver.Lookups() == 1);
+
+    // Nobody watching past the TTL: the entry is dropped, not looked up
+    // again, and the next Watch starts over
+    host.reset();
+    std::this_thread::sleep_for(std::chrono::nanoseconds(TEST_TTL_NS * 4));
+    CHECK(resolver.Lookups() == 1);
+    host = resolver.Watch("host.test");
+    CHECK(!host->Resolved());
+    CHECK(Resolver::Wait(*host, running, TEST_TIMEOUT_MS));
+    CHECK(resolver.Lookups() == 2);
+    CHECK(host->Generation() == 1);
+}
+
+} // namespace
+
+int main() {
+    TestFirstResolution();
+    TestTtlAndFollow();
+    TestRetryAfterFailure();
+    TestFailureKeepsAddresses();
+    TestCacheEviction();
+
+    if (g_Failures > 0) {
+        std::printf("%d check(s) failed\n", g_Failures);
+        return 1;
+    }
+    std::printf("All resolver tests passed\n");
+    return 0;
+}
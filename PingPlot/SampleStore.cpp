@@ -0,0 +1,184 @@
+#include "SampleStore.h"
+
+size_t SampleColumns::Size() const {
+    if (!status.empty()) return status.size();
+    if (!rttNs.empty()) return rttNs.size();
+    if (!sendTimeNs.empty()) return sendTimeNs.size();
+    if (!sequence.empty()) return sequence.size();
+    if (!timestampSource.empty()) return timestampSource.size();
+    return intendedSendNs.size();
+}
+
+void SampleColumns::Clear() {
+    sendTimeNs.clear();
+    rttNs.clear();
+    sequence.clear();
+    status.clear();
+    timestampSource.clear();
+    intendedSendNs.clear();
+    firstIndex = 0;
+}
+
+SampleStore::SampleStore(size_t capacity)
+    : m_Capacity(capacity), m_Mask(capacity - 1),
+      m_SendTimeNs(new std::atomic<int64_t>[capacity]),
+      m_RttNs(new std::atomic<int64_t>[capacity]),
+      m_Sequence(new std::atomic<uint32_t>[capacity]),
+      m_Status(new std::atomic<SampleStatus>[capacity]),
+      m_TimestampSource(new std::atomic<TimestampSource>[capacity]),
+      m_IntendedSendNs(new std::atomic<int64_t>[capacity]) {
+    for (size_t i = 0; i < m_Capacity; i++) {
+        m_SendTimeNs[i].store(0, std::memory_order_relaxed);
+        m_RttNs[i].store(0, std::memory_order_relaxed);
+        m_Sequence[i].store(0, std::memory_order_relaxed);
+        m_Status[i].store(SampleStatus::Pending, std::memory_order_relaxed);
+        m_TimestampSource[i].store(TimestampSource::Application, std::memory_order_relaxed);
+        m_IntendedSendNs[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+// Reserve the next record and trim the visible window by send time
+uint64_t SampleStore::Begin(int64_t sendTimeNs, uint32_t sequence, int64_t historyNs, int64_t intendedSendNs) {
+    uint64_t head = m_Head.load(std::memory_order_relaxed);
+    size_t slot = head & m_Mask;
+    m_Status[slot].store(SampleStatus::Pending, std::memory_order_relaxed);
+    m_SendTimeNs[slot].store(sendTimeNs, std::memory_order_relaxed);
+    m_RttNs[slot].store(0, std::memory_order_relaxed);
+    m_Sequence[slot].store(sequence, std::memory_order_relaxed);
+    m_TimestampSource[slot].store(TimestampSource::Application, std::memory_order_relaxed);
+    m_IntendedSendNs[slot].store(intendedSendNs, std::memory_order_relaxed);
+
+    // Records are in send order, so expiry only ever advances the front
+    uint64_t visible = m_Visible.load(std::memory_order_relaxed);
+    if (head + 1 - visible > m_Capacity) visible = head + 1 - m_Capacity;
+    int64_t cutoff = sendTimeNs - historyNs;
+    while (visible < head && m_SendTimeNs[visible & m_Mask].load(std::memory_order_relaxed) < cutoff) {
+        visible++;
+    }
+    m_Visible.store(visible, std::memory_order_relaxed);
+    m_Head.store(head + 1, std::memory_order_release);
+    return head;
+}
+
+// Publish the result: RTT and timestamp source first, then the status with
+// release so a reader that sees the final status also sees the rest
+void SampleStore::Complete(uint64_t index, int64_t rttNs, SampleStatus status, TimestampSource source) {
+    uint64_t head = m_Head.load(std::memory_order_relaxed);
+    if (index >= head || head - index > m_Capacity) return;
+    size_t slot = index & m_Mask;
+    m_RttNs[slot].store(rttNs, std::memory_order_relaxed);
+    m_TimestampSource[slot].store(source, std::memory_order_relaxed);
+    m_Status[slot].store(status, std::memory_order_release);
+}
+
+void SampleStore::Push(int64_t sendTimeNs, uint32_t sequence, int64_t rttNs, SampleStatus status, int64_t historyNs,
+    TimestampSource source) {
+    Complete(Begin(sendTimeNs, sequence, historyNs, sendTimeNs), rttNs, status, source);
+}
+
+// Clear previous data
+void SampleStore::Clear() {
+    m_Visible.store(m_Head.load(std::memory_order_relaxed), std::memory_order_release);
+}
+
+// Copy the visible history for drawing or reporting
+void SampleStore::Snapshot(SampleColumns& out, unsigned columns) const {
+    uint64_t head = m_Head.load(std::memory_order_acquire);
+    uint64_t from = m_Visible.load(std::memory_order_acquire);
+    if (from > head) from = head;
+    out.Clear();
+    CopyRange(from, head, out, columns);
+}
+
+// Incremental read for consumers that follow the stream
+uint64_t SampleStore::ReadFrom(uint64_t& cursor, SampleColumns& out, unsigned columns) const {
+    uint64_t head = m_Head.load(std::memory_order_acquire);
+    uint64_t from = cursor;
+    if (from > head) from = head;
+    out.Clear();
+    CopyRange(from, head, out, columns);
+    uint64_t skipped = out.firstIndex - from;
+    cursor = head;
+    return skipped;
+}
+
+// Same protocol as CopyRange for a single record
+bool SampleStore::Read(uint64_t index, int64_t& sendTimeNs, int64_t& rttNs, SampleStatus& status) const {
+    uint64_t head = m_Head.load(std::memory_order_acquire);
+    if (index >= head || head - index > m_Capacity) return false;
+    size_t slot = index & m_Mask;
+    status = m_Status[slot].load(std::memory_order_acquire);
+    sendTimeNs = m_SendTimeNs[slot].load(std::memory_order_relaxed);
+    rttNs = m_RttNs[slot].load(std::memory_order_relaxed);
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t headAfter = m_Head.load(std::memory_order_relaxed) + 1;
+    return headAfter - index <= m_Capacity;
+}
+
+// Copy a range column by column, then re-check the head: anything the writer
+// may have overwritten while we copied (including the slot it may be writing
+// right now) is removed from the front of out. The status column is read
+// first so a final status guarantees the RTT copied after it is final too.
+void SampleStore::CopyRange(uint64_t from, uint64_t to, SampleColumns& out, unsigned columns) const {
+    if (to - from > m_Capacity) from = to - m_Capacity;
+    size_t count = static_cast<size_t>(to - from);
+
+    if (columns & COLUMN_STATUS) {
+        out.status.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            out.status[i] = m_Status[(from + i) & m_Mask].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+    }
+    if (columns & COLUMN_SEND_TIME) {
+        out.sendTimeNs.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            out.sendTimeNs[i] = m_SendTimeNs[(from + i) & m_Mask].load(std::memory_order_relaxed);
+        }
+    }
+    if (columns & COLUMN_RTT) {
+        out.rttNs.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            out.rttNs[i] = m_RttNs[(from + i) & m_Mask].load(std::memory_order_relaxed);
+        }
+    }
+    if (columns & COLUMN_SEQUENCE) {
+        out.sequence.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            out.sequence[i] = m_Sequence[(from + i) & m_Mask].load(std::memory_order_relaxed);
+        }
+    }
+    if (columns & COLUMN_TIMESTAMP_SOURCE) {
+        out.timestampSource.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            out.timestampSource[i] = m_TimestampSource[(from + i) & m_Mask].load(std::memory_order_relaxed);
+        }
+    }
+    if (columns & COLUMN_INTENDED_TIME) {
+        out.intendedSendNs.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            out.intendedSendNs[i] = m_IntendedSendNs[(from + i) & m_Mask].load(std::memory_order_relaxed);
+        }
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t headAfter = m_Head.load(std::memory_order_relaxed) + 1;
+    uint64_t firstValid = from;
+    if (headAfter > m_Capacity && headAfter - m_Capacity > from) {
+        firstValid = headAfter - m_Capacity;
+        if (firstValid > to) firstValid = to;
+        size_t drop = static_cast<size_t>(firstValid - from);
+        if (!out.status.empty()) out.status.erase(out.status.begin(), out.status.begin() + drop);
+        if (!out.sendTimeNs.empty()) out.sendTimeNs.erase(out.sendTimeNs.begin(), out.sendTimeNs.begin() + drop);
+        if (!out.rttNs.empty()) out.rttNs.erase(out.rttNs.begin(), out.rttNs.begin() + drop);
+        if (!out.sequence.empty()) out.sequence.erase(out.sequence.begin(), out.sequence.begin() + drop);
+        if (!out.timestampSource.empty()) {
+            out.timestampSource.erase(out.timestampSource.begin(), out.timestampSource.begin() + drop);
+        }
+        if (!out.intendedSendNs.empty()) {
+            out.intendedSendNs.erase(out.intendedSendNs.begin(), out.intendedSendNs.begin() + drop);
+        }
+    }
+    out.firstIndex = firstValid;
+}
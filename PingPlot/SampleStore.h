@@ -0,0 +1,119 @@
+#pragma once
+
+#include "Clock.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Fixed ring capacity; must be a power of two and cover the longest history
+const size_t SAMPLE_STORE_CAPACITY = 1 << 17;
+
+// Cache line size used to keep writer and reader state apart
+const size_t CACHE_LINE_SIZE = 64;
+
+// What happened to a probe
+enum class SampleStatus : uint8_t {
+    Pending,     // Sent, no answer yet
+    Ok,          // Answered; RTT is valid
+    Timeout,     // No answer within the timeout
+    Unreachable, // ICMP error instead of an echo reply
+    Duplicate,   // A second reply for an already answered probe
+    Late         // Answered after it had timed out; RTT is valid
+};
+
+// Column selection for snapshots, so readers copy only what they scan
+enum SampleColumn : unsigned {
+    COLUMN_SEND_TIME = 1 << 0,
+    COLUMN_RTT = 1 << 1,
+    COLUMN_SEQUENCE = 1 << 2,
+    COLUMN_STATUS = 1 << 3,
+    COLUMN_TIMESTAMP_SOURCE = 1 << 4,
+    COLUMN_INTENDED_TIME = 1 << 5,
+    COLUMN_ALL = 0x3F
+};
+
+// Struct-of-arrays copy of a range of samples, oldest first. Columns that
+// were not requested are left empty.
+struct SampleColumns {
+    std::vector<int64_t> sendTimeNs; // MonotonicNowNs() at send
+    std::vector<int64_t> rttNs;      // Round trip (time waited for timeouts)
+    std::vector<uint32_t> sequence;  // Probe sequence number
+    std::vector<SampleStatus> status;
+    std::vector<TimestampSource> timestampSource; // Who took the receive time
+    std::vector<int64_t> intendedSendNs; // When the schedule wanted the probe sent
+    uint64_t firstIndex = 0;         // Store index of the first row
+
+    size_t Size() const;
+    void Clear();
+};
+
+// History of probe results shared between the probe thread and readers.
+// Single-producer ring of columns: the probe thread reserves a record when
+// it sends (Begin) and fills it in when the probe finishes (Complete), so the
+// ring stays in send-time order even when replies come back out of order.
+// Nothing on the producer side locks or allocates. Readers copy a range by
+// store index and re-check the head afterwards; a reader that is overtaken
+// simply loses the oldest part of its copy. Only records sent within the
+// history window are visible.
+class SampleStore {
+public:
+    explicit SampleStore(size_t capacity = SAMPLE_STORE_CAPACITY);
+
+    // Reserve a record for a probe that was just sent and trim the visible
+    // window to historyNs before it. intendedSendNs is when its schedule
+    // wanted it sent. Returns the record's store index. Producer thread only.
+    uint64_t Begin(int64_t sendTimeNs, uint32_t sequence, int64_t historyNs, int64_t intendedSendNs);
+
+    // Fill in the result of a record from Begin. Ignored if the record has
+    // already been overwritten. A timed-out record is completed again when
+    // its late reply comes in. Producer thread only.
+    void Complete(uint64_t index, int64_t rttNs, SampleStatus status,
+        TimestampSource source = TimestampSource::Application);
+
+    // Begin + Complete for a probe that already finished, sent when intended
+    void Push(int64_t sendTimeNs, uint32_t sequence, int64_t rttNs, SampleStatus status, int64_t historyNs,
+        TimestampSource source = TimestampSource::Application);
+
+    // Hide all current samples. Producer side only (or while it is stopped).
+    void Clear();
+
+    // Copy the visible history into out, oldest first. columns is a mask of
+    // SampleColumn values.
+    void Snapshot(SampleColumns& out, unsigned columns = COLUMN_ALL) const;
+
+    // Copy records with index >= cursor into out and advance cursor past
+    // them. Records already overwritten are skipped. Returns the number of
+    // records skipped that way.
+    uint64_t ReadFrom(uint64_t& cursor, SampleColumns& out, unsigned columns = COLUMN_ALL) const;
+
+    // Read one record. Returns false if it does not exist yet or has been
+    // overwritten. A Pending status means the probe is still outstanding.
+    bool Read(uint64_t index, int64_t& sendTimeNs, int64_t& rttNs, SampleStatus& status) const;
+
+    // Store index the next record will get
+    uint64_t Head() const { return m_Head.load(std::memory_order_acquire); }
+
+    // First visible store index
+    uint64_t VisibleBegin() const { return m_Visible.load(std::memory_order_acquire); }
+
+    size_t Capacity() const { return m_Capacity; }
+
+private:
+    // Copy [from, to) and drop whatever the writer overwrote meanwhile
+    void CopyRange(uint64_t from, uint64_t to, SampleColumns& out, unsigned columns) const;
+
+    const size_t m_Capacity;
+    const size_t m_Mask;
+    std::unique_ptr<std::atomic<int64_t>[]> m_SendTimeNs;
+    std::unique_ptr<std::atomic<int64_t>[]> m_RttNs;
+    std::unique_ptr<std::atomic<uint32_t>[]> m_Sequence;
+    std::unique_ptr<std::atomic<SampleStatus>[]> m_Status;
+    std::unique_ptr<std::atomic<TimestampSource>[]> m_TimestampSource;
+    std::unique_ptr<std::atomic<int64_t>[]> m_IntendedSendNs;
+
+    // Written by the producer, read by everyone; each on its own line
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> m_Head{0};    // Next index to write
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> m_Visible{0}; // First index readers should see
+};
@@ -0,0 +1,478 @@
+#include "Sampler.h"
+#include "Clock.h"
+#include <limits>
+#include <thread>
+
+namespace {
+
+// Engine options for a run's settings
+ProbeOptions OptionsFor(const SamplerConfig& config) {
+    ProbeOptions options;
+    options.timeoutMs = config.timeoutMs;
+    options.payloadSize = config.payloadSize;
+    options.maxInFlight = config.maxInFlight;
+    options.busyPoll = config.lowJitter;
+    return options;
+}
+
+} // namespace
+
+Sampler::Sampler(ProbeEngine& engine, SampleStore& store, SamplerShared& shared)
+    : m_Engine(engine), m_Recorder(store, shared) {}
+
+// Probe loop shared by the GUI and headless front ends
+bool Sampler::Run(const SamplerConfig& config, const std::atomic<bool>& running) {
+    ProbeOptions options = OptionsFor(config);
+
+    // Resolution happens on the resolver's threads; only the first answer
+    // for a name not yet cached is waited for
+    Resolver& resolver = m_Resolver ? *m_Resolver : DefaultResolver();
+    m_Host = resolver.Watch(config.host);
+    Resolver::Wait(*m_Host, running);
+    if (!running) {
+        m_Host.reset();
+        return true;
+    }
+    std::vector<NetAddress> addresses;
+    std::string error;
+    m_HostGeneration = m_Host->Addresses(addresses, &error);
+    if (addresses.empty()) {
+        m_LastError = "Could not resolve hostname: " + config.host + "\nError: " + error;
+        m_Host.reset();
+        return false;
+    }
+    m_Address = addresses[0];
+
+    if (!m_Engine.Open(options) || !m_Engine.AddTarget(m_Address, m_Target)) {
+        m_LastError = m_Engine.LastError();
+        m_Engine.Close();
+        m_Host.reset();
+        return false;
+    }
+
+    m_Recorder.SetCorrection(config.correctedLatency);
+    m_Recorder.Start();
+
+    // Everything the loops touch is allocated by now, apart from the pending
+    // table, which they fill (and so fault in) before the first send
+    m_LowJitter = config.lowJitter ? EnterLowJitterMode(config.lowJitterCpu) : LowJitterState();
+
+    // The loops change their copy as commands arrive
+    SamplerConfig settings = config;
+    if (config.maxInFlight > 1 || config.adaptiveRate) {
+        RunPipelined(settings, running);
+    } else {
+        RunBlocking(settings, running);
+    }
+
+    // Clean up
+    LeaveLowJitterMode(m_LowJitter);
+    m_Recorder.Finish();
+    m_Engine.Close();
+    m_Host.reset();
+    return true;
+}
+
+// Replies still on their way from the old address are lost with it
+void Sampler::FollowAddress() {
+    NetAddress address = m_Address;
+    if (m_Host->Follow(address, m_HostGeneration) && m_Engine.SetTargetAddress(m_Target, address)) {
+        m_Address = address;
+    }
+}
+
+bool Sampler::ApplyCommands(SamplerConfig& config, ProbeSchedule& schedule, int window) {
+    if (!m_Commands || m_Commands->Empty()) return false;
+
+    // Out-of-range values are dropped here too, so no producer can break
+    // the loop
+    SamplerConfig previous = config;
+    SamplerCommand command;
+    while (m_Commands->Pop(command)) {
+        switch (command.setting) {
+            case SamplerSetting::IntervalUs:
+                if (command.value < 0) break;
+                config.intervalUs = command.value;
+                if (config.adaptiveRate) {
+                    m_Controller.SetTargetRate(command.value > 0 ? 1e6 / command.value : 0.0);
+                } else {
+                    schedule.SetInterval(command.value * 1000, MonotonicNowNs());
+                }
+                break;
+            case SamplerSetting::TimeoutMs:
+                if (command.value <= 0 || command.value > std::numeric_limits<int>::max()) break;
+                config.timeoutMs = static_cast<int>(command.value);
+                break;
+            case SamplerSetting::PayloadSize:
+                if (command.value < 0 || command.value > MAX_PAYLOAD_SIZE) break;
+                config.payloadSize = static_cast<int>(command.value);
+                break;
+            case SamplerSetting::HistoryMs:
+                if (command.value < 1000 || command.value > MAX_HISTORY_SECONDS * 1000) break;
+                m_Recorder.SetWindowSeconds(static_cast<float>(command.value / 1000.0));
+                break;
+        }
+    }
+
+    // An engine that refuses the change keeps probing as before
+    if ((config.timeoutMs != previous.timeoutMs || config.payloadSize != previous.payloadSize) &&
+        !m_Engine.SetOptions(OptionsFor(config))) {
+        config.timeoutMs = previous.timeoutMs;
+        config.payloadSize = previous.payloadSize;
+    }
+    if (config.intervalUs != previous.intervalUs || config.timeoutMs != previous.timeoutMs ||
+        config.payloadSize != previous.payloadSize) {
+        m_Recorder.PublishSettings(config);
+    }
+
+    // A faster schedule or a longer timeout has more probes to remember
+    m_Pending.Grow(ReplyHistory(schedule.IntervalNs(), config.timeoutMs, window));
+    return true;
+}
+
+bool Sampler::UpdateRate(const SamplerConfig& config, ProbeSchedule& schedule, int& window, int64_t nowNs) {
+    if (!config.adaptiveRate || !m_Controller.Due(nowNs)) return false;
+
+    // Depth is sized for most replies, not the median
+    const RunStats& totals = m_Recorder.Totals();
+    int64_t rttNs = static_cast<int64_t>(m_Recorder.Window().p90Ms * 1e6);
+    bool changed = m_Controller.Update(nowNs, totals.Finished(), totals.Lost(), rttNs);
+    m_Recorder.PublishControl(m_Controller);
+    if (!changed) return false;
+
+    schedule.SetInterval(m_Controller.IntervalNs(), nowNs);
+    window = m_Controller.Window();
+    m_Pending.Grow(ReplyHistory(m_Controller.IntervalNs(), config.timeoutMs, config.maxInFlight));
+    return true;
+}
+
+// Long waits go in slices, so a changed interval moves the deadline before
+// it passes
+void Sampler::WaitForSlot(SamplerConfig& config, ProbeSchedule& schedule, const std::atomic<bool>& running) {
+    ApplyCommands(config, schedule, 1);
+    if (m_Commands) {
+        int64_t now = MonotonicNowNs();
+        while (running && schedule.DueNs() - now > SCHEDULE_SLICE_NS) {
+            if (schedule.BusyPoll()) {
+                schedule.WaitUntil(now + SCHEDULE_SLICE_NS, running);
+            } else {
+                std::this_thread::sleep_for(std::chrono::nanoseconds(SCHEDULE_SLICE_NS));
+            }
+            ApplyCommands(config, schedule, 1);
+            now = MonotonicNowNs();
+        }
+    }
+    schedule.WaitUntil(schedule.DueNs(), running);
+}
+
+// Classic loop: send, wait for the matching reply, sleep out the interval
+void Sampler::RunBlocking(SamplerConfig& config, const std::atomic<bool>& running) {
+    m_Pending.Reset(1, ReplyHistory(config.intervalUs * 1000, config.timeoutMs, 1));
+
+    ProbeSchedule schedule;
+    schedule.SetBusyPoll(config.lowJitter);
+    schedule.Start(config.intervalUs * 1000, MonotonicNowNs());
+    uint32_t sequence = 0;
+    while (running) {
+        // Sleep out the interval, counted from the previous send's deadline
+        WaitForSlot(config, schedule, running);
+        if (!running) break;
+        FollowAddress();
+        sequence++;
+
+        int64_t sendTime = 0;
+        if (!m_Engine.Send(m_Target, sequence, sendTime)) {
+            sendTime = MonotonicNowNs();
+            m_Recorder.Record(sendTime, sequence, schedule.Sent(sendTime), 0, SampleStatus::Unreachable);
+            continue;
+        }
+        m_Recorder.Track(m_Pending, m_Recorder.Begin(sendTime, sequence, schedule.Sent(sendTime)));
+
+        // Wait for the reply. Late replies and duplicates for earlier probes
+        // that turn up meanwhile are accounted for on the way.
+        int64_t deadline = sendTime + static_cast<int64_t>(config.timeoutMs) * 1000000;
+        ProbeReply reply;
+        while (m_Pending.Count() > 0) {
+            int64_t remainingNs = deadline - MonotonicNowNs();
+            if (!m_Engine.Receive(reply, remainingNs > 0 && !schedule.BusyPoll() ? remainingNs : 0)) {
+                // A busy-polling wait only ends at the deadline
+                if (schedule.BusyPoll() && remainingNs > 0) continue;
+                break;
+            }
+            m_Recorder.HandleReply(m_Pending, reply);
+        }
+        if (PendingProbes::Entry* probe = m_Pending.Expire(sequence)) {
+            m_Recorder.Complete(*probe, MonotonicNowNs() - probe->sendTimeNs, SampleStatus::Timeout);
+        }
+    }
+}
+
+// Pipelined loop: keep up to maxInFlight probes outstanding and match the
+// replies by sequence number, so the rate follows the send schedule instead
+// of the path RTT. With adaptiveRate the controller sets the schedule and
+// how much of the window is used.
+void Sampler::RunPipelined(SamplerConfig& config, const std::atomic<bool>& running) {
+    int limit = config.maxInFlight < MAX_ENGINE_IN_FLIGHT ? config.maxInFlight : MAX_ENGINE_IN_FLIGHT;
+    int window = limit;
+    config.maxInFlight = limit;
+
+    int64_t timeoutNs = static_cast<int64_t>(config.timeoutMs) * 1000000;
+    int64_t start = MonotonicNowNs();
+    ProbeSchedule schedule;
+    schedule.SetBusyPoll(config.lowJitter);
+    schedule.Start(config.intervalUs * 1000, start);
+    if (config.adaptiveRate) {
+        RateTarget target;
+        target.samplesPerSecond = config.intervalUs > 0 ? 1e6 / config.intervalUs : 0.0;
+        target.cpuPercent = config.cpuBudgetPercent;
+        target.maxInFlight = limit;
+        m_Controller.Start(target, start);
+        m_Recorder.PublishControl(m_Controller);
+        schedule.Start(m_Controller.IntervalNs(), start);
+        window = m_Controller.Window();
+    }
+    m_Pending.Reset(limit, ReplyHistory(schedule.IntervalNs(), config.timeoutMs, limit));
+    uint32_t sequence = 0;
+
+    while (running) {
+        if (ApplyCommands(config, schedule, limit)) {
+            timeoutNs = static_cast<int64_t>(config.timeoutMs) * 1000000;
+        }
+        int64_t now = MonotonicNowNs();
+        UpdateRate(config, schedule, window, now);
+
+        // Expire probes whose reply did not arrive in time
+        while (const PendingProbes::Entry* oldest = m_Pending.Oldest()) {
+            if (oldest->sendTimeNs + timeoutNs > now) break;
+            PendingProbes::Entry* probe = m_Pending.Expire(oldest->sequence);
+            m_Recorder.Complete(*probe, now - probe->sendTimeNs, SampleStatus::Timeout);
+        }
+
+        // Send the next probe when it is due and the window has room. The
+        // schedule keeps to its grid and skips slots instead of bursting to
+        // catch up after a stall.
+        if (schedule.IsDue(now) && m_Pending.Count() < static_cast<size_t>(window)) {
+            // A probe still waiting a whole ring of sequences later (possible
+            // with no interval) is given up on before its slot is reused
+            while (m_Pending.Occupied(sequence + 1)) {
+                PendingProbes::Entry* probe = m_Pending.Expire(m_Pending.Oldest()->sequence);
+                m_Recorder.Complete(*probe, now - probe->sendTimeNs, SampleStatus::Timeout);
+            }
+            FollowAddress();
+            sequence++;
+            int64_t sendTime = 0;
+            if (m_Engine.Send(m_Target, sequence, sendTime)) {
+                m_Recorder.Track(m_Pending, m_Recorder.Begin(sendTime, sequence, schedule.Sent(sendTime)));
+            } else {
+                m_Recorder.Record(now, sequence, schedule.Sent(now), 0, SampleStatus::Unreachable);
+            }
+            continue;
+        }
+
+        // Wait for a reply until the next send or the next timeout is due,
+        // blocking only until the spin window before it
+        int64_t wakeTime = now + timeoutNs;
+        if (m_Pending.Count() < static_cast<size_t>(window) && schedule.DueNs() < wakeTime) {
+            wakeTime = schedule.DueNs();
+        }
+        if (const PendingProbes::Entry* oldest = m_Pending.Oldest()) {
+            if (oldest->sendTimeNs + timeoutNs < wakeTime) wakeTime = oldest->sendTimeNs + timeoutNs;
+        }
+        if (m_Commands && wakeTime - now > SCHEDULE_SLICE_NS) wakeTime = now + SCHEDULE_SLICE_NS;
+        if (config.adaptiveRate && m_Controller.NextUpdateNs() < wakeTime) wakeTime = m_Controller.NextUpdateNs();
+        ProbeReply reply;
+        if (!m_Engine.Receive(reply, schedule.WaitNs(now, wakeTime))) continue;
+        m_Recorder.HandleReply(m_Pending, reply);
+    }
+}
+
+SeriesRecorder::SeriesRecorder(SampleStore& store, SamplerShared& shared)
+    : m_Store(store), m_Shared(shared), m_Stats(store.Capacity()) {}
+
+// Initialize PPS tracking time
+void SeriesRecorder::Start() {
+    m_LastPPSUpdateTime = std::chrono::steady_clock::now();
+    m_LastPPSCount = m_Shared.totalPings.load();
+    m_Totals.Reset();
+    m_Lateness.Clear();
+    m_MaxLatenessNs = 0;
+    m_SkippedSlots = 0;
+    if (m_CorrectedStats) m_CorrectedStats->Reset();
+    m_CorrectedTotals.Reset();
+}
+
+void SeriesRecorder::SetCorrection(bool enabled) {
+    if (!enabled) {
+        m_CorrectedStats.reset();
+    } else if (!m_CorrectedStats) {
+        m_CorrectedStats.reset(new WindowStats(m_Store.Capacity()));
+    }
+}
+
+// Reserve a record; the history window is applied by send time
+void SeriesRecorder::Track(PendingProbes& pending, const PendingProbes::Entry& probe) {
+    PendingProbes::Entry displaced;
+    if (pending.Add(probe, displaced)) {
+        Complete(displaced, probe.sendTimeNs - displaced.sendTimeNs, SampleStatus::Timeout);
+    }
+}
+
+PendingProbes::Entry SeriesRecorder::Begin(int64_t sendTimeNs, uint32_t sequence, const ScheduledSend& slot) {
+    int64_t historyNs = static_cast<int64_t>(m_Shared.historySeconds.load() * 1e9);
+    PendingProbes::Entry probe;
+    probe.sequence = sequence;
+    probe.skippedBefore = slot.skippedBefore;
+    probe.sendTimeNs = sendTimeNs;
+    probe.intendedNs = slot.intendedNs;
+    probe.intervalNs = slot.intervalNs;
+    probe.record = m_Store.Begin(sendTimeNs, sequence, historyNs, slot.intendedNs);
+
+    int64_t latenessNs = sendTimeNs - slot.intendedNs;
+    m_Lateness.Add(latenessNs);
+    if (latenessNs > m_MaxLatenessNs) m_MaxLatenessNs = latenessNs;
+    m_SkippedSlots += slot.skippedBefore;
+    return probe;
+}
+
+// Publish a finished probe and refresh the PPS readout
+void SeriesRecorder::Complete(PendingProbes::Entry& probe, int64_t rttNs, SampleStatus status,
+    TimestampSource source, bool reordered) {
+    int64_t sendTimeNs = probe.sendTimeNs;
+    m_Store.Complete(probe.record, rttNs, status, source);
+    if (status == SampleStatus::Ok) m_Shared.timestamps[static_cast<int>(source)]++;
+
+    // Keep the window figures current so readers never scan the history
+    int64_t historyNs = static_cast<int64_t>(m_Shared.historySeconds.load() * 1e9);
+    probe.windowIndex = m_Stats.Add(sendTimeNs, rttNs, status, historyNs, reordered);
+    PublishWindow();
+    if (m_History) m_History->Add(sendTimeNs, rttNs, status);
+    m_Totals.Add(rttNs, status, reordered);
+    if (m_CorrectedStats) AddCorrected(probe, rttNs, status, historyNs);
+
+    // Increment ping counter regardless of success
+    m_Shared.totalPings++;
+
+    // Calculate pings per second every 1 second
+    auto now = std::chrono::steady_clock::now();
+    auto timeSinceLastUpdate = std::chrono::duration_cast<std::chrono::milliseconds>(now - m_LastPPSUpdateTime).count();
+    if (timeSinceLastUpdate >= 1000) {  // Update PPS once per second
+        unsigned long long currentCount = m_Shared.totalPings.load();
+        unsigned long long countDifference = currentCount - m_LastPPSCount;
+        double secondsElapsed = timeSinceLastUpdate / 1000.0;
+
+        m_Shared.pingsPerSecond = countDifference / secondsElapsed;
+
+        m_LastPPSUpdateTime = now;
+        m_LastPPSCount = currentCount;
+
+        // Run totals are only read now and then, so they share this tick
+        WindowSummary totals;
+        m_Totals.Summarize(totals);
+        m_Shared.totals.Store(totals);
+        if (m_CorrectedStats) {
+            m_CorrectedTotals.Summarize(totals);
+            m_Shared.correctedTotals.Store(totals);
+        }
+        PublishSchedule();
+    }
+
+    MarkUpdated();
+}
+
+ReplyClass SeriesRecorder::HandleReply(PendingProbes& pending, const ProbeReply& reply) {
+    PendingProbes::Entry* probe = nullptr;
+    ReplyClass match = pending.Match(reply.sequence, reply.echoedSendTimeNs, probe);
+    switch (match) {
+        case ReplyClass::OnTime:
+        case ReplyClass::Reordered:
+            Complete(*probe, reply.receiveTimeNs - probe->sendTimeNs, ToSampleStatus(reply.status), reply.timestampSource,
+                match == ReplyClass::Reordered && reply.status == ProbeStatus::Ok);
+            break;
+
+        case ReplyClass::Late:
+            // The record gets the real RTT; the window moves it from lost to late
+            m_Store.Complete(probe->record, reply.receiveTimeNs - probe->sendTimeNs, SampleStatus::Late,
+                reply.timestampSource);
+            m_Stats.MarkLate(probe->windowIndex);
+            m_Totals.MarkLate();
+            PublishWindow();
+            MarkUpdated();
+            break;
+
+        case ReplyClass::Duplicate:
+            m_Stats.AddDuplicate(probe->windowIndex);
+            m_Totals.Add(0, SampleStatus::Duplicate);
+            PublishWindow();
+            MarkUpdated();
+            break;
+
+        case ReplyClass::Unknown:
+            break;
+    }
+    return match;
+}
+
+void SeriesRecorder::PublishWindow() {
+    m_Stats.Summarize(m_Summary);
+    m_Shared.stats.Store(m_Summary);
+}
+
+// Latency as a user on the schedule sees it: measured from the intended
+// send time, plus a sample for every slot a late sender skipped right before
+// this probe. Those would have finished no earlier than this one, so each
+// gets this latency plus its distance from this slot. This is HdrHistogram's
+// expected-interval correction, limited to slots that were really missed.
+void SeriesRecorder::AddCorrected(const PendingProbes::Entry& probe, int64_t rttNs, SampleStatus status,
+    int64_t historyNs) {
+    int64_t correctedNs = probe.sendTimeNs + rttNs - probe.intendedNs;
+    for (uint32_t missed = probe.skippedBefore; missed > 0; missed--) {
+        int64_t offsetNs = static_cast<int64_t>(missed) * probe.intervalNs;
+        m_CorrectedStats->Add(probe.intendedNs - offsetNs, correctedNs + offsetNs, status, historyNs);
+        m_CorrectedTotals.Add(correctedNs + offsetNs, status);
+    }
+    m_CorrectedStats->Add(probe.intendedNs, correctedNs, status, historyNs);
+    m_CorrectedTotals.Add(correctedNs, status);
+    m_CorrectedStats->Summarize(m_CorrectedSummary);
+    m_Shared.correctedStats.Store(m_CorrectedSummary);
+}
+
+void SeriesRecorder::MarkUpdated() {
+    if (!m_Shared.dataUpdated.exchange(true) && m_Shared.notifyUpdate) {
+        m_Shared.notifyUpdate(m_Shared.notifyContext);
+    }
+}
+
+void SeriesRecorder::PublishControl(const RateController& controller) {
+    m_Shared.rateState = controller.State();
+    m_Shared.controlRate = controller.Rate();
+    m_Shared.controlWindow = controller.Window();
+    m_Shared.controlCpuPercent = controller.CpuPercent();
+}
+
+void SeriesRecorder::PublishSettings(const SamplerConfig& config) {
+    if (m_Shared.notifySettings) m_Shared.notifySettings(m_Shared.settingsContext, config, m_Store.Head());
+}
+
+void SeriesRecorder::PublishSchedule() {
+    m_Shared.lateP50Ns = m_Lateness.Percentile(0.5);
+    m_Shared.lateP99Ns = m_Lateness.Percentile(0.99);
+    m_Shared.lateMaxNs = m_MaxLatenessNs;
+    m_Shared.skippedSends = m_SkippedSlots;
+}
+
+void SeriesRecorder::Record(int64_t sendTimeNs, uint32_t sequence, const ScheduledSend& slot, int64_t rttNs,
+    SampleStatus status, TimestampSource source) {
+    PendingProbes::Entry probe = Begin(sendTimeNs, sequence, slot);
+    Complete(probe, rttNs, status, source);
+}
+
+void SeriesRecorder::Finish() {
+    WindowSummary totals;
+    m_Totals.Summarize(totals);
+    m_Shared.totals.Store(totals);
+    if (m_CorrectedStats) {
+        m_CorrectedTotals.Summarize(totals);
+        m_Shared.correctedTotals.Store(totals);
+    }
+    PublishSchedule();
+}
@@ -0,0 +1,264 @@
+#pragma once
+
+#include "LatencyHistogram.h"
+#include "LowJitter.h"
+#include "PendingProbes.h"
+#include "ProbeEngine.h"
+#include "ProbeSchedule.h"
+#include "RateController.h"
+#include "Resolver.h"
+#include "SampleStore.h"
+#include "SamplerCommands.h"
+#include "TieredHistory.h"
+#include "WindowStats.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+
+// Sampling constants
+const float HISTORY_SECONDS = 15.0; // How long to keep data in seconds
+const float MAX_HISTORY_SECONDS = 24.0f * 3600.0f; // Longest window the UI accepts
+const int PING_INTERVAL_MS = 0; // Time from one ping to the next; 0 sends as fast as replies allow
+const int DEFAULT_PING_TIMEOUT_MS = 1000;
+
+// Settings for one sampling run
+struct SamplerConfig {
+    std::string host;
+    int64_t intervalUs = PING_INTERVAL_MS * 1000; // Send period; sends are planned on absolute deadlines
+    int timeoutMs = DEFAULT_PING_TIMEOUT_MS;
+    int payloadSize = 32;
+    int maxInFlight = 1; // 1 = classic send-after-reply loop, >1 = pipelined
+    bool correctedLatency = false; // Also keep stats corrected for coordinated omission
+    bool lowJitter = false; // Pin and prioritize the probe thread, lock memory and busy-poll instead of sleeping
+    int lowJitterCpu = -1;  // CPU for lowJitter; -1 = the highest allowed
+
+    // Let a RateController pick the send rate and pipelining depth:
+    // intervalUs becomes the target rate (0 = as fast as the limits allow),
+    // maxInFlight the deepest pipelining and cpuBudgetPercent, if set, the
+    // probe thread's CPU budget
+    bool adaptiveRate = false;
+    double cpuBudgetPercent = 0.0;
+};
+
+// State shared between the sampler and the UI / reporting side
+struct SamplerShared {
+    std::atomic<float> historySeconds{HISTORY_SECONDS}; // User configurable history length
+
+    std::atomic<unsigned long long> totalPings{0};
+    std::atomic<double> pingsPerSecond{0.0};
+    std::atomic<bool> dataUpdated{false}; // New samples not drawn yet; cleared by the UI as it draws
+    std::atomic<unsigned long long> timestamps[TIMESTAMP_SOURCE_COUNT] = {}; // Answered probes by TimestampSource
+
+    // How late sends were against their schedule; refreshed with the PPS readout
+    std::atomic<int64_t> lateP50Ns{0};
+    std::atomic<int64_t> lateP99Ns{0};
+    std::atomic<int64_t> lateMaxNs{0};
+    std::atomic<unsigned long long> skippedSends{0}; // Slots passed over to stay on schedule
+
+    // Adaptive rate control; refreshed every control period
+    std::atomic<RateState> rateState{RateState::Off};
+    std::atomic<double> controlRate{0.0};       // Probes per second the controller is sending at
+    std::atomic<int> controlWindow{0};          // Probes it lets be in flight
+    std::atomic<double> controlCpuPercent{0.0}; // Probe thread CPU over the last period
+    PublishedStats stats; // Current/avg/min/max/jitter/loss over the history window
+    PublishedStats totals; // The same over the whole run; refreshed once per second and at the end
+
+    // Latency from each probe's intended send time, with the probes a late
+    // sender skipped filled in. Only kept with SamplerConfig::correctedLatency.
+    PublishedStats correctedStats;
+    PublishedStats correctedTotals;
+
+    // Called on the probe thread when dataUpdated goes from false to true,
+    // so a UI that clears the flag as it draws gets one wakeup per frame
+    // however many samples arrive in between. Set before the run starts;
+    // nullptr = the UI polls dataUpdated.
+    void (*notifyUpdate)(void* context) = nullptr;
+    void* notifyContext = nullptr;
+
+    // Called on the probe thread after a command changed the interval,
+    // timeout or payload size, with the store index of the first probe sent
+    // under the new config. Set before the run starts; nullptr = nobody
+    // records settings.
+    void (*notifySettings)(void* context, const SamplerConfig& config, uint64_t firstIndex) = nullptr;
+    void* settingsContext = nullptr;
+
+    // Reset ping counter
+    void Reset() {
+        totalPings = 0;
+        pingsPerSecond = 0.0;
+        dataUpdated = false;
+        for (std::atomic<unsigned long long>& count : timestamps) count = 0;
+        lateP50Ns = 0;
+        lateP99Ns = 0;
+        lateMaxNs = 0;
+        skippedSends = 0;
+        rateState = RateState::Off;
+        controlRate = 0.0;
+        controlWindow = 0;
+        controlCpuPercent = 0.0;
+        stats.Store(WindowSummary());
+        totals.Store(WindowSummary());
+        correctedStats.Store(WindowSummary());
+        correctedTotals.Store(WindowSummary());
+    }
+};
+
+// Map an engine result to the stored sample status
+inline SampleStatus ToSampleStatus(ProbeStatus status) {
+    switch (status) {
+        case ProbeStatus::Ok: return SampleStatus::Ok;
+        case ProbeStatus::Timeout: return SampleStatus::Timeout;
+        case ProbeStatus::Unreachable: return SampleStatus::Unreachable;
+    }
+    return SampleStatus::Unreachable;
+}
+
+// Publishes the probes of one series into its sample store and keeps the PPS
+// readout and window statistics. Used from the thread that owns the series.
+class SeriesRecorder {
+public:
+    SeriesRecorder(SampleStore& store, SamplerShared& shared);
+
+    // Initialize PPS tracking time
+    void Start();
+
+    // Also roll finished probes up into history (optional)
+    void SetHistory(TieredHistory* history) { m_History = history; }
+
+    // Also keep coordinated-omission corrected stats (optional)
+    void SetCorrection(bool enabled);
+
+    // Cover this many seconds with the window stats from the next probe on
+    void SetWindowSeconds(float seconds) { m_Shared.historySeconds = seconds; }
+
+    // Run totals and the latest window figures, for the rate controller
+    const RunStats& Totals() const { return m_Totals; }
+    const WindowSummary& Window() const { return m_Summary; }
+
+    // Publish the rate controller's state
+    void PublishControl(const RateController& controller);
+
+    // Tell SamplerShared::notifySettings that config applies from the next
+    // probe on
+    void PublishSettings(const SamplerConfig& config);
+
+    // Reserve a record for a probe that was just sent for a schedule slot
+    // and count how late it was
+    PendingProbes::Entry Begin(int64_t sendTimeNs, uint32_t sequence, const ScheduledSend& slot);
+
+    // Add a begun probe to pending; a probe it displaces from the ring
+    // counts as timed out
+    void Track(PendingProbes& pending, const PendingProbes::Entry& probe);
+
+    // Count a finished probe and publish its result
+    void Complete(PendingProbes::Entry& probe, int64_t rttNs, SampleStatus status,
+        TimestampSource source = TimestampSource::Application, bool reordered = false);
+
+    // Begin + Complete for a probe that already finished
+    void Record(int64_t sendTimeNs, uint32_t sequence, const ScheduledSend& slot, int64_t rttNs, SampleStatus status,
+        TimestampSource source = TimestampSource::Application);
+
+    // Match a reply against the probes sent and account for it by class:
+    // on-time and reordered replies complete their probe, a late reply
+    // updates the record of a probe that already timed out, and duplicates
+    // are counted. Returns the class.
+    ReplyClass HandleReply(PendingProbes& pending, const ProbeReply& reply);
+
+    // Publish the final run totals once probing has stopped
+    void Finish();
+
+private:
+    // Add a finished probe, and the slots skipped before it, to the
+    // corrected stats
+    void AddCorrected(const PendingProbes::Entry& probe, int64_t rttNs, SampleStatus status, int64_t historyNs);
+
+    // Publish the window figures after a change
+    void PublishWindow();
+
+    // Publish the schedule lateness figures
+    void PublishSchedule();
+
+    // Flag new data for the UI, waking it if it has drawn the last update
+    void MarkUpdated();
+
+    SampleStore& m_Store;
+    SamplerShared& m_Shared;
+    WindowStats m_Stats;
+    WindowSummary m_Summary;
+    RunStats m_Totals;
+    std::unique_ptr<WindowStats> m_CorrectedStats; // Only with correction on
+    WindowSummary m_CorrectedSummary;
+    RunStats m_CorrectedTotals;
+    TieredHistory* m_History = nullptr;
+    LatencyHistogram m_Lateness;
+    int64_t m_MaxLatenessNs = 0;
+    uint64_t m_SkippedSlots = 0;
+    std::chrono::steady_clock::time_point m_LastPPSUpdateTime;
+    unsigned long long m_LastPPSCount = 0;
+};
+
+// Drives a probe engine and feeds the results into a sample store. The host
+// is resolved through a Resolver; the sampler probes its first address and
+// moves to the new first address if a later answer drops the one in use.
+class Sampler {
+public:
+    Sampler(ProbeEngine& engine, SampleStore& store, SamplerShared& shared);
+
+    // Probe until running becomes false. Returns false if the host did not
+    // resolve or the target could not be opened; the reason is available
+    // from LastError().
+    bool Run(const SamplerConfig& config, const std::atomic<bool>& running);
+
+    // Also roll finished probes up into history (optional)
+    void SetHistory(TieredHistory* history) { m_Recorder.SetHistory(history); }
+
+    // Resolve through this resolver instead of DefaultResolver()
+    void SetResolver(Resolver* resolver) { m_Resolver = resolver; }
+
+    // Take interval, timeout, payload size and history changes from this
+    // queue while running (optional). The loop stays up: each change applies
+    // from the next probe, and the pipelined loop expires the probes still
+    // out against the new timeout. With adaptiveRate a new interval is the
+    // controller's new target.
+    void SetCommands(SamplerCommandQueue* commands) { m_Commands = commands; }
+
+    const std::string& LastError() const { return m_LastError; }
+
+    // What SamplerConfig::lowJitter set up for the last run
+    const LowJitterState& LowJitter() const { return m_LowJitter; }
+
+private:
+    // One probe at a time; the next is sent after the reply (or timeout)
+    void RunBlocking(SamplerConfig& config, const std::atomic<bool>& running);
+
+    // Up to maxInFlight probes outstanding, sent on the interval schedule
+    void RunPipelined(SamplerConfig& config, const std::atomic<bool>& running);
+
+    // Apply the commands queued since the last call to config, the schedule
+    // and the engine. Returns true if there were any.
+    bool ApplyCommands(SamplerConfig& config, ProbeSchedule& schedule, int window);
+
+    // Let the rate controller look at the last period if it is due and
+    // move the schedule and window to its new rate. Returns true on a change.
+    bool UpdateRate(const SamplerConfig& config, ProbeSchedule& schedule, int& window, int64_t nowNs);
+
+    // Sleep until the next send is due, applying commands meanwhile
+    void WaitForSlot(SamplerConfig& config, ProbeSchedule& schedule, const std::atomic<bool>& running);
+
+    // Re-point the target if the host's answer no longer has its address
+    void FollowAddress();
+
+    ProbeEngine& m_Engine;
+    SeriesRecorder m_Recorder;
+    std::string m_LastError;
+    int m_Target = 0;
+    PendingProbes m_Pending;
+    Resolver* m_Resolver = nullptr; // nullptr = DefaultResolver()
+    SamplerCommandQueue* m_Commands = nullptr;
+    RateController m_Controller;  // Only with SamplerConfig::adaptiveRate
+    LowJitterState m_LowJitter;
+    std::shared_ptr<ResolvedHost> m_Host;
+    NetAddress m_Address;         // Address being probed
+    uint32_t m_HostGeneration = 0; // Generation of m_Host that m_Address was checked against
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Commands that can wait for a probe loop at once
+const size_t SAMPLER_COMMAND_CAPACITY = 64;
+
+// A setting a running probe loop can change
+enum class SamplerSetting : uint8_t {
+    IntervalUs,  // Send period; 0 = as fast as replies allow
+    TimeoutMs,
+    PayloadSize, // Echo payload bytes
+    HistoryMs    // Window the stats cover
+};
+
+struct SamplerCommand {
+    SamplerSetting setting = SamplerSetting::IntervalUs;
+    int64_t value = 0;
+};
+
+// Single-producer, single-consumer queue of setting changes from the UI or
+// console thread to a running probe loop. Neither side locks or waits: the
+// loop checks it with one atomic load per turn and applies what it finds
+// before its next send, so a change takes effect without stopping the run
+// or losing its history.
+class SamplerCommandQueue {
+public:
+    // Queue a command. Returns false if the loop is
+    // SAMPLER_COMMAND_CAPACITY commands behind.
+    bool Push(const SamplerCommand& command) {
+        uint32_t tail = m_Tail.load(std::memory_order_relaxed);
+        if (tail - m_Head.load(std::memory_order_acquire) >= SAMPLER_COMMAND_CAPACITY) return false;
+        m_Commands[tail % SAMPLER_COMMAND_CAPACITY] = command;
+        m_Tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Empty() const {
+        return m_Head.load(std::memory_order_relaxed) == m_Tail.load(std::memory_order_acquire);
+    }
+
+    // Take the oldest command. Returns false if there is none.
+    bool Pop(SamplerCommand& command) {
+        uint32_t head = m_Head.load(std::memory_order_relaxed);
+        if (head == m_Tail.load(std::memory_order_acquire)) return false;
+        command = m_Commands[head % SAMPLER_COMMAND_CAPACITY];
+        m_Head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Drop whatever is queued; only while no loop consumes
+    void Clear() {
+        m_Head.store(m_Tail.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+private:
+    SamplerCommand m_Commands[SAMPLER_COMMAND_CAPACITY];
+    alignas(64) std::atomic<uint32_t> m_Head{0}; // Next to pop; written by the loop
+    alignas(64) std::atomic<uint32_t> m_Tail{0}; // Next to push; written by the producer
+};
@@ -0,0 +1,409 @@
+#include "SessionFile.h"
+#include "Clock.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// How often the writer looks at the store
+const int SESSION_POLL_INTERVAL_MS = 100;
+
+struct Crc32Table {
+    uint32_t entries[256];
+
+    Crc32Table() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+            }
+            entries[i] = crc;
+        }
+    }
+};
+
+const Crc32Table g_Crc32Table;
+
+uint32_t BlockCrc(uint32_t recordCount, uint64_t firstRecord, const SessionRecord* records) {
+    uint32_t crc = Crc32(0, &recordCount, sizeof(recordCount));
+    crc = Crc32(crc, &firstRecord, sizeof(firstRecord));
+    return Crc32(crc, records, recordCount * sizeof(SessionRecord));
+}
+
+uint32_t SettingsCrc(uint64_t firstRecord, const SessionSettings& settings) {
+    uint32_t crc = Crc32(0, &firstRecord, sizeof(firstRecord));
+    return Crc32(crc, &settings, sizeof(settings));
+}
+
+SessionSettings ToSessionSettings(const SessionInfo& info) {
+    SessionSettings settings;
+    memset(&settings, 0, sizeof(settings));
+    settings.intervalUs = static_cast<uint32_t>(info.intervalUs);
+    settings.timeoutMs = static_cast<uint32_t>(info.timeoutMs);
+    settings.payloadSize = static_cast<uint32_t>(info.payloadSize);
+    settings.maxInFlight = static_cast<uint32_t>(info.maxInFlight);
+    settings.changeNs = MonotonicNowNs();
+    return settings;
+}
+
+// fopen without the MSVC deprecation error
+FILE* CreateBinaryFile(const std::string& path) {
+#ifdef _WIN32
+    FILE* file = nullptr;
+    return fopen_s(&file, path.c_str(), "wb") == 0 ? file : nullptr;
+#else
+    return fopen(path.c_str(), "wb");
+#endif
+}
+
+} // namespace
+
+uint32_t Crc32(uint32_t crc, const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc = g_Crc32Table.entries[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+SessionWriter::~SessionWriter() {
+    Stop();
+}
+
+bool SessionWriter::Start(const std::string& path, const SessionInfo& info, const SampleStore& store) {
+    Stop();
+    m_File = CreateBinaryFile(path);
+    if (!m_File) {
+        m_LastError = "Cannot create " + path;
+        return false;
+    }
+
+    SessionHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SESSION_MAGIC, sizeof(header.magic));
+    header.version = SESSION_VERSION;
+    header.headerSize = sizeof(SessionHeader);
+    header.recordSize = sizeof(SessionRecord);
+    header.intervalMs = static_cast<uint32_t>(info.intervalUs / 1000);
+    header.intervalUs = static_cast<uint32_t>(info.intervalUs);
+    header.timeoutMs = static_cast<uint32_t>(info.timeoutMs);
+    header.payloadSize = static_cast<uint32_t>(info.payloadSize);
+    header.maxInFlight = static_cast<uint32_t>(info.maxInFlight);
+    header.startUnixNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    header.startMonotonicNs = MonotonicNowNs();
+    memcpy(header.host, info.host.c_str(), std::min(info.host.size(), sizeof(header.host) - 1));
+    if (fwrite(&header, sizeof(header), 1, m_File) != 1 || fflush(m_File) != 0) {
+        m_LastError = "Cannot write " + path;
+        fclose(m_File);
+        m_File = nullptr;
+        return false;
+    }
+
+    // Only probes from now on
+    m_Store = &store;
+    m_Cursor = store.Head();
+    m_NextRecord = 0;
+    m_Written = 0;
+    m_Skipped = 0;
+    m_Block.clear();
+    m_Block.reserve(SESSION_BLOCK_RECORDS);
+    m_Unwritten.clear();
+    {
+        std::lock_guard<std::mutex> lock(m_ChangesMutex);
+        m_Changes.clear();
+    }
+    m_Running = true;
+    m_Thread = std::thread(&SessionWriter::Run, this);
+    return true;
+}
+
+void SessionWriter::Stop() {
+    if (m_Thread.joinable()) {
+        m_Running = false;
+        m_Thread.join();
+    }
+    if (m_File) {
+        fclose(m_File);
+        m_File = nullptr;
+    }
+}
+
+void SessionWriter::ChangeSettings(const SessionInfo& info, uint64_t firstIndex) {
+    if (!m_Running) return;
+    std::lock_guard<std::mutex> lock(m_ChangesMutex);
+    m_Changes.push_back({ firstIndex, ToSessionSettings(info) });
+}
+
+void SessionWriter::Run() {
+    auto lastBlock = std::chrono::steady_clock::now();
+    while (m_Running) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(SESSION_POLL_INTERVAL_MS));
+        Collect(false);
+
+        // Partial blocks go out on a timer so a crash loses at most one interval
+        auto now = std::chrono::steady_clock::now();
+        if (!m_Block.empty() && now - lastBlock >= std::chrono::milliseconds(SESSION_FLUSH_INTERVAL_MS)) {
+            WriteBlock();
+            lastBlock = now;
+        }
+    }
+
+    // Whatever is left, including probes that never finished
+    Collect(true);
+    WriteBlock();
+}
+
+void SessionWriter::Collect(bool final) {
+    {
+        std::lock_guard<std::mutex> lock(m_ChangesMutex);
+        m_Unwritten.insert(m_Unwritten.end(), m_Changes.begin(), m_Changes.end());
+        m_Changes.clear();
+    }
+    m_Skipped += m_Store->ReadFrom(m_Cursor, m_Scratch, COLUMN_ALL);
+
+    // Stop at the first outstanding probe; it and everything after it are
+    // read again next time
+    size_t count = m_Scratch.Size();
+    size_t done = count;
+    if (!final) {
+        for (size_t i = 0; i < count; i++) {
+            if (m_Scratch.status[i] == SampleStatus::Pending) {
+                done = i;
+                break;
+            }
+        }
+    }
+
+    size_t change = 0;
+    for (size_t i = 0; i < done; i++) {
+        // Settings go in right before the first record sent under them
+        while (change < m_Unwritten.size() && m_Scratch.firstIndex + i >= m_Unwritten[change].firstIndex) {
+            WriteSettings(m_Unwritten[change++].settings);
+        }
+        SessionRecord record;
+        memset(&record, 0, sizeof(record));
+        record.sendTimeNs = m_Scratch.sendTimeNs[i];
+        record.rttNs = m_Scratch.rttNs[i];
+        record.sequence = m_Scratch.sequence[i];
+        record.status = static_cast<uint8_t>(m_Scratch.status[i]);
+        record.timestampSource = static_cast<uint8_t>(m_Scratch.timestampSource[i]);
+        m_Block.push_back(record);
+        if (m_Block.size() == SESSION_BLOCK_RECORDS) WriteBlock();
+    }
+    m_Cursor = m_Scratch.firstIndex + done;
+
+    // At the end, changes no probe followed still go in
+    if (final) {
+        while (change < m_Unwritten.size()) WriteSettings(m_Unwritten[change++].settings);
+    }
+    m_Unwritten.erase(m_Unwritten.begin(), m_Unwritten.begin() + change);
+}
+
+bool SessionWriter::WriteBlock() {
+    if (m_Block.empty()) return true;
+
+    SessionBlockHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = SESSION_BLOCK_MAGIC;
+    header.recordCount = static_cast<uint32_t>(m_Block.size());
+    header.firstRecord = m_NextRecord;
+    header.crc = BlockCrc(header.recordCount, header.firstRecord, m_Block.data());
+
+    bool ok = fwrite(&header, sizeof(header), 1, m_File) == 1 &&
+        fwrite(m_Block.data(), sizeof(SessionRecord), m_Block.size(), m_File) == m_Block.size() &&
+        fflush(m_File) == 0;
+    if (ok) {
+        m_NextRecord += m_Block.size();
+        m_Written += m_Block.size();
+    } else {
+        m_Skipped += m_Block.size();
+    }
+    m_Block.clear();
+    return ok;
+}
+
+bool SessionWriter::WriteSettings(const SessionSettings& settings) {
+    WriteBlock();
+
+    SessionBlockHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = SESSION_SETTINGS_MAGIC;
+    header.firstRecord = m_NextRecord;
+    header.crc = SettingsCrc(header.firstRecord, settings);
+    return fwrite(&header, sizeof(header), 1, m_File) == 1 &&
+        fwrite(&settings, sizeof(settings), 1, m_File) == 1 && fflush(m_File) == 0;
+}
+
+SessionReader::~SessionReader() {
+    Close();
+}
+
+bool SessionReader::Open(const std::string& path) {
+    Close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        m_LastError = "Cannot open " + path;
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart < (LONGLONG)sizeof(SessionHeader)) {
+        CloseHandle(file);
+        m_LastError = "Not a session file: " + path;
+        return false;
+    }
+    HANDLE mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    const void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if (!view) {
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(file);
+        m_LastError = "Cannot map " + path;
+        return false;
+    }
+    m_FileHandle = file;
+    m_Mapping = mapping;
+    m_Size = static_cast<size_t>(size.QuadPart);
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        m_LastError = "Cannot open " + path;
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(SessionHeader))) {
+        close(fd);
+        m_LastError = "Not a session file: " + path;
+        return false;
+    }
+    void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // The mapping keeps the file alive
+    if (view == MAP_FAILED) {
+        m_LastError = "Cannot map " + path;
+        return false;
+    }
+    m_Size = static_cast<size_t>(info.st_size);
+#endif
+    m_Data = static_cast<const uint8_t*>(view);
+
+    const SessionHeader& header = Header();
+    if (memcmp(header.magic, SESSION_MAGIC, sizeof(header.magic)) != 0 || header.version < 1 ||
+        header.version > SESSION_VERSION ||
+        header.headerSize != sizeof(SessionHeader) || header.recordSize != sizeof(SessionRecord)) {
+        Close();
+        m_LastError = "Not a session file: " + path;
+        return false;
+    }
+
+    // Index the blocks; stop at the first one that is cut off or out of sequence
+    size_t offset = header.headerSize;
+    while (offset + sizeof(SessionBlockHeader) <= m_Size) {
+        const SessionBlockHeader* block = reinterpret_cast<const SessionBlockHeader*>(m_Data + offset);
+
+        // Settings blocks are small enough to check right away
+        if (block->magic == SESSION_SETTINGS_MAGIC) {
+            size_t end = offset + sizeof(SessionBlockHeader) + sizeof(SessionSettings);
+            if (block->recordCount != 0 || block->firstRecord != m_RecordCount || end > m_Size) break;
+            const SessionSettings* settings = reinterpret_cast<const SessionSettings*>(block + 1);
+            if (block->crc != SettingsCrc(block->firstRecord, *settings)) break;
+            m_SettingsChanges.push_back({ block->firstRecord, *settings });
+            offset = end;
+            continue;
+        }
+
+        size_t bytes = static_cast<size_t>(block->recordCount) * sizeof(SessionRecord);
+        if (block->magic != SESSION_BLOCK_MAGIC || block->recordCount == 0 ||
+            block->recordCount > SESSION_BLOCK_RECORDS || block->firstRecord != m_RecordCount ||
+            offset + sizeof(SessionBlockHeader) + bytes > m_Size) {
+            break;
+        }
+        const SessionRecord* records = reinterpret_cast<const SessionRecord*>(m_Data + offset + sizeof(SessionBlockHeader));
+        m_Blocks.push_back({ records, block->recordCount, block->firstRecord });
+        m_RecordCount += block->recordCount;
+        offset += sizeof(SessionBlockHeader) + bytes;
+    }
+
+    // A crash can only tear the block being written last
+    if (!m_Blocks.empty() && !VerifyBlock(m_Blocks.size() - 1)) {
+        m_RecordCount -= m_Blocks.back().count;
+        m_Blocks.pop_back();
+    }
+    return true;
+}
+
+void SessionReader::Close() {
+    if (m_Data) {
+#ifdef _WIN32
+        UnmapViewOfFile(m_Data);
+        CloseHandle(m_Mapping);
+        CloseHandle(m_FileHandle);
+        m_Mapping = nullptr;
+        m_FileHandle = nullptr;
+#else
+        munmap(const_cast<uint8_t*>(m_Data), m_Size);
+#endif
+    }
+    m_Data = nullptr;
+    m_Size = 0;
+    m_Blocks.clear();
+    m_SettingsChanges.clear();
+    m_RecordCount = 0;
+}
+
+const SessionRecord* SessionReader::BlockRecords(size_t block, uint32_t& count) const {
+    if (block >= m_Blocks.size()) {
+        count = 0;
+        return nullptr;
+    }
+    count = m_Blocks[block].count;
+    return m_Blocks[block].records;
+}
+
+bool SessionReader::VerifyBlock(size_t block) const {
+    if (block >= m_Blocks.size()) return false;
+    const Block& entry = m_Blocks[block];
+    const SessionBlockHeader* header = reinterpret_cast<const SessionBlockHeader*>(entry.records) - 1;
+    return header->crc == BlockCrc(entry.count, entry.firstRecord, entry.records);
+}
+
+int64_t SessionReader::FirstSendNs() const {
+    return m_Blocks.empty() ? 0 : m_Blocks.front().records[0].sendTimeNs;
+}
+
+int64_t SessionReader::LastSendNs() const {
+    return m_Blocks.empty() ? 0 : m_Blocks.back().records[m_Blocks.back().count - 1].sendTimeNs;
+}
+
+size_t SessionReader::BlockOf(uint64_t index) const {
+    auto it = std::upper_bound(m_Blocks.begin(), m_Blocks.end(), index,
+        [](uint64_t value, const Block& block) { return value < block.firstRecord; });
+    if (it == m_Blocks.begin()) return 0;
+    size_t block = static_cast<size_t>(it - m_Blocks.begin()) - 1;
+    return index < m_Blocks[block].firstRecord + m_Blocks[block].count ? block : m_Blocks.size();
+}
+
+// Records are in send order, so both searches are binary
+uint64_t SessionReader::LowerBound(int64_t sendTimeNs) const {
+    auto block = std::upper_bound(m_Blocks.begin(), m_Blocks.end(), sendTimeNs,
+        [](int64_t value, const Block& entry) { return value < entry.records[0].sendTimeNs; });
+    if (block != m_Blocks.begin()) --block;
+    for (; block != m_Blocks.end(); ++block) {
+        const SessionRecord* end = block->records + block->count;
+        const SessionRecord* record = std::lower_bound(block->records, end, sendTimeNs,
+            [](const SessionRecord& entry, int64_t value) { return entry.sendTimeNs < value; });
+        if (record != end) return block->firstRecord + static_cast<uint64_t>(record - block->records);
+    }
+    return m_RecordCount;
+}
@@ -0,0 +1,227 @@
+#pragma once
+
+#include "SampleStore.h"
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Session file layout (little-endian, every field 8-byte aligned):
+//   SessionHeader
+//   block, block, ...  where a block is SessionBlockHeader followed by
+//                      recordCount SessionRecords, or (version 2 on) a
+//                      settings block: SessionBlockHeader with
+//                      SESSION_SETTINGS_MAGIC and no records, followed by
+//                      one SessionSettings
+// Blocks are only ever appended. Each carries a CRC32 of its header fields
+// and contents, so after a crash the torn tail is detected and ignored while
+// everything before it stays readable.
+const char SESSION_MAGIC[8] = { 'P', 'P', 'S', 'E', 'S', 'S', 'N', '1' };
+const uint32_t SESSION_VERSION = 2;              // 2 added settings blocks; version 1 files still open
+const uint32_t SESSION_BLOCK_MAGIC = 0x4B4C4250; // "PBLK"
+const uint32_t SESSION_SETTINGS_MAGIC = 0x54455350; // "PSET"
+const uint32_t SESSION_BLOCK_RECORDS = 4096;      // Records per full block
+const int SESSION_FLUSH_INTERVAL_MS = 1000;       // Longest a finished probe waits to hit the file
+
+// What was probed and when; written once at the start of the file. The
+// settings are those at the start; settings blocks record later changes.
+struct SessionHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;     // sizeof(SessionHeader)
+    uint32_t recordSize;     // sizeof(SessionRecord)
+    uint32_t intervalMs;     // Rounded down to whole milliseconds
+    uint32_t timeoutMs;
+    uint32_t payloadSize;
+    uint32_t maxInFlight;
+    uint32_t intervalUs;     // Exact interval; 0 in files written before it was kept
+    int64_t startUnixNs;     // Wall clock at start
+    int64_t startMonotonicNs;// MonotonicNowNs() at start; record times are on this clock
+    char host[200];          // NUL-terminated
+};
+
+struct SessionBlockHeader {
+    uint32_t magic;
+    uint32_t recordCount;
+    uint64_t firstRecord;    // Index of the block's first record in the session
+    uint32_t crc;            // CRC32 of recordCount, firstRecord and the records
+    uint32_t reserved;
+};
+
+// Settings changed during the run. They apply from the block header's
+// firstRecord on, the first probe sent under them.
+struct SessionSettings {
+    uint32_t intervalUs;
+    uint32_t timeoutMs;
+    uint32_t payloadSize;
+    uint32_t maxInFlight;
+    int64_t changeNs;        // MonotonicNowNs() when the change was applied
+};
+
+// One probe, as stored in the file
+struct SessionRecord {
+    int64_t sendTimeNs;
+    int64_t rttNs;
+    uint32_t sequence;
+    uint8_t status;          // SampleStatus
+    uint8_t timestampSource; // TimestampSource of the reply; 0 (application) in older files
+    uint8_t reserved[2];
+};
+
+static_assert(sizeof(SessionHeader) == 256, "SessionHeader layout changed");
+static_assert(sizeof(SessionBlockHeader) == 24, "SessionBlockHeader layout changed");
+static_assert(sizeof(SessionSettings) == 24, "SessionSettings layout changed");
+static_assert(sizeof(SessionRecord) == 24, "SessionRecord layout changed");
+
+// Settings written into the header and settings blocks
+struct SessionInfo {
+    std::string host;
+    int64_t intervalUs = 0;
+    int timeoutMs = 0;
+    int payloadSize = 0;
+    int maxInFlight = 1;
+};
+
+// Appends every finished probe of a SampleStore to a session file from its
+// own thread. It follows the store like any other reader, so the probe thread
+// never waits for the disk. Records are written in store order; the writer
+// holds back from the first probe that is still outstanding until it
+// finishes. Records the store overwrote before they could be written are
+// counted in RecordsSkipped(). Settings changed while it runs go in between
+// the records as settings blocks.
+class SessionWriter {
+public:
+    SessionWriter() = default;
+    ~SessionWriter();
+
+    // Create the file, write the header and start following store
+    bool Start(const std::string& path, const SessionInfo& info, const SampleStore& store);
+
+    // Write everything finished so far and close the file
+    void Stop();
+
+    // Record that info applies from store index firstIndex on (the store's
+    // Head() when the change was made). Any thread; ignored while stopped.
+    void ChangeSettings(const SessionInfo& info, uint64_t firstIndex);
+
+    bool IsRunning() const { return m_Thread.joinable(); }
+    uint64_t RecordsWritten() const { return m_Written.load(); }
+    uint64_t RecordsSkipped() const { return m_Skipped.load(); }
+    const std::string& LastError() const { return m_LastError; }
+
+private:
+    void Run();
+
+    // Copy finished records from the store into the block buffer
+    void Collect(bool final);
+
+    // Append the buffered records as one block
+    bool WriteBlock();
+
+    // A settings change and the store index it applies from
+    struct SettingsChange {
+        uint64_t firstIndex;
+        SessionSettings settings;
+    };
+
+    // Append a settings block; the records buffered so far go out first
+    bool WriteSettings(const SessionSettings& settings);
+
+    const SampleStore* m_Store = nullptr;
+    FILE* m_File = nullptr;
+    std::thread m_Thread;
+    std::atomic<bool> m_Running{false};
+    uint64_t m_Cursor = 0;
+    uint64_t m_NextRecord = 0;
+    SampleColumns m_Scratch;
+    std::vector<SessionRecord> m_Block;
+    std::atomic<uint64_t> m_Written{0};
+    std::atomic<uint64_t> m_Skipped{0};
+    std::string m_LastError;
+    std::mutex m_ChangesMutex;
+    std::vector<SettingsChange> m_Changes;   // Queued by ChangeSettings, guarded by m_ChangesMutex
+    std::vector<SettingsChange> m_Unwritten; // Taken from m_Changes, waiting for their first record
+};
+
+// A settings change as read back: the settings and the first record they
+// apply to
+struct SessionSettingsChange {
+    uint64_t firstRecord;
+    SessionSettings settings;
+};
+
+// Read-only view of a session file through a memory mapping. Opening only
+// walks the block headers, so even a multi-GB file opens at once; records
+// are handed out as pointers into the mapping and never copied.
+class SessionReader {
+public:
+    SessionReader() = default;
+    ~SessionReader();
+
+    bool Open(const std::string& path);
+    void Close();
+
+    bool IsOpen() const { return m_Data != nullptr; }
+    const SessionHeader& Header() const { return *reinterpret_cast<const SessionHeader*>(m_Data); }
+
+    uint64_t RecordCount() const { return m_RecordCount; }
+    size_t BlockCount() const { return m_Blocks.size(); }
+
+    // Settings changes in file order; the header holds the settings before them
+    const std::vector<SessionSettingsChange>& SettingsChanges() const { return m_SettingsChanges; }
+
+    // Records of one block
+    const SessionRecord* BlockRecords(size_t block, uint32_t& count) const;
+
+    // Check a block's CRC; Open only checks the last one
+    bool VerifyBlock(size_t block) const;
+
+    // Send time of the first / last record, 0 when empty
+    int64_t FirstSendNs() const;
+    int64_t LastSendNs() const;
+
+    // Index of the first record sent at or after sendTimeNs
+    uint64_t LowerBound(int64_t sendTimeNs) const;
+
+    // Call f(const SessionRecord&) for records [first, RecordCount())
+    template <typename F>
+    void ForEach(uint64_t first, F f) const {
+        size_t block = BlockOf(first);
+        for (; block < m_Blocks.size(); block++) {
+            const Block& entry = m_Blocks[block];
+            uint32_t begin = first > entry.firstRecord ? static_cast<uint32_t>(first - entry.firstRecord) : 0;
+            for (uint32_t i = begin; i < entry.count; i++) {
+                f(entry.records[i]);
+            }
+        }
+    }
+
+    const std::string& LastError() const { return m_LastError; }
+
+private:
+    struct Block {
+        const SessionRecord* records;
+        uint32_t count;
+        uint64_t firstRecord;
+    };
+
+    // Block that holds record index, or BlockCount() if past the end
+    size_t BlockOf(uint64_t index) const;
+
+    const uint8_t* m_Data = nullptr;
+    size_t m_Size = 0;
+#ifdef _WIN32
+    void* m_FileHandle = nullptr;
+    void* m_Mapping = nullptr;
+#endif
+    std::vector<Block> m_Blocks;
+    std::vector<SessionSettingsChange> m_SettingsChanges;
+    uint64_t m_RecordCount = 0;
+    std::string m_LastError;
+};
+
+// CRC32 (IEEE) continuing from crc; start with 0
+uint32_t Crc32(uint32_t crc, const void* data, size_t size);
@@ -0,0 +1,123 @@
+#include "ProbeEngine.h"
+#include "Clock.h"
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// In-process responder: every accepted probe is answered after a configurable
+// delay, so the whole sampling pipeline can run without touching the network.
+// Replies echo the send time the way a payload would; some can be set to
+// arrive twice.
+class SimulatedEngine : public ProbeEngine {
+public:
+    explicit SimulatedEngine(const SimulatedResponderConfig& config)
+        : m_Config(config), m_Random(config.seed) {}
+
+    bool Open(const ProbeOptions& options) override {
+        m_Options = options;
+        m_Pending.clear();
+        m_Pending.reserve(64);
+        m_TargetCount = 0;
+        return true;
+    }
+
+    // Every address answers the same way
+    bool AddTarget(const NetAddress& /*address*/, int& target) override {
+        target = m_TargetCount++;
+        return true;
+    }
+
+    bool SetTargetAddress(int /*target*/, const NetAddress& /*address*/) override {
+        return true;
+    }
+
+    bool SetOptions(const ProbeOptions& options) override {
+        m_Options.timeoutMs = options.timeoutMs;
+        m_Options.payloadSize = options.payloadSize;
+        return true;
+    }
+
+    bool Send(int target, uint32_t sequence, int64_t& sendTimeNs) override {
+        sendTimeNs = MonotonicNowNs();
+
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        if (m_Config.lossRate > 0.0 && unit(m_Random) < m_Config.lossRate) {
+            return true; // Sent, but the "network" drops it
+        }
+
+        double delayMs = m_Config.baseRttMs;
+        if (m_Config.jitterMs > 0.0) {
+            delayMs += unit(m_Random) * m_Config.jitterMs;
+        }
+        int64_t dueNs = sendTimeNs + static_cast<int64_t>(delayMs * 1000000.0);
+        m_Pending.push_back({ target, sequence, sendTimeNs, dueNs });
+        if (m_Config.duplicateRate > 0.0 && unit(m_Random) < m_Config.duplicateRate) {
+            m_Pending.push_back({ target, sequence, sendTimeNs, dueNs + 1000 });
+        }
+        return true;
+    }
+
+    bool Receive(ProbeReply& reply, int64_t timeoutNs) override {
+        if (m_Pending.empty()) {
+            // Nothing outstanding; behave like a silent network
+            if (timeoutNs > 0) {
+                std::this_thread::sleep_for(std::chrono::nanoseconds(timeoutNs));
+            }
+            return false;
+        }
+
+        // Earliest reply due
+        size_t next = 0;
+        for (size_t i = 1; i < m_Pending.size(); i++) {
+            if (m_Pending[i].dueNs < m_Pending[next].dueNs) next = i;
+        }
+
+        int64_t now = MonotonicNowNs();
+        int64_t deadline = now + timeoutNs;
+        if (m_Pending[next].dueNs > deadline) {
+            std::this_thread::sleep_for(std::chrono::nanoseconds(deadline - now));
+            return false;
+        }
+        if (m_Pending[next].dueNs > now) {
+            std::this_thread::sleep_for(std::chrono::nanoseconds(m_Pending[next].dueNs - now));
+        }
+
+        reply.target = m_Pending[next].target;
+        reply.sequence = m_Pending[next].sequence;
+        reply.status = ProbeStatus::Ok;
+        reply.receiveTimeNs = MonotonicNowNs();
+        reply.echoedSendTimeNs = m_Pending[next].sendTimeNs;
+
+        m_Pending[next] = m_Pending.back();
+        m_Pending.pop_back();
+        return true;
+    }
+
+    void Close() override {
+        m_Pending.clear();
+    }
+
+    const char* Name() const override { return "sim"; }
+
+private:
+    struct PendingReply {
+        int target;
+        uint32_t sequence;
+        int64_t sendTimeNs;
+        int64_t dueNs;
+    };
+
+    SimulatedResponderConfig m_Config;
+    ProbeOptions m_Options;
+    std::mt19937 m_Random;
+    std::vector<PendingReply> m_Pending;
+    int m_TargetCount = 0;
+};
+
+} // namespace
+
+std::unique_ptr<ProbeEngine> CreateSimulatedEngine(const SimulatedResponderConfig& config) {
+    return std::unique_ptr<ProbeEngine>(new SimulatedEngine(config));
+}
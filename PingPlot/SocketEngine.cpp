@@ -0,0 +1,584 @@
+#ifndef _WIN32
+
+#include "ProbeEngine.h"
+#include "Clock.h"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <linux/net_tstamp.h>
+#include <netinet/icmp6.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/ip_icmp.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// Standard internet checksum over the ICMP header and payload
+uint16_t IcmpChecksum(const uint8_t* data, size_t length) {
+    uint32_t sum = 0;
+    for (size_t i = 0; i + 1 < length; i += 2) {
+        sum += (data[i] << 8) | data[i + 1];
+    }
+    if (length & 1) {
+        sum += data[length - 1] << 8;
+    }
+    while (sum >> 16) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    return htons(static_cast<uint16_t>(~sum));
+}
+
+// Replies the kernel stamped longer ago than this are assumed to carry a
+// stamp from before a wall clock step and are stamped in userspace instead
+const int64_t MAX_KERNEL_STAMP_AGE_NS = 10000000000LL;
+
+// Two wall clock reads further apart than this bracket a preemption, which
+// would skew the conversion of a kernel stamp to the monotonic clock
+const int64_t MAX_CLOCK_PAIR_SPREAD_NS = 2000;
+
+int64_t WallNowNs() {
+    timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return static_cast<int64_t>(now.tv_sec) * 1000000000LL + now.tv_nsec;
+}
+
+// Read the monotonic clock together with the matching wall clock time, which
+// is read on both sides of it. Returns false if every try was preempted.
+bool ReadClockPair(int64_t& monotonicNs, int64_t& wallNs) {
+    for (int attempt = 0; attempt < 3; attempt++) {
+        int64_t before = WallNowNs();
+        monotonicNs = MonotonicNowNs();
+        int64_t after = WallNowNs();
+        if (after - before <= MAX_CLOCK_PAIR_SPREAD_NS) {
+            wallNs = before + (after - before) / 2;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Have the kernel stamp every incoming packet. SO_TIMESTAMPING with software
+// receive stamps is preferred; SO_TIMESTAMPNS is the older equivalent.
+bool EnableReceiveTimestamps(int socket) {
+    int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+    if (setsockopt(socket, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) == 0) return true;
+    int enable = 1;
+    return setsockopt(socket, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable)) == 0;
+}
+
+// Find the kernel's receive stamp in a message's control data. Both options
+// stamp with CLOCK_REALTIME.
+bool FindReceiveStamp(msghdr& message, timespec& stamp) {
+    for (cmsghdr* control = CMSG_FIRSTHDR(&message); control; control = CMSG_NXTHDR(&message, control)) {
+        if (control->cmsg_level != SOL_SOCKET) continue;
+        if (control->cmsg_type == SCM_TIMESTAMPING) {
+            // ts[0] is the software stamp; ts[1] is unused, ts[2] is hardware
+            timespec stamps[3];
+            memcpy(stamps, CMSG_DATA(control), sizeof(stamps));
+            stamp = stamps[0];
+            return stamp.tv_sec != 0 || stamp.tv_nsec != 0;
+        }
+        if (control->cmsg_type == SCM_TIMESTAMPNS) {
+            memcpy(&stamp, CMSG_DATA(control), sizeof(stamp));
+            return true;
+        }
+    }
+    return false;
+}
+
+// Fill a socket address for a target
+socklen_t ToSockaddr(const NetAddress& address, sockaddr_storage& out) {
+    memset(&out, 0, sizeof(out));
+    if (address.family == 6) {
+        sockaddr_in6* v6 = reinterpret_cast<sockaddr_in6*>(&out);
+        v6->sin6_family = AF_INET6;
+        memcpy(&v6->sin6_addr, address.bytes, 16);
+        return sizeof(sockaddr_in6);
+    }
+    sockaddr_in* v4 = reinterpret_cast<sockaddr_in*>(&out);
+    v4->sin_family = AF_INET;
+    memcpy(&v4->sin_addr, address.bytes, 4);
+    return sizeof(sockaddr_in);
+}
+
+NetAddress FromIpv4(const void* bytes) {
+    NetAddress address;
+    address.family = 4;
+    memcpy(address.bytes, bytes, 4);
+    return address;
+}
+
+NetAddress FromIpv6(const void* bytes) {
+    NetAddress address;
+    address.family = 6;
+    memcpy(address.bytes, bytes, 16);
+    return address;
+}
+
+// Microseconds a busy-polling socket spins on the device queue per receive
+const int SOCKET_BUSY_POLL_US = 50;
+
+// Fixed part of an IPv6 header; ICMPv6 errors quote the original one
+const size_t IPV6_HEADER_LENGTH = 40;
+const size_t IPV6_DESTINATION_OFFSET = 24;
+
+// Linux backend using ICMP sockets, one per address family (ICMP for IPv4,
+// ICMPv6 for IPv6), each opened when the first target of its family is
+// added. Unprivileged SOCK_DGRAM sockets are preferred
+// (net.ipv4.ping_group_range); SOCK_RAW is used as a fallback when the
+// process has CAP_NET_RAW but datagram ICMP is disabled. The sockets are
+// non-blocking and waited on with one epoll, so any number of probes can be
+// in flight. Replies carry the kernel's arrival stamp when the socket
+// supports receive timestamps.
+class SocketEngine : public ProbeEngine {
+public:
+    ~SocketEngine() override {
+        Close();
+    }
+
+    bool Open(const ProbeOptions& options) override {
+        Close();
+        m_Options = options;
+
+        m_Epoll = epoll_create1(0);
+        if (m_Epoll < 0) {
+            m_LastError = std::string("Failed to set up epoll: ") + strerror(errno);
+            return false;
+        }
+
+        // Datagram sockets have their identifier rewritten by the kernel and
+        // only see their own replies; raw sockets must filter on it.
+        m_Identifier = static_cast<uint16_t>(getpid() & 0xFFFF);
+
+        FillSendBuffer(options.payloadSize);
+        m_RunId = NewProbeRunId();
+        m_ReceiveBuffer.assign(65536, 0);
+        return true;
+    }
+
+    bool AddTarget(const NetAddress& address, int& target) override {
+        if (!OpenFamily(address.family)) return false;
+        target = static_cast<int>(m_Targets.size());
+        m_Targets.push_back(Target());
+        SetAddress(target, address);
+        return true;
+    }
+
+    bool SetTargetAddress(int target, const NetAddress& address) override {
+        if (!OpenFamily(address.family)) return false;
+        const NetAddress previous = m_Targets[target].address;
+        auto it = m_TargetByAddress.find(previous);
+        if (it != m_TargetByAddress.end() && it->second == target) {
+            m_TargetByAddress.erase(it);
+            // Another target on the old address takes its replies over
+            for (size_t i = 0; i < m_Targets.size(); i++) {
+                if (static_cast<int>(i) != target && m_Targets[i].address == previous) {
+                    m_TargetByAddress.emplace(previous, static_cast<int>(i));
+                    break;
+                }
+            }
+        }
+        SetAddress(target, address);
+        return true;
+    }
+
+    // Replies are matched by their payload header, so probes of the old
+    // size still in flight are recognized
+    bool SetOptions(const ProbeOptions& options) override {
+        if (options.payloadSize < 0 || options.payloadSize > MAX_PAYLOAD_SIZE) {
+            m_LastError = "Bad payload size";
+            return false;
+        }
+        m_Options.timeoutMs = options.timeoutMs;
+        if (options.payloadSize != m_Options.payloadSize) {
+            m_Options.payloadSize = options.payloadSize;
+            FillSendBuffer(options.payloadSize);
+        }
+        return true;
+    }
+
+    bool Send(int target, uint32_t sequence, int64_t& sendTimeNs) override {
+        Target& destination = m_Targets[target];
+        destination.newestSequence = sequence;
+        sendTimeNs = MonotonicNowNs();
+
+        // The kernel computes the ICMPv6 checksum itself
+        bool v6 = destination.address.family == 6;
+        icmphdr* header = reinterpret_cast<icmphdr*>(m_SendBuffer.data());
+        header->type = ICMP_ECHO;
+        if (v6) header->type = ICMP6_ECHO_REQUEST;
+        header->code = 0;
+        header->un.echo.id = htons(m_Identifier);
+        header->un.echo.sequence = htons(static_cast<uint16_t>(sequence));
+        WriteProbePayload(m_SendBuffer.data() + sizeof(icmphdr), m_SendBuffer.size() - sizeof(icmphdr), m_RunId,
+            sequence, sendTimeNs);
+        header->checksum = 0;
+        if (!v6) header->checksum = IcmpChecksum(m_SendBuffer.data(), m_SendBuffer.size());
+
+        ssize_t sent = sendto(m_Sockets[v6 ? 1 : 0].fd, m_SendBuffer.data(), m_SendBuffer.size(), 0,
+            reinterpret_cast<const sockaddr*>(&destination.sockaddr), destination.sockaddrLength);
+        if (sent < 0) {
+            // A full send buffer just loses this probe; it will time out
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) return true;
+            m_LastError = std::string("sendto failed: ") + strerror(errno);
+            return false;
+        }
+        return true;
+    }
+
+    bool Receive(ProbeReply& reply, int64_t timeoutNs) override {
+        int64_t deadline = MonotonicNowNs() + timeoutNs;
+
+        for (;;) {
+            // Drain whatever is already queued before sleeping, taking turns
+            // between the sockets so neither family starves the other
+            bool drained = true;
+            for (int i = 0; i < 2; i++) {
+                int family = (m_NextRead + i) & 1;
+                if (m_Sockets[family].fd < 0) continue;
+                ReadResult result = ReadOne(family, reply);
+                if (result == ReadResult::Reply) {
+                    m_NextRead = family ^ 1;
+                    return true;
+                }
+                if (result == ReadResult::Error) return false;
+                if (result == ReadResult::Other) drained = false;
+            }
+            if (!drained) continue;
+
+            int64_t remainingNs = deadline - MonotonicNowNs();
+            if (remainingNs <= 0) return false;
+
+            // epoll_wait counts whole milliseconds: wait those out, then let
+            // the timer end the last one exactly
+            int remainingMs = static_cast<int>(remainingNs / 1000000);
+            if (remainingMs == 0 && !ArmTimer(remainingNs)) remainingMs = 1;
+
+            epoll_event event;
+            int ready = epoll_wait(m_Epoll, &event, 1, remainingMs > 0 ? remainingMs : -1);
+            if (ready < 0 && errno != EINTR) return false;
+            if (ready > 0 && event.data.fd == m_Timer) {
+                // Clear the expiry; the deadline check above ends the wait
+                uint64_t expirations = 0;
+                if (read(m_Timer, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN) return false;
+            }
+        }
+    }
+
+    void Close() override {
+        if (m_Timer >= 0) {
+            close(m_Timer);
+            m_Timer = -1;
+        }
+        if (m_Epoll >= 0) {
+            close(m_Epoll);
+            m_Epoll = -1;
+        }
+        for (FamilySocket& socket : m_Sockets) {
+            if (socket.fd >= 0) close(socket.fd);
+            socket = FamilySocket();
+        }
+        m_Targets.clear();
+        m_TargetByAddress.clear();
+    }
+
+    const char* Name() const override { return m_Sockets[0].raw || m_Sockets[1].raw ? "socket(raw)" : "socket"; }
+
+private:
+    // ICMP socket of one address family
+    struct FamilySocket {
+        int fd = -1;
+        bool raw = false;
+        bool kernelTimestamps = false;
+    };
+
+    struct Target {
+        NetAddress address;
+        sockaddr_storage sockaddr;
+        socklen_t sockaddrLength = 0;
+        uint32_t newestSequence = 0; // Last sequence sent to it
+    };
+
+    enum class ReadResult {
+        Reply, // reply was filled in
+        Other, // A packet that is not one of ours
+        Empty, // Nothing queued
+        Error
+    };
+
+    // Echo header space and filler for payloadSize bytes. Send fills in the
+    // header and payload header per probe; ICMP and ICMPv6 echo headers
+    // share one layout.
+    void FillSendBuffer(int payloadSize) {
+        m_SendBuffer.assign(sizeof(icmphdr) + payloadSize, 0);
+        static const char pattern[] = "PingPlotData";
+        for (int i = 0; i < payloadSize; i++) {
+            m_SendBuffer[sizeof(icmphdr) + i] = pattern[i % (sizeof(pattern) - 1)];
+        }
+    }
+
+    // Make the timer fire in delayNs, creating it on first use. Returns
+    // false if there is no timer; the wait then rounds up to 1 ms.
+    bool ArmTimer(int64_t delayNs) {
+        if (m_Timer < 0) {
+            m_Timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+            if (m_Timer < 0) return false;
+            epoll_event event = {};
+            event.events = EPOLLIN;
+            event.data.fd = m_Timer;
+            if (epoll_ctl(m_Epoll, EPOLL_CTL_ADD, m_Timer, &event) != 0) {
+                close(m_Timer);
+                m_Timer = -1;
+                return false;
+            }
+        }
+        // Re-arming also clears an expiry nobody read
+        itimerspec delay = {};
+        delay.it_value.tv_sec = static_cast<time_t>(delayNs / 1000000000);
+        delay.it_value.tv_nsec = static_cast<long>(delayNs % 1000000000);
+        return timerfd_settime(m_Timer, 0, &delay, nullptr) == 0;
+    }
+
+    // Open the socket for an address family unless it is open already
+    bool OpenFamily(uint8_t family) {
+        if (family != 4 && family != 6) {
+            m_LastError = "Not an IPv4 or IPv6 address";
+            return false;
+        }
+        FamilySocket& socket = m_Sockets[family == 6 ? 1 : 0];
+        if (socket.fd >= 0) return true;
+
+        int domain = AF_INET;
+        int protocol = IPPROTO_ICMP;
+        if (family == 6) {
+            domain = AF_INET6;
+            protocol = IPPROTO_ICMPV6;
+        }
+        socket.raw = false;
+        socket.fd = ::socket(domain, SOCK_DGRAM, protocol);
+        if (socket.fd < 0 && (errno == EACCES || errno == EPERM)) {
+            socket.raw = true;
+            socket.fd = ::socket(domain, SOCK_RAW, protocol);
+        }
+        if (socket.fd < 0) {
+            m_LastError = std::string(family == 6 ? "Failed to create ICMPv6 socket: " : "Failed to create ICMP socket: ") +
+                strerror(errno) + "\nAllow unprivileged ICMP with sysctl net.ipv4.ping_group_range";
+            return false;
+        }
+
+        fcntl(socket.fd, F_SETFL, fcntl(socket.fd, F_GETFL, 0) | O_NONBLOCK);
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = socket.fd;
+        if (epoll_ctl(m_Epoll, EPOLL_CTL_ADD, socket.fd, &event) != 0) {
+            m_LastError = std::string("Failed to set up epoll: ") + strerror(errno);
+            close(socket.fd);
+            socket = FamilySocket();
+            return false;
+        }
+
+        // A raw ICMPv6 socket sees all ICMPv6 traffic; keep only what Parse reads
+        if (socket.raw && family == 6) {
+            icmp6_filter filter;
+            ICMP6_FILTER_SETBLOCKALL(&filter);
+            ICMP6_FILTER_SETPASS(ICMP6_ECHO_REPLY, &filter);
+            ICMP6_FILTER_SETPASS(ICMP6_DST_UNREACH, &filter);
+            setsockopt(socket.fd, IPPROTO_ICMPV6, ICMP6_FILTER, &filter, sizeof(filter));
+        }
+
+        // Room for bursts of replies when many probes are in flight
+        int receiveBufferSize = 1 << 20;
+        setsockopt(socket.fd, SOL_SOCKET, SO_RCVBUF, &receiveBufferSize, sizeof(receiveBufferSize));
+
+        // Let the kernel poll the device queue on receive instead of waiting
+        // for its interrupt. Raising it above the sysctl default needs
+        // CAP_NET_ADMIN; without that the interrupt path is kept.
+        if (m_Options.busyPoll) {
+            int busyPollUs = SOCKET_BUSY_POLL_US;
+            setsockopt(socket.fd, SOL_SOCKET, SO_BUSY_POLL, &busyPollUs, sizeof(busyPollUs));
+        }
+
+        // Kernel arrival stamps keep the wakeup and scheduling delay of this
+        // thread out of the RTT
+        socket.kernelTimestamps = EnableReceiveTimestamps(socket.fd);
+        return true;
+    }
+
+    // Point a target at an address and route that address's replies to it.
+    // Replies are attributed by source address; the first target with a
+    // given address receives them.
+    void SetAddress(int target, const NetAddress& address) {
+        Target& entry = m_Targets[target];
+        entry.address = address;
+        entry.sockaddrLength = ToSockaddr(address, entry.sockaddr);
+        m_TargetByAddress.emplace(address, target);
+    }
+
+    // Read one packet from a family's socket
+    ReadResult ReadOne(int family, ProbeReply& reply) {
+        const FamilySocket& socket = m_Sockets[family];
+        sockaddr_storage source = {};
+        iovec buffer = { m_ReceiveBuffer.data(), m_ReceiveBuffer.size() };
+        msghdr message = {};
+        message.msg_name = &source;
+        message.msg_namelen = sizeof(source);
+        message.msg_iov = &buffer;
+        message.msg_iovlen = 1;
+        message.msg_control = m_Control;
+        message.msg_controllen = sizeof(m_Control);
+        ssize_t length = recvmsg(socket.fd, &message, 0);
+        if (length < 0) {
+            if (errno == EINTR) return ReadResult::Other;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return ReadResult::Empty;
+            m_LastError = std::string("recv failed: ") + strerror(errno);
+            return ReadResult::Error;
+        }
+
+        int64_t receiveTime = 0;
+        int64_t wallTime = 0;
+        bool paired = socket.kernelTimestamps && ReadClockPair(receiveTime, wallTime);
+        if (!paired) receiveTime = MonotonicNowNs();
+        bool parsed = family == 1
+            ? ParseReplyV6(m_ReceiveBuffer.data(), static_cast<size_t>(length), source, socket.raw, reply)
+            : ParseReplyV4(m_ReceiveBuffer.data(), static_cast<size_t>(length), source, socket.raw, reply);
+        if (!parsed) return ReadResult::Other;
+        reply.receiveTimeNs = receiveTime;
+        reply.timestampSource = TimestampSource::Application;
+        if (paired) ApplyKernelStamp(message, wallTime, reply);
+        return ReadResult::Reply;
+    }
+
+    // Move receiveTimeNs back to the kernel's arrival stamp. The stamp is on
+    // the wall clock, so only its age at pickup (wallNs, read together with
+    // receiveTimeNs) is carried over to the monotonic clock.
+    void ApplyKernelStamp(msghdr& message, int64_t wallNs, ProbeReply& reply) const {
+        timespec stamp;
+        if (!FindReceiveStamp(message, stamp)) return;
+        int64_t ageNs = wallNs - (static_cast<int64_t>(stamp.tv_sec) * 1000000000LL + stamp.tv_nsec);
+        if (ageNs < 0 || ageNs > MAX_KERNEL_STAMP_AGE_NS) return;
+        reply.receiveTimeNs -= ageNs;
+        reply.timestampSource = TimestampSource::Kernel;
+    }
+
+    // Map a reply's address back to a target index
+    bool LookupTarget(const NetAddress& address, int& target) const {
+        auto it = m_TargetByAddress.find(address);
+        if (it == m_TargetByAddress.end()) return false;
+        target = it->second;
+        return true;
+    }
+
+    // Take the full sequence and send time from an echoed payload, or widen
+    // the header's sequence when the payload did not come back
+    void ReadSequence(const uint8_t* payload, size_t length, uint16_t headerSequence, ProbeReply& reply) const {
+        reply.echoedSendTimeNs = 0;
+        if (!ReadProbePayload(payload, length, m_RunId, reply.sequence, reply.echoedSendTimeNs) ||
+            static_cast<uint16_t>(reply.sequence) != headerSequence) {
+            reply.sequence = ExtendSequence(m_Targets[reply.target].newestSequence, headerSequence);
+            reply.echoedSendTimeNs = 0;
+        }
+    }
+
+    // Decode an ICMP packet. Raw sockets deliver the IP header as well.
+    bool ParseReplyV4(const uint8_t* data, size_t length, const sockaddr_storage& from, bool raw, ProbeReply& reply) const {
+        NetAddress source = FromIpv4(&reinterpret_cast<const sockaddr_in*>(&from)->sin_addr);
+        if (raw) {
+            if (length < sizeof(iphdr)) return false;
+            source = FromIpv4(&reinterpret_cast<const iphdr*>(data)->saddr);
+            size_t ipLength = (data[0] & 0x0F) * 4;
+            if (length < ipLength) return false;
+            data += ipLength;
+            length -= ipLength;
+        }
+        if (length < sizeof(icmphdr)) return false;
+
+        const icmphdr* header = reinterpret_cast<const icmphdr*>(data);
+        if (header->type == ICMP_ECHOREPLY) {
+            if (raw && ntohs(header->un.echo.id) != m_Identifier) return false;
+            if (!LookupTarget(source, reply.target)) return false;
+            ReadSequence(data + sizeof(icmphdr), length - sizeof(icmphdr), ntohs(header->un.echo.sequence), reply);
+            reply.status = ProbeStatus::Ok;
+            return true;
+        }
+
+        // Destination unreachable carries the original IP + ICMP header and
+        // usually too little of the payload to read back
+        if (raw && header->type == ICMP_DEST_UNREACH) {
+            const uint8_t* inner = data + sizeof(icmphdr);
+            size_t innerLength = length - sizeof(icmphdr);
+            if (innerLength < sizeof(iphdr)) return false;
+            size_t innerIpLength = (inner[0] & 0x0F) * 4;
+            if (innerLength < innerIpLength + 8) return false;
+            const icmphdr* original = reinterpret_cast<const icmphdr*>(inner + innerIpLength);
+            if (original->type != ICMP_ECHO || ntohs(original->un.echo.id) != m_Identifier) return false;
+            if (!LookupTarget(FromIpv4(&reinterpret_cast<const iphdr*>(inner)->daddr), reply.target)) return false;
+            const uint8_t* originalPayload = inner + innerIpLength + sizeof(icmphdr);
+            size_t originalLength = innerLength - innerIpLength - sizeof(icmphdr);
+            ReadSequence(originalPayload, originalLength, ntohs(original->un.echo.sequence), reply);
+            reply.status = ProbeStatus::Unreachable;
+            return true;
+        }
+        return false;
+    }
+
+    // Decode an ICMPv6 packet. Both socket types start at the ICMPv6 header.
+    bool ParseReplyV6(const uint8_t* data, size_t length, const sockaddr_storage& from, bool raw, ProbeReply& reply) const {
+        if (length < sizeof(icmphdr)) return false;
+        NetAddress source = FromIpv6(&reinterpret_cast<const sockaddr_in6*>(&from)->sin6_addr);
+
+        const icmphdr* header = reinterpret_cast<const icmphdr*>(data);
+        if (header->type == ICMP6_ECHO_REPLY) {
+            if (raw && ntohs(header->un.echo.id) != m_Identifier) return false;
+            if (!LookupTarget(source, reply.target)) return false;
+            ReadSequence(data + sizeof(icmphdr), length - sizeof(icmphdr), ntohs(header->un.echo.sequence), reply);
+            reply.status = ProbeStatus::Ok;
+            return true;
+        }
+
+        // Destination unreachable quotes the original IPv6 header (assumed
+        // to have no extension headers) and ICMPv6 header
+        if (raw && header->type == ICMP6_DST_UNREACH) {
+            const uint8_t* inner = data + sizeof(icmphdr);
+            size_t innerLength = length - sizeof(icmphdr);
+            if (innerLength < IPV6_HEADER_LENGTH + sizeof(icmphdr)) return false;
+            const icmphdr* original = reinterpret_cast<const icmphdr*>(inner + IPV6_HEADER_LENGTH);
+            if (original->type != ICMP6_ECHO_REQUEST || ntohs(original->un.echo.id) != m_Identifier) return false;
+            if (!LookupTarget(FromIpv6(inner + IPV6_DESTINATION_OFFSET), reply.target)) return false;
+            const uint8_t* originalPayload = inner + IPV6_HEADER_LENGTH + sizeof(icmphdr);
+            size_t originalLength = innerLength - IPV6_HEADER_LENGTH - sizeof(icmphdr);
+            ReadSequence(originalPayload, originalLength, ntohs(original->un.echo.sequence), reply);
+            reply.status = ProbeStatus::Unreachable;
+            return true;
+        }
+        return false;
+    }
+
+    ProbeOptions m_Options;
+    std::vector<Target> m_Targets;
+    std::unordered_map<NetAddress, int, NetAddressHash> m_TargetByAddress;
+    FamilySocket m_Sockets[2]; // IPv4, IPv6
+    int m_Epoll = -1;
+    int m_Timer = -1;          // timerfd in the epoll set for waits under 1 ms
+    int m_NextRead = 0;        // Socket Receive tries first
+    uint16_t m_Identifier = 0;
+    uint32_t m_RunId = 0; // Identifies this engine's probes in their payload
+    std::vector<uint8_t> m_SendBuffer;
+    std::vector<uint8_t> m_ReceiveBuffer;
+    alignas(cmsghdr) uint8_t m_Control[256]; // Ancillary data (receive stamps) from recvmsg
+};
+
+} // namespace
+
+std::unique_ptr<ProbeEngine> CreateSocketEngine() {
+    return std::unique_ptr<ProbeEngine>(new SocketEngine());
+}
+
+#endif // !_WIN32
@@ -0,0 +1,182 @@
+#include "TieredHistory.h"
+#include "LatencyHistogram.h"
+#include <cmath>
+
+namespace {
+
+int HistogramBin(int64_t rttNs) {
+    uint64_t us = rttNs > 0 ? static_cast<uint64_t>(rttNs) / 1000 : 0;
+    if (us == 0) return 0;
+    int bin = HighestBit(us) + 1;
+    return bin < TIER_HISTOGRAM_BINS ? bin : TIER_HISTOGRAM_BINS - 1;
+}
+
+} // namespace
+
+double TierSummary::AverageMs() const {
+    return count ? sumMs / count : 0.0;
+}
+
+double TierSummary::JitterMs() const {
+    if (count == 0) return 0.0;
+    double mean = sumMs / count;
+    double variance = sumSquaresMs / count - mean * mean;
+    return variance > 0.0 ? std::sqrt(variance) : 0.0;
+}
+
+double TierSummary::PercentileMs(double q) const {
+    if (count == 0) return 0.0;
+    uint64_t rank = static_cast<uint64_t>(q * count + 0.5);
+    if (rank < 1) rank = 1;
+    uint64_t seen = 0;
+    for (int bin = 0; bin < TIER_HISTOGRAM_BINS; bin++) {
+        seen += histogram[bin];
+        if (seen >= rank) {
+            return bin == 0 ? 0.0005 : std::ldexp(1.5, bin - 1) / 1000.0;
+        }
+    }
+    return maxRttNs / 1e6;
+}
+
+TieredHistory::TieredHistory() {
+    for (int tier = 0; tier < TIER_COUNT; tier++) {
+        m_Tiers[tier].reset(new Bucket[TIER_BUCKET_COUNT[tier]]);
+    }
+    Clear();
+}
+
+void TieredHistory::Clear() {
+    for (int tier = 0; tier < TIER_COUNT; tier++) {
+        for (size_t i = 0; i < TIER_BUCKET_COUNT[tier]; i++) {
+            Bucket& bucket = m_Tiers[tier][i];
+            bucket.bucket.store(-1, std::memory_order_relaxed);
+            bucket.count.store(0, std::memory_order_relaxed);
+            bucket.lost.store(0, std::memory_order_relaxed);
+            for (int bin = 0; bin < TIER_HISTOGRAM_BINS; bin++) {
+                bucket.histogram[bin].store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void TieredHistory::Add(int64_t sendTimeNs, int64_t rttNs, SampleStatus status) {
+    if (status == SampleStatus::Pending || status == SampleStatus::Duplicate) return;
+    bool answered = (status == SampleStatus::Ok);
+    double rttMs = rttNs / 1e6;
+    int bin = HistogramBin(rttNs);
+
+    for (int tier = 0; tier < TIER_COUNT; tier++) {
+        int64_t id = sendTimeNs / TIER_BUCKET_NS[tier];
+        Bucket& bucket = m_Tiers[tier][static_cast<size_t>(id) & (TIER_BUCKET_COUNT[tier] - 1)];
+        int64_t held = bucket.bucket.load(std::memory_order_relaxed);
+        if (held > id) continue; // Finished so late its slot has moved on
+
+        uint32_t version = bucket.version.load(std::memory_order_relaxed);
+        bucket.version.store(version + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        if (held < id) {
+            // Reuse the slot for the new bucket
+            bucket.bucket.store(id, std::memory_order_relaxed);
+            bucket.count.store(0, std::memory_order_relaxed);
+            bucket.lost.store(0, std::memory_order_relaxed);
+            bucket.sumMs.store(0.0, std::memory_order_relaxed);
+            bucket.sumSquaresMs.store(0.0, std::memory_order_relaxed);
+            for (int i = 0; i < TIER_HISTOGRAM_BINS; i++) {
+                bucket.histogram[i].store(0, std::memory_order_relaxed);
+            }
+        }
+
+        // Only this thread writes, so plain load + store is enough
+        if (answered) {
+            uint32_t count = bucket.count.load(std::memory_order_relaxed);
+            if (count == 0 || rttNs < bucket.minRttNs.load(std::memory_order_relaxed)) {
+                bucket.minRttNs.store(rttNs, std::memory_order_relaxed);
+            }
+            if (count == 0 || rttNs > bucket.maxRttNs.load(std::memory_order_relaxed)) {
+                bucket.maxRttNs.store(rttNs, std::memory_order_relaxed);
+            }
+            bucket.count.store(count + 1, std::memory_order_relaxed);
+            bucket.sumMs.store(bucket.sumMs.load(std::memory_order_relaxed) + rttMs, std::memory_order_relaxed);
+            bucket.sumSquaresMs.store(bucket.sumSquaresMs.load(std::memory_order_relaxed) + rttMs * rttMs,
+                std::memory_order_relaxed);
+            bucket.histogram[bin].store(bucket.histogram[bin].load(std::memory_order_relaxed) + 1,
+                std::memory_order_relaxed);
+        } else {
+            bucket.lost.store(bucket.lost.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+
+        bucket.version.store(version + 2, std::memory_order_release);
+    }
+}
+
+bool TieredHistory::Read(int tier, int64_t id, TierSummary& out) const {
+    if (tier < 0 || tier >= TIER_COUNT || id < 0) return false;
+    const Bucket& bucket = m_Tiers[tier][static_cast<size_t>(id) & (TIER_BUCKET_COUNT[tier] - 1)];
+    for (;;) {
+        uint32_t before = bucket.version.load(std::memory_order_acquire);
+        if (before & 1) continue;
+
+        out.bucket = bucket.bucket.load(std::memory_order_relaxed);
+        out.count = bucket.count.load(std::memory_order_relaxed);
+        out.lost = bucket.lost.load(std::memory_order_relaxed);
+        out.minRttNs = bucket.minRttNs.load(std::memory_order_relaxed);
+        out.maxRttNs = bucket.maxRttNs.load(std::memory_order_relaxed);
+        out.sumMs = bucket.sumMs.load(std::memory_order_relaxed);
+        out.sumSquaresMs = bucket.sumSquaresMs.load(std::memory_order_relaxed);
+        for (int i = 0; i < TIER_HISTOGRAM_BINS; i++) {
+            out.histogram[i] = bucket.histogram[i].load(std::memory_order_relaxed);
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (bucket.version.load(std::memory_order_relaxed) == before) break;
+    }
+    return out.bucket == id && (out.count > 0 || out.lost > 0);
+}
+
+int TieredHistory::PickTier(int64_t columnNs, int64_t spanNs) {
+    int tier = -1;
+    while (tier + 1 < TIER_COUNT && TIER_BUCKET_NS[tier + 1] <= columnNs) tier++;
+    if (tier < 0) return -1;
+    while (tier + 1 < TIER_COUNT && TIER_BUCKET_NS[tier] * static_cast<int64_t>(TIER_BUCKET_COUNT[tier]) < spanNs) {
+        tier++;
+    }
+    return tier;
+}
+
+void TieredHistory::Decimate(int tier, int64_t firstColumn, int count, int64_t columnNs,
+    std::vector<ColumnEnvelope>& out) const {
+    out.assign(count, ColumnEnvelope());
+    if (tier < 0 || tier >= TIER_COUNT || count <= 0) return;
+
+    int64_t bucketNs = TIER_BUCKET_NS[tier];
+    int64_t firstBucket = firstColumn * columnNs / bucketNs;
+    int64_t endBucket = (firstColumn + count) * columnNs / bucketNs + 1;
+    TierSummary summary;
+    for (int64_t id = firstBucket; id < endBucket; id++) {
+        if (!Read(tier, id, summary)) continue;
+
+        // Place the bucket by its middle
+        int64_t column = (id * bucketNs + bucketNs / 2) / columnNs - firstColumn;
+        if (column < 0 || column >= count) continue;
+        ColumnEnvelope& envelope = out[static_cast<size_t>(column)];
+        envelope.column = firstColumn + column;
+        envelope.lost += summary.lost;
+        if (summary.count == 0) continue;
+
+        int64_t averageNs = static_cast<int64_t>(summary.AverageMs() * 1e6);
+        if (envelope.answered == 0) {
+            envelope.firstRttNs = averageNs;
+            envelope.minRttNs = summary.minRttNs;
+            envelope.maxRttNs = summary.maxRttNs;
+        } else {
+            if (summary.minRttNs < envelope.minRttNs) envelope.minRttNs = summary.minRttNs;
+            if (summary.maxRttNs > envelope.maxRttNs) envelope.maxRttNs = summary.maxRttNs;
+        }
+        envelope.lastRttNs = averageNs;
+        envelope.firstSendNs = envelope.answered ? envelope.firstSendNs : id * bucketNs;
+        envelope.lastSendNs = id * bucketNs;
+        envelope.answered += summary.count;
+    }
+}
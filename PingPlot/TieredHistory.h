@@ -0,0 +1,83 @@
+#pragma once
+
+#include "ColumnDecimator.h"
+#include "SampleStore.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Rollup tiers, finest first: bucket width and how many buckets each keeps.
+// 1 s for ~2.3 h, 10 s for ~22 h, 1 min for ~68 h and 10 min for ~7 days.
+const int TIER_COUNT = 4;
+const int64_t TIER_BUCKET_NS[TIER_COUNT] = { 1000000000LL, 10000000000LL, 60000000000LL, 600000000000LL };
+const size_t TIER_BUCKET_COUNT[TIER_COUNT] = { 8192, 8192, 4096, 1024 };
+
+// Coarse latency histogram kept per bucket: bin 0 is below 1 us, bin k is
+// [2^(k-1), 2^k) us
+const int TIER_HISTOGRAM_BINS = 32;
+
+// Copy of one rollup bucket
+struct TierSummary {
+    int64_t bucket = -1;     // Bucket number: send time / bucket width
+    uint32_t count = 0;      // Answered probes
+    uint32_t lost = 0;       // Timeouts and unreachable replies
+    int64_t minRttNs = 0;
+    int64_t maxRttNs = 0;
+    double sumMs = 0.0;
+    double sumSquaresMs = 0.0;
+    uint32_t histogram[TIER_HISTOGRAM_BINS] = {};
+
+    double AverageMs() const;
+    double JitterMs() const;
+
+    // Estimate from the coarse histogram (bin midpoints)
+    double PercentileMs(double q) const;
+};
+
+// Long-term history as fixed rings of rollup buckets. Every finished probe is
+// added to the bucket it falls in on every tier, so there is no separate
+// rollup pass and the memory use (a few MB) does not depend on the rate or
+// how long PingPlot runs. One producer thread writes; any thread can read.
+// Each bucket carries a version counter, so a reader that overlaps a write
+// simply reads that bucket again.
+class TieredHistory {
+public:
+    TieredHistory();
+
+    // Drop everything. Only while the producer is stopped.
+    void Clear();
+
+    // Producer thread: count a finished probe
+    void Add(int64_t sendTimeNs, int64_t rttNs, SampleStatus status);
+
+    // Copy bucket `bucket` of `tier`. Returns false if the tier no longer
+    // (or never) held it.
+    bool Read(int tier, int64_t bucket, TierSummary& out) const;
+
+    // Tier to draw columns of columnNs spanning spanNs: the coarsest one that
+    // still has at least one bucket per column, moved coarser if it does not
+    // reach back far enough. -1 when raw samples are the better source.
+    static int PickTier(int64_t columnNs, int64_t spanNs);
+
+    // One envelope per column in [firstColumn, firstColumn + count), from
+    // bucket averages (first/last) and extremes (min/max). Columns without
+    // buckets get column == -1.
+    void Decimate(int tier, int64_t firstColumn, int count, int64_t columnNs,
+        std::vector<ColumnEnvelope>& out) const;
+
+private:
+    struct Bucket {
+        std::atomic<uint32_t> version{0}; // Odd while being written
+        std::atomic<int64_t> bucket{-1};
+        std::atomic<uint32_t> count{0};
+        std::atomic<uint32_t> lost{0};
+        std::atomic<int64_t> minRttNs{0};
+        std::atomic<int64_t> maxRttNs{0};
+        std::atomic<double> sumMs{0.0};
+        std::atomic<double> sumSquaresMs{0.0};
+        std::atomic<uint32_t> histogram[TIER_HISTOGRAM_BINS];
+    };
+
+    std::unique_ptr<Bucket[]> m_Tiers[TIER_COUNT];
+};
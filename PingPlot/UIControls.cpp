@@ -2,6 +2,7 @@
 #include "GraphDrawing.h"
 #include "PingThread.h"
 #include <Richedit.h> // Required for EM_SETBKGNDCOLOR
+#include <commdlg.h>
 
 // Update appearance of all controls based on dark mode setting
 void UpdateControlsAppearance(HWND hwnd) {
@@ -12,7 +13,7 @@ void UpdateControlsAppearance(HWND hwnd) {
     
     // Update edit controls
     HWND controls[] = {
-        g_hEditHost, g_hEditFrequency, g_hEditHistory
+        g_hEditHost, g_hEditFrequency, g_hEditInFlight, g_hEditHistory, g_hEditMaxFps
     };
     
     for (HWND ctrl : controls) {
@@ -71,11 +72,31 @@ void CreateUIControls(HWND hwnd, HINSTANCE hInstance) {
     swprintf_s(freqStr, L"%d", PING_INTERVAL_MS);
     g_hEditFrequency = CreateWindow(
         L"EDIT", freqStr,
-        WS_CHILD | WS_VISIBLE | WS_BORDER | ES_AUTOHSCROLL | ES_NUMBER,
+        WS_CHILD | WS_VISIBLE | WS_BORDER | ES_AUTOHSCROLL, // Fractions of a ms allowed
         currentX, currentY, EDIT_SMALL_WIDTH, CONTROL_HEIGHT,
         hwnd, (HMENU)ID_EDIT_FREQUENCY, hInstance, NULL
     );
 
+    // Label for in-flight window
+    currentX += EDIT_SMALL_WIDTH + ELEMENT_SPACING;
+    CreateWindow(
+        L"STATIC", L"In flight:",
+        WS_CHILD | WS_VISIBLE,
+        currentX, currentY+RAW_TEXT_PADDING_TOP, IN_FLIGHT_LABEL_WIDTH, CONTROL_HEIGHT,
+        hwnd, NULL, hInstance, NULL
+    );
+
+    // Edit box for in-flight window
+    currentX += IN_FLIGHT_LABEL_WIDTH;
+    WCHAR inFlightStr[16];
+    swprintf_s(inFlightStr, L"%d", g_MaxInFlight);
+    g_hEditInFlight = CreateWindow(
+        L"EDIT", inFlightStr,
+        WS_CHILD | WS_VISIBLE | WS_BORDER | ES_AUTOHSCROLL | ES_NUMBER,
+        currentX, currentY, EDIT_SMALL_WIDTH, CONTROL_HEIGHT,
+        hwnd, (HMENU)ID_EDIT_IN_FLIGHT, hInstance, NULL
+    );
+
     // Apply button
     currentX += EDIT_SMALL_WIDTH + ELEMENT_SPACING;
     g_hBtnApplyFrequency = CreateWindow(
@@ -88,7 +109,7 @@ void CreateUIControls(HWND hwnd, HINSTANCE hInstance) {
     // Label for history control
     currentX += SMALL_BUTTON_WIDTH + ELEMENT_SPACING;
     CreateWindow(
-        L"STATIC", L"Approx History Length (s):",
+        L"STATIC", L"History Length (s):",
         WS_CHILD | WS_VISIBLE,
         currentX, currentY+RAW_TEXT_PADDING_TOP, HISTORY_LABEL_WIDTH, CONTROL_HEIGHT,
         hwnd, NULL, hInstance, NULL
@@ -105,6 +126,26 @@ void CreateUIControls(HWND hwnd, HINSTANCE hInstance) {
         hwnd, (HMENU)ID_EDIT_HISTORY, hInstance, NULL
     );
 
+    // Label for frame cap
+    currentX += EDIT_SMALL_WIDTH + ELEMENT_SPACING;
+    CreateWindow(
+        L"STATIC", L"Max FPS:",
+        WS_CHILD | WS_VISIBLE,
+        currentX, currentY+RAW_TEXT_PADDING_TOP, MAX_FPS_LABEL_WIDTH, CONTROL_HEIGHT,
+        hwnd, NULL, hInstance, NULL
+    );
+
+    // Edit box for frame cap
+    currentX += MAX_FPS_LABEL_WIDTH;
+    WCHAR maxFpsStr[16];
+    swprintf_s(maxFpsStr, L"%d", g_MaxFps);
+    g_hEditMaxFps = CreateWindow(
+        L"EDIT", maxFpsStr,
+        WS_CHILD | WS_VISIBLE | WS_BORDER | ES_AUTOHSCROLL | ES_NUMBER,
+        currentX, currentY, EDIT_SMALL_WIDTH, CONTROL_HEIGHT,
+        hwnd, (HMENU)ID_EDIT_MAX_FPS, hInstance, NULL
+    );
+
     // Apply history button
     currentX += EDIT_SMALL_WIDTH + ELEMENT_SPACING;
     g_hBtnApplyHistory = CreateWindow(
@@ -114,8 +155,12 @@ void CreateUIControls(HWND hwnd, HINSTANCE hInstance) {
         hwnd, (HMENU)ID_BTN_APPLY_HISTORY, hInstance, NULL
     );
     
+    // The toggle buttons go on a second row, so every control fits in
+    // WINDOW_WIDTH
+    currentX = MARGIN_LEFT;
+    currentY += CONTROL_HEIGHT + ROW_SPACING;
+    
     // Dark mode toggle button
-    currentX += SMALL_BUTTON_WIDTH + ELEMENT_SPACING;
     g_hBtnDarkMode = CreateWindow(
         L"BUTTON", g_DarkMode ? L"Light Mode" : L"Dark Mode",
         WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON,
@@ -123,6 +168,60 @@ void CreateUIControls(HWND hwnd, HINSTANCE hInstance) {
         hwnd, (HMENU)ID_BTN_DARK_MODE, hInstance, NULL
     );
     
+    // Graph mode toggle button
+    currentX += CHECKBOX_WIDTH + ELEMENT_SPACING;
+    g_hBtnGraphMode = CreateWindow(
+        L"BUTTON", g_UseLttb ? L"Envelope" : L"LTTB",
+        WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON,
+        currentX, currentY, SMALL_BUTTON_WIDTH, CONTROL_HEIGHT,
+        hwnd, (HMENU)ID_BTN_GRAPH_MODE, hInstance, NULL
+    );
+    
+    // Recording toggle button
+    currentX += SMALL_BUTTON_WIDTH + ELEMENT_SPACING;
+    g_hBtnRecord = CreateWindow(
+        L"BUTTON", g_Recording ? L"Recording" : L"Record",
+        WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON,
+        currentX, currentY, BUTTON_WIDTH, CONTROL_HEIGHT,
+        hwnd, (HMENU)ID_BTN_RECORD, hInstance, NULL
+    );
+    
+    // Replay button
+    currentX += BUTTON_WIDTH + ELEMENT_SPACING;
+    g_hBtnReplay = CreateWindow(
+        L"BUTTON", L"Replay...",
+        WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON,
+        currentX, currentY, BUTTON_WIDTH, CONTROL_HEIGHT,
+        hwnd, (HMENU)ID_BTN_REPLAY, hInstance, NULL
+    );
+    
+    // Low-jitter toggle button
+    currentX += BUTTON_WIDTH + ELEMENT_SPACING;
+    g_hBtnLowJitter = CreateWindow(
+        L"BUTTON", g_LowJitter ? L"Low Jitter On" : L"Low Jitter",
+        WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON,
+        currentX, currentY, CHECKBOX_WIDTH, CONTROL_HEIGHT,
+        hwnd, (HMENU)ID_BTN_LOW_JITTER, hInstance, NULL
+    );
+    
+    // Raw/overhead-corrected stats toggle button
+    currentX += CHECKBOX_WIDTH + ELEMENT_SPACING;
+    g_hBtnOverhead = CreateWindow(
+        L"BUTTON", g_SubtractOverhead ? L"Corrected" : L"Raw Stats",
+        WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON,
+        currentX, currentY, CHECKBOX_WIDTH, CONTROL_HEIGHT,
+        hwnd, (HMENU)ID_BTN_OVERHEAD, hInstance, NULL
+    );
+    
+    // Adaptive rate toggle button
+    currentX += CHECKBOX_WIDTH + ELEMENT_SPACING;
+    g_hBtnAdaptive = CreateWindow(
+        L"BUTTON", g_AdaptiveRate ? L"Adaptive On" : L"Adaptive",
+        WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON,
+        currentX, currentY, CHECKBOX_WIDTH, CONTROL_HEIGHT,
+        hwnd, (HMENU)ID_BTN_ADAPTIVE, hInstance, NULL
+    );
+    
     // Apply the initial appearance based on dark mode setting
     UpdateControlsAppearance(hwnd);
 }
@@ -138,26 +237,9 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
             RECT clientRect;
             GetClientRect(hwnd, &clientRect);
             
-            // Create double buffer
-            HDC memDC = CreateCompatibleDC(hdc);
-            HBITMAP memBitmap = CreateCompatibleBitmap(hdc, clientRect.right, clientRect.bottom);
-            HBITMAP oldBitmap = (HBITMAP)SelectObject(memDC, memBitmap);
-            
-            // Fill background with appropriate color based on mode
-            HBRUSH bgBrush = CreateSolidBrush(g_DarkMode ? DARK_BACKGROUND_COLOR : BACKGROUND_COLOR);
-            FillRect(memDC, &clientRect, bgBrush);
-            DeleteObject(bgBrush);
-            
-            // Draw graph
-            DrawGraph(memDC, clientRect);
-            
-            // Copy to screen
-            BitBlt(hdc, 0, 0, clientRect.right, clientRect.bottom, memDC, 0, 0, SRCCOPY);
-            
-            // Cleanup
-            SelectObject(memDC, oldBitmap);
-            DeleteObject(memBitmap);
-            DeleteDC(memDC);
+            // The graph is rendered into its own framebuffer and blitted in
+            // one go, so no double buffer is needed here
+            DrawGraph(hdc, clientRect);
             
             EndPaint(hwnd, &ps);
             return 0;
@@ -224,9 +306,17 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
                     return 0;
                 
                 case ID_BTN_APPLY: // Apply frequency button
-                    StopPinging();
-                    UpdatePingFrequency();
-                    StartPinging();
+                    {
+                        // A running probe thread takes a new interval without
+                        // a gap; a new in-flight window needs a new one
+                        int previousInFlight = g_MaxInFlight;
+                        UpdatePingFrequency();
+                        if (!g_ThreadRunning || g_MaxInFlight != previousInFlight ||
+                            !g_SamplerCommands.Push({ SamplerSetting::IntervalUs, g_PingIntervalUs })) {
+                            StopPinging();
+                            StartPinging();
+                        }
+                    }
                     return 0;
                     
                 case ID_EDIT_HOST: // Host edit box
@@ -238,10 +328,16 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
                         GetWindowText(g_hEditHistory, buffer, 16);
                         float newHistory = (float)_wtof(buffer);
                         
-                        // Validate input - ensure it's between 1s and 300s
-                        if (newHistory >= 1.0f && newHistory <= 300.0f) {
+                        // Validate input - ensure it's between 1s and 24h
+                        if (newHistory >= 1.0f && newHistory <= MAX_HISTORY_SECONDS) {
                             g_HistorySeconds = newHistory;
                             
+                            // The probe thread applies it from its next probe
+                            int64_t historyMs = static_cast<int64_t>(newHistory * 1000.0f + 0.5f);
+                            if (!g_ThreadRunning || !g_SamplerCommands.Push({ SamplerSetting::HistoryMs, historyMs })) {
+                                g_SamplerShared.historySeconds = newHistory;
+                            }
+                            
                             // Update the edit box in case the value was changed due to validation
                             swprintf_s(buffer, L"%.1f", g_HistorySeconds);
                             SetWindowText(g_hEditHistory, buffer);
@@ -252,9 +348,23 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
                             // Reset to current value if invalid
                             swprintf_s(buffer, L"%.1f", g_HistorySeconds);
                             SetWindowText(g_hEditHistory, buffer);
-                            MessageBox(g_hWnd, L"Please enter a value between 1.0 and 300.0 seconds", 
-                                L"Invalid Input", MB_ICONWARNING);
+                            WCHAR message[96];
+                            swprintf_s(message, L"Please enter a value between 1.0 and %.1f seconds", MAX_HISTORY_SECONDS);
+                            MessageBox(g_hWnd, message, L"Invalid Input", MB_ICONWARNING);
                         }
+                        
+                        // Frame cap, from the next frame on
+                        GetWindowText(g_hEditMaxFps, buffer, 16);
+                        int newMaxFps = _wtoi(buffer);
+                        if (newMaxFps >= 1 && newMaxFps <= MAX_UI_FPS) {
+                            g_MaxFps = newMaxFps;
+                        } else {
+                            WCHAR message[96];
+                            swprintf_s(message, L"Please enter a frame cap between 1 and %d", MAX_UI_FPS);
+                            MessageBox(g_hWnd, message, L"Invalid Input", MB_ICONWARNING);
+                        }
+                        swprintf_s(buffer, L"%d", g_MaxFps);
+                        SetWindowText(g_hEditMaxFps, buffer);
                     }
                     return 0;
                     
@@ -273,20 +383,95 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
                         InvalidateRect(hwnd, NULL, TRUE);
                     }
                     return 0;
+                    
+                case ID_BTN_GRAPH_MODE: // Envelope/LTTB toggle button
+                    g_UseLttb = !g_UseLttb;
+                    SetWindowText(g_hBtnGraphMode, g_UseLttb ? L"Envelope" : L"LTTB");
+                    InvalidateRect(hwnd, NULL, FALSE);
+                    return 0;
+                    
+                case ID_BTN_RECORD: // Recording toggle button
+                    // Takes effect at once if pinging, otherwise from the next Start
+                    g_Recording = !g_Recording;
+                    SetWindowText(g_hBtnRecord, g_Recording ? L"Recording" : L"Record");
+                    if (!g_Recording) {
+                        g_SessionWriter.Stop();
+                    } else if (g_ThreadRunning && !g_SessionWriter.IsRunning()) {
+                        StartRecording();
+                    }
+                    return 0;
+                    
+                case ID_BTN_REPLAY: // Open or close a recorded session
+                    if (g_ReplaySession.IsOpen()) {
+                        g_ReplaySession.Close();
+                        SetWindowText(g_hBtnReplay, L"Replay...");
+                    } else {
+                        WCHAR path[MAX_PATH] = L"";
+                        OPENFILENAME ofn = {};
+                        ofn.lStructSize = sizeof(ofn);
+                        ofn.hwndOwner = hwnd;
+                        ofn.lpstrFilter = L"PingPlot sessions (*.pps)\0*.pps\0All files\0*.*\0";
+                        ofn.lpstrFile = path;
+                        ofn.nMaxFile = MAX_PATH;
+                        ofn.Flags = OFN_FILEMUSTEXIST | OFN_PATHMUSTEXIST;
+                        if (!GetOpenFileName(&ofn)) return 0;
+                        
+                        char narrowPath[MAX_PATH * 2];
+                        WideCharToMultiByte(CP_ACP, 0, path, -1, narrowPath, sizeof(narrowPath), NULL, NULL);
+                        StopPinging();
+                        if (!g_ReplaySession.Open(narrowPath)) {
+                            WCHAR errorMsg[512];
+                            swprintf_s(errorMsg, L"%S", g_ReplaySession.LastError().c_str());
+                            MessageBox(hwnd, errorMsg, L"Error", MB_ICONERROR);
+                            return 0;
+                        }
+                        SetWindowText(g_hBtnReplay, L"Live");
+                    }
+                    InvalidateReplay();
+                    InvalidateRect(hwnd, NULL, FALSE);
+                    return 0;
+                    
+                case ID_BTN_LOW_JITTER: // Low-jitter toggle button
+                    // The probe thread is set up at start, so a running one is restarted
+                    g_LowJitter = !g_LowJitter;
+                    SetWindowText(g_hBtnLowJitter, g_LowJitter ? L"Low Jitter On" : L"Low Jitter");
+                    if (g_ThreadRunning) {
+                        StopPinging();
+                        StartPinging();
+                    }
+                    return 0;
+                    
+                case ID_BTN_OVERHEAD: // Raw/overhead-corrected stats toggle button
+                    g_SubtractOverhead = !g_SubtractOverhead;
+                    SetWindowText(g_hBtnOverhead, g_SubtractOverhead ? L"Corrected" : L"Raw Stats");
+                    InvalidateRect(hwnd, NULL, FALSE);
+                    return 0;
+                    
+                case ID_BTN_ADAPTIVE: // Adaptive rate toggle button
+                    // The interval becomes the target rate and the in-flight
+                    // window the deepest pipelining; a running thread restarts
+                    g_AdaptiveRate = !g_AdaptiveRate;
+                    SetWindowText(g_hBtnAdaptive, g_AdaptiveRate ? L"Adaptive On" : L"Adaptive");
+                    if (g_ThreadRunning) {
+                        StopPinging();
+                        StartPinging();
+                    }
+                    return 0;
             }
             break;
         }
         
+        case WM_APP_DATA_UPDATED: // The probe thread has new data
+            ScheduleFrame(hwnd);
+            return 0;
+        
         case WM_DESTROY:
             g_Running = false;
-            if (g_UITimer != 0) {
-                KillTimer(hwnd, g_UITimer);
-                g_UITimer = 0;
-            }
             // Make sure thread exits cleanly
             if (g_ThreadRunning && g_PingThreadHandle.joinable()) {
                 g_PingThreadHandle.join();
             }
+            g_SessionWriter.Stop();
             PostQuitMessage(0);
             return 0;
     }
@@ -8,6 +8,7 @@ namespace UILayout {
     const int MARGIN_LEFT = 15;
     const int MARGIN_TOP = 15;
     const int ELEMENT_SPACING = 10;
+    const int ROW_SPACING = 5;
     const int RAW_TEXT_PADDING_TOP = 1;
     
     // Element sizes
@@ -19,7 +20,9 @@ namespace UILayout {
     
     // Label sizes
     const int FREQ_LABEL_WIDTH = 120;
+    const int IN_FLIGHT_LABEL_WIDTH = 60;
     const int HISTORY_LABEL_WIDTH = 170;
+    const int MAX_FPS_LABEL_WIDTH = 60;
     const int CHECKBOX_WIDTH = 100;
 }
 
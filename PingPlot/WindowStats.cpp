@@ -0,0 +1,243 @@
+#include "WindowStats.h"
+#include <cmath>
+
+WindowStats::WindowStats(size_t capacity)
+    : m_Entries(capacity), m_Mask(capacity - 1),
+      m_MaxQueue(capacity), m_MinQueue(capacity) {}
+
+void WindowStats::Reset() {
+    m_Front = m_Back = 0;
+    m_NewestNs = 0;
+    m_Capped = false;
+    m_Answered = 0;
+    m_Mean = m_M2 = 0.0;
+    m_Lost = 0;
+    m_Late = m_Reordered = m_Duplicates = 0;
+    m_Current = 0.0;
+    m_Histogram.Clear();
+    m_MaxFront = m_MaxBack = 0;
+    m_MinFront = m_MinBack = 0;
+}
+
+uint64_t WindowStats::Add(int64_t sendTimeNs, int64_t rttNs, SampleStatus status, int64_t historyNs, bool reordered) {
+    if (status == SampleStatus::Pending || status == SampleStatus::Duplicate) return UINT64_MAX;
+
+    // Make room, then expire by send time. Making room for a sample that
+    // was still inside the window caps it until expiry catches up.
+    int64_t cutoff = sendTimeNs - historyNs;
+    if (m_Back - m_Front == m_Entries.size()) {
+        m_Capped = m_Entries[m_Front & m_Mask].sendTimeNs >= cutoff;
+        EvictOldest();
+    }
+    while (m_Front != m_Back && m_Entries[m_Front & m_Mask].sendTimeNs < cutoff) {
+        EvictOldest();
+        m_Capped = false;
+    }
+    if (m_Front == m_Back || sendTimeNs > m_NewestNs) m_NewestNs = sendTimeNs;
+
+    uint64_t index = m_Back++;
+    Entry& entry = m_Entries[index & m_Mask];
+    entry.sendTimeNs = sendTimeNs;
+    entry.rttNs = rttNs;
+    entry.status = status;
+    entry.reordered = reordered;
+    entry.duplicates = 0;
+
+    switch (status) {
+        case SampleStatus::Ok: break;
+        case SampleStatus::Late: m_Late++; return index;
+        default: m_Lost++; return index;
+    }
+    if (reordered) m_Reordered++;
+
+    double value = rttNs / 1e6;
+    m_Current = value;
+    m_Answered++;
+    double delta = value - m_Mean;
+    m_Mean += delta / m_Answered;
+    m_M2 += delta * (value - m_Mean);
+    m_Histogram.Add(rttNs);
+
+    // Anything the new value dominates can never be the extreme again
+    while (m_MaxBack != m_MaxFront && m_Entries[m_MaxQueue[(m_MaxBack - 1) & m_Mask] & m_Mask].rttNs <= rttNs) {
+        m_MaxBack--;
+    }
+    m_MaxQueue[m_MaxBack++ & m_Mask] = index;
+    while (m_MinBack != m_MinFront && m_Entries[m_MinQueue[(m_MinBack - 1) & m_Mask] & m_Mask].rttNs >= rttNs) {
+        m_MinBack--;
+    }
+    m_MinQueue[m_MinBack++ & m_Mask] = index;
+    return index;
+}
+
+void WindowStats::MarkLate(uint64_t index) {
+    if (index < m_Front || index >= m_Back) return;
+    Entry& entry = m_Entries[index & m_Mask];
+    if (entry.status != SampleStatus::Timeout) return;
+    entry.status = SampleStatus::Late;
+    m_Lost--;
+    m_Late++;
+}
+
+void WindowStats::AddDuplicate(uint64_t index) {
+    if (index < m_Front || index >= m_Back) return;
+    m_Entries[index & m_Mask].duplicates++;
+    m_Duplicates++;
+}
+
+void WindowStats::EvictOldest() {
+    uint64_t index = m_Front++;
+    const Entry& entry = m_Entries[index & m_Mask];
+    m_Duplicates -= entry.duplicates;
+    switch (entry.status) {
+        case SampleStatus::Ok: break;
+        case SampleStatus::Late: m_Late--; return;
+        default: m_Lost--; return;
+    }
+    if (entry.reordered) m_Reordered--;
+
+    m_Histogram.Remove(entry.rttNs);
+
+    // Inverse Welford step
+    if (--m_Answered == 0) {
+        m_Mean = m_M2 = 0.0;
+    } else {
+        double value = entry.rttNs / 1e6;
+        double oldMean = m_Mean;
+        m_Mean -= (value - m_Mean) / m_Answered;
+        m_M2 -= (value - oldMean) * (value - m_Mean);
+        if (m_M2 < 0.0) m_M2 = 0.0; // Rounding can leave a tiny negative
+    }
+
+    if (m_MaxFront != m_MaxBack && m_MaxQueue[m_MaxFront & m_Mask] == index) m_MaxFront++;
+    if (m_MinFront != m_MinBack && m_MinQueue[m_MinFront & m_Mask] == index) m_MinFront++;
+}
+
+void WindowStats::Summarize(WindowSummary& out) const {
+    out.answered = m_Answered;
+    out.lost = m_Lost;
+    out.late = m_Late;
+    out.reordered = m_Reordered;
+    out.duplicates = m_Duplicates;
+    out.currentMs = m_Current;
+    out.averageMs = m_Mean;
+    out.jitterMs = m_Answered ? std::sqrt(m_M2 / m_Answered) : 0.0;
+    out.maxMs = m_MaxFront != m_MaxBack ? m_Entries[m_MaxQueue[m_MaxFront & m_Mask] & m_Mask].rttNs / 1e6 : 0.0;
+    out.minMs = m_MinFront != m_MinBack ? m_Entries[m_MinQueue[m_MinFront & m_Mask] & m_Mask].rttNs / 1e6 : 0.0;
+    out.p50Ms = Percentile(0.5);
+    out.p90Ms = Percentile(0.9);
+    out.p99Ms = Percentile(0.99);
+    out.p999Ms = Percentile(0.999);
+    out.spanSeconds = m_Front != m_Back ? (m_NewestNs - m_Entries[m_Front & m_Mask].sendTimeNs) / 1e9 : 0.0;
+    out.capped = m_Capped;
+}
+
+double WindowStats::Percentile(double q) const {
+    return m_Histogram.Percentile(q) / 1e6;
+}
+
+void RunStats::Reset() {
+    m_Answered = 0;
+    m_Mean = m_M2 = 0.0;
+    m_Lost = 0;
+    m_Late = m_Reordered = m_Duplicates = 0;
+    m_Current = 0.0;
+    m_MinNs = m_MaxNs = 0;
+    m_Histogram.Clear();
+}
+
+void RunStats::Add(int64_t rttNs, SampleStatus status, bool reordered) {
+    switch (status) {
+        case SampleStatus::Ok: break;
+        case SampleStatus::Pending: return;
+        case SampleStatus::Late: m_Late++; return;
+        case SampleStatus::Duplicate: m_Duplicates++; return;
+        default: m_Lost++; return;
+    }
+    if (reordered) m_Reordered++;
+
+    if (m_Answered == 0 || rttNs < m_MinNs) m_MinNs = rttNs;
+    if (m_Answered == 0 || rttNs > m_MaxNs) m_MaxNs = rttNs;
+    double value = rttNs / 1e6;
+    m_Current = value;
+    m_Answered++;
+    double delta = value - m_Mean;
+    m_Mean += delta / m_Answered;
+    m_M2 += delta * (value - m_Mean);
+    m_Histogram.Add(rttNs);
+}
+
+void RunStats::MarkLate() {
+    if (m_Lost == 0) return;
+    m_Lost--;
+    m_Late++;
+}
+
+void RunStats::Summarize(WindowSummary& out) const {
+    out.answered = m_Answered;
+    out.lost = m_Lost;
+    out.late = m_Late;
+    out.reordered = m_Reordered;
+    out.duplicates = m_Duplicates;
+    out.currentMs = m_Current;
+    out.averageMs = m_Mean;
+    out.jitterMs = m_Answered ? std::sqrt(m_M2 / m_Answered) : 0.0;
+    out.minMs = m_MinNs / 1e6;
+    out.maxMs = m_MaxNs / 1e6;
+    out.p50Ms = m_Histogram.Percentile(0.5) / 1e6;
+    out.p90Ms = m_Histogram.Percentile(0.9) / 1e6;
+    out.p99Ms = m_Histogram.Percentile(0.99) / 1e6;
+    out.p999Ms = m_Histogram.Percentile(0.999) / 1e6;
+}
+
+void PublishedStats::Store(const WindowSummary& summary) {
+    uint32_t version = m_Version.load(std::memory_order_relaxed);
+    m_Version.store(version + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    m_Answered.store(summary.answered, std::memory_order_relaxed);
+    m_Lost.store(summary.lost, std::memory_order_relaxed);
+    m_Late.store(summary.late, std::memory_order_relaxed);
+    m_Reordered.store(summary.reordered, std::memory_order_relaxed);
+    m_Duplicates.store(summary.duplicates, std::memory_order_relaxed);
+    m_Capped.store(summary.capped, std::memory_order_relaxed);
+    m_SpanSeconds.store(summary.spanSeconds, std::memory_order_relaxed);
+    m_CurrentMs.store(summary.currentMs, std::memory_order_relaxed);
+    m_AverageMs.store(summary.averageMs, std::memory_order_relaxed);
+    m_MinMs.store(summary.minMs, std::memory_order_relaxed);
+    m_MaxMs.store(summary.maxMs, std::memory_order_relaxed);
+    m_JitterMs.store(summary.jitterMs, std::memory_order_relaxed);
+    m_P50Ms.store(summary.p50Ms, std::memory_order_relaxed);
+    m_P90Ms.store(summary.p90Ms, std::memory_order_relaxed);
+    m_P99Ms.store(summary.p99Ms, std::memory_order_relaxed);
+    m_P999Ms.store(summary.p999Ms, std::memory_order_relaxed);
+
+    m_Version.store(version + 2, std::memory_order_release);
+}
+
+void PublishedStats::Load(WindowSummary& out) const {
+    for (;;) {
+        uint32_t before = m_Version.load(std::memory_order_acquire);
+        if (before & 1) continue;
+
+        out.answered = m_Answered.load(std::memory_order_relaxed);
+        out.lost = m_Lost.load(std::memory_order_relaxed);
+        out.late = m_Late.load(std::memory_order_relaxed);
+        out.reordered = m_Reordered.load(std::memory_order_relaxed);
+        out.duplicates = m_Duplicates.load(std::memory_order_relaxed);
+        out.capped = m_Capped.load(std::memory_order_relaxed);
+        out.spanSeconds = m_SpanSeconds.load(std::memory_order_relaxed);
+        out.currentMs = m_CurrentMs.load(std::memory_order_relaxed);
+        out.averageMs = m_AverageMs.load(std::memory_order_relaxed);
+        out.minMs = m_MinMs.load(std::memory_order_relaxed);
+        out.maxMs = m_MaxMs.load(std::memory_order_relaxed);
+        out.jitterMs = m_JitterMs.load(std::memory_order_relaxed);
+        out.p50Ms = m_P50Ms.load(std::memory_order_relaxed);
+        out.p90Ms = m_P90Ms.load(std::memory_order_relaxed);
+        out.p99Ms = m_P99Ms.load(std::memory_order_relaxed);
+        out.p999Ms = m_P999Ms.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (m_Version.load(std::memory_order_relaxed) == before) return;
+    }
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include "LatencyHistogram.h"
+#include "SampleStore.h"
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// Figures for the samples currently inside the history window
+struct WindowSummary {
+    uint64_t answered = 0;  // Ok samples in the window
+    uint64_t lost = 0;      // Timeouts and unreachable replies in the window
+    uint64_t late = 0;      // Probes answered only after their timeout
+    uint64_t reordered = 0; // Answered probes whose reply came after a later probe's
+    uint64_t duplicates = 0; // Extra replies to probes already answered
+    double currentMs = 0.0; // Latest answered ping
+    double averageMs = 0.0;
+    double minMs = 0.0;
+    double maxMs = 0.0;
+    double jitterMs = 0.0;  // Standard deviation of the answered pings
+    double p50Ms = 0.0;
+    double p90Ms = 0.0;
+    double p99Ms = 0.0;
+    double p999Ms = 0.0;
+    double spanSeconds = 0.0; // Send times the window covers, oldest to newest
+    bool capped = false;      // The window is full: it covers less than the history length
+
+    // Probes that finished one way or another
+    uint64_t Finished() const { return answered + lost + late; }
+
+    double LossPercent() const {
+        uint64_t finished = Finished();
+        return finished ? 100.0 * lost / finished : 0.0;
+    }
+
+    double ReorderPercent() const {
+        return answered ? 100.0 * reordered / answered : 0.0;
+    }
+};
+
+// Sliding-window statistics updated as samples arrive and expire, so reading
+// them costs the same whatever the window size. Mean and variance are kept
+// with Welford's update (and its inverse on eviction), min and max with
+// monotonic queues, percentiles with a LatencyHistogram and losses, late
+// replies, reorders and duplicates as plain counts; a duplicate is counted
+// on the entry of the probe it repeats, not in an entry of its own. Samples
+// leave the window in
+// the order they were added once they were sent more than historyNs before
+// the newest one, or earlier when all capacity entries are in use; the
+// summary reports that as capped. All storage is sized up front; Add never
+// allocates. Single-threaded: owned by the thread that records the series.
+class WindowStats {
+public:
+    explicit WindowStats(size_t capacity = SAMPLE_STORE_CAPACITY);
+
+    // Forget every sample
+    void Reset();
+
+    // Add a finished probe and expire those sent before sendTimeNs -
+    // historyNs. reordered marks an Ok reply that came after a later probe's.
+    // Returns the entry's index for MarkLate and AddDuplicate.
+    uint64_t Add(int64_t sendTimeNs, int64_t rttNs, SampleStatus status, int64_t historyNs, bool reordered = false);
+
+    // Count another reply to the probe at index. It leaves the window with
+    // that probe; ignored once the probe has left.
+    void AddDuplicate(uint64_t index);
+
+    // Turn a timed-out entry into a late one now that its reply came. Its
+    // RTT stays out of the latency figures. Ignored once it left the window.
+    void MarkLate(uint64_t index);
+
+    void Summarize(WindowSummary& out) const;
+
+    // Latency (ms) at quantile q of the answered samples in the window
+    double Percentile(double q) const;
+
+private:
+    struct Entry {
+        int64_t sendTimeNs;
+        int64_t rttNs;
+        SampleStatus status;
+        bool reordered;
+        uint32_t duplicates; // Extra replies to this probe
+    };
+
+    // Drop the oldest sample from every aggregate
+    void EvictOldest();
+
+    std::vector<Entry> m_Entries; // Ring of window samples, by add order
+    size_t m_Mask;
+    uint64_t m_Front = 0;         // Index of the oldest sample
+    uint64_t m_Back = 0;          // Index the next sample gets
+    int64_t m_NewestNs = 0;       // Latest send time added
+    bool m_Capped = false;        // Samples inside historyNs were evicted for room
+
+    // Welford state over the answered samples
+    uint64_t m_Answered = 0;
+    double m_Mean = 0.0;
+    double m_M2 = 0.0;
+
+    uint64_t m_Lost = 0;
+    uint64_t m_Late = 0;
+    uint64_t m_Reordered = 0;
+    uint64_t m_Duplicates = 0;
+    double m_Current = 0.0;
+    LatencyHistogram m_Histogram;
+
+    // Monotonic queues of entry indices: values decrease from front to back
+    // in m_MaxQueue and increase in m_MinQueue, so the fronts are the extremes
+    std::vector<uint64_t> m_MaxQueue;
+    std::vector<uint64_t> m_MinQueue;
+    uint64_t m_MaxFront = 0, m_MaxBack = 0;
+    uint64_t m_MinFront = 0, m_MinBack = 0;
+};
+
+// The same figures over every sample since Reset, for end-of-run summaries.
+// Nothing expires, so it needs no sample storage.
+class RunStats {
+public:
+    void Reset();
+
+    void Add(int64_t rttNs, SampleStatus status, bool reordered = false);
+
+    // A probe counted as a timeout was answered late after all
+    void MarkLate();
+
+    void Summarize(WindowSummary& out) const;
+
+    // Probes that finished, one way or another, and those lost so far
+    uint64_t Finished() const { return m_Answered + m_Lost + m_Late; }
+    uint64_t Lost() const { return m_Lost; }
+
+private:
+    uint64_t m_Answered = 0;
+    double m_Mean = 0.0;
+    double m_M2 = 0.0;
+    uint64_t m_Lost = 0;
+    uint64_t m_Late = 0;
+    uint64_t m_Reordered = 0;
+    uint64_t m_Duplicates = 0;
+    double m_Current = 0.0;
+    int64_t m_MinNs = 0;
+    int64_t m_MaxNs = 0;
+    LatencyHistogram m_Histogram;
+};
+
+// A WindowSummary handed from the recording thread to readers. The writer
+// never waits; readers retry in the rare case they overlap an update.
+class PublishedStats {
+public:
+    // Writer side (one thread)
+    void Store(const WindowSummary& summary);
+
+    // Reader side (any thread)
+    void Load(WindowSummary& out) const;
+
+private:
+    std::atomic<uint32_t> m_Version{0}; // Odd while an update is in progress
+    std::atomic<uint64_t> m_Answered{0};
+    std::atomic<uint64_t> m_Lost{0};
+    std::atomic<uint64_t> m_Late{0};
+    std::atomic<uint64_t> m_Reordered{0};
+    std::atomic<uint64_t> m_Duplicates{0};
+    std::atomic<bool> m_Capped{false};
+    std::atomic<double> m_SpanSeconds{0.0};
+    std::atomic<double> m_CurrentMs{0.0};
+    std::atomic<double> m_AverageMs{0.0};
+    std::atomic<double> m_MinMs{0.0};
+    std::atomic<double> m_MaxMs{0.0};
+    std::atomic<double> m_JitterMs{0.0};
+    std::atomic<double> m_P50Ms{0.0};
+    std::atomic<double> m_P90Ms{0.0};
+    std::atomic<double> m_P99Ms{0.0};
+    std::atomic<double> m_P999Ms{0.0};
+};
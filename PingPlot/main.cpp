@@ -5,10 +5,18 @@
 #include "PingThread.h"
 #include "UIControls.h"
 
+// Older SDKs lack the flag; without support the timer is created the classic way
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
 // Global variable definitions
 std::wstring g_HostToPing = L"1.1.1.1";  //default host
-std::deque<double> g_PingTimes;
-std::mutex g_PingDataMutex;
+SampleStore g_SampleStore;
+SamplerShared g_SamplerShared;
+ColumnDecimator g_GraphDecimator;
+TieredHistory g_TieredHistory;
+Resolver g_Resolver;
 std::atomic<bool> g_Running = true;
 HWND g_hWnd = NULL;
 HWND g_hEditHost = NULL;
@@ -16,15 +24,11 @@ HWND g_hBtnStart = NULL;
 HWND g_hBtnStop = NULL;
 HWND g_hEditFrequency = NULL;
 HWND g_hBtnApplyFrequency = NULL;
-int g_PingInterval = PING_INTERVAL_MS;
+int64_t g_PingIntervalUs = PING_INTERVAL_MS * 1000;
 double g_MaxPingTime = 100.0;
-std::atomic<bool> g_DataUpdated = false;
-UINT_PTR g_UITimer = 0;
-std::atomic<unsigned long long> g_TotalPings = 0;
-std::atomic<double> g_PingsPerSecond = 0.0;
-std::chrono::steady_clock::time_point g_LastPPSUpdateTime;
-unsigned long long g_LastPPSCount = 0;
-std::atomic<int> g_DynamicDataPoints = INITIAL_MAX_DATAPOINTS; // Initialize to default value
+HANDLE g_FrameTimer = NULL;
+int g_MaxFps = DEFAULT_MAX_FPS;                               // Raised to the display's refresh rate at start
+HWND g_hEditMaxFps = NULL;                                    // Frame cap edit control
 std::thread g_PingThreadHandle;                               // Thread handle
 std::atomic<bool> g_ThreadRunning = false;                    // Thread running flag
 float g_HistorySeconds = HISTORY_SECONDS;                     // Initialize with constant
@@ -32,6 +36,23 @@ HWND g_hEditHistory = NULL;                                   // History length
 HWND g_hBtnApplyHistory = NULL;                               // Apply history button
 bool g_DarkMode = true;                                       // Start in dark mode
 HWND g_hBtnDarkMode = NULL;                                   // Dark mode toggle button
+int g_MaxInFlight = 1;                                        // Classic send-after-reply by default
+HWND g_hEditInFlight = NULL;                                  // In-flight window edit control
+bool g_UseLttb = false;                                       // Min/max envelopes by default
+HWND g_hBtnGraphMode = NULL;                                  // Envelope/LTTB toggle button
+bool g_Recording = false;                                     // Not recording by default
+HWND g_hBtnRecord = NULL;                                     // Recording toggle button
+SessionWriter g_SessionWriter;                                // Session file of the current run
+SessionReader g_ReplaySession;                                // Replayed session file, if open
+HWND g_hBtnReplay = NULL;                                     // Open/close replay button
+bool g_LowJitter = false;                                     // Normal probe thread by default
+HWND g_hBtnLowJitter = NULL;                                  // Low-jitter toggle button
+SamplerCommandQueue g_SamplerCommands;                        // Applied by the probe thread while it runs
+Calibrator g_Calibrator;                                      // Calibrated at the start of every run
+bool g_SubtractOverhead = false;                              // Raw stats by default
+HWND g_hBtnOverhead = NULL;                                   // Raw/overhead-corrected stats toggle button
+bool g_AdaptiveRate = false;                                  // Fixed interval by default
+HWND g_hBtnAdaptive = NULL;                                   // Adaptive rate toggle button
 
 // Entry point
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow) {
@@ -71,6 +92,15 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
         return 0;
     }
 
+    // Draw at most as often as the display refreshes. A high-resolution
+    // timer paces frames above the system tick rate without raising it.
+    HDC screen = GetDC(NULL);
+    int refreshRate = GetDeviceCaps(screen, VREFRESH);
+    ReleaseDC(NULL, screen);
+    if (refreshRate > 1 && refreshRate <= MAX_UI_FPS) g_MaxFps = refreshRate;
+    g_FrameTimer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    if (!g_FrameTimer) g_FrameTimer = CreateWaitableTimer(NULL, FALSE, NULL);
+
     // Create UI controls
     CreateUIControls(g_hWnd, hInstance);
 
@@ -78,15 +108,31 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
     ShowWindow(g_hWnd, nCmdShow);
     UpdateWindow(g_hWnd);
 
-    // Message loop
+    // Message loop. It also waits for the frame timer, so the UI thread
+    // sleeps between frames and for as long as no new data arrives.
     MSG msg = {0};
-    while (GetMessage(&msg, NULL, 0, 0)) {
-        TranslateMessage(&msg);
-        DispatchMessage(&msg);
+    DWORD timerCount = g_FrameTimer ? 1 : 0;
+    bool quit = false;
+    while (!quit) {
+        DWORD woken = MsgWaitForMultipleObjectsEx(timerCount, &g_FrameTimer, INFINITE, QS_ALLINPUT,
+            MWMO_INPUTAVAILABLE);
+        if (timerCount > 0 && woken == WAIT_OBJECT_0) {
+            OnFrameTimer(g_hWnd);
+            continue;
+        }
+        while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
+            if (msg.message == WM_QUIT) {
+                quit = true;
+                break;
+            }
+            TranslateMessage(&msg);
+            DispatchMessage(&msg);
+        }
     }
 
     // Cleanup
     g_Running = false;
+    if (g_FrameTimer) CloseHandle(g_FrameTimer);
     Gdiplus::GdiplusShutdown(gdiplusToken);
     return (int)msg.wParam;
 }
\ No newline at end of file